@@ -0,0 +1,66 @@
+#ifndef ADAPTIVE_INTERVAL_H
+#define ADAPTIVE_INTERVAL_H
+
+#include <stdint.h>
+
+namespace FindSpot {
+
+/**
+ * Per-sensor sampling interval that backs off while a spot is stable.
+ *
+ * Counted in scan periods: a transitioning spot is sampled every scan (the
+ * floor interval), and every stable sample doubles the interval up to the
+ * ceiling. Any sign of change drops straight back to the floor.
+ */
+class AdaptiveInterval {
+public:
+  AdaptiveInterval(uint32_t floorMs, uint32_t ceilingMs) {
+    setLimits(floorMs, ceilingMs);
+  }
+
+  /// @brief Change the floor (scan period) and ceiling; restarts at the floor
+  void setLimits(uint32_t floorMs, uint32_t ceilingMs) {
+    this->floorMs = floorMs;
+    maxScans = floorMs && ceilingMs > floorMs ? ceilingMs / floorMs : 1;
+    reset();
+  }
+
+  /// @brief Advance by one scan period
+  /// @return True if the sensor should be sampled in this scan
+  bool tick() {
+    if (++elapsedScans < intervalScans) {
+      return false;
+    }
+    elapsedScans = 0;
+    return true;
+  }
+
+  /// @brief Adapt the interval after a completed sample
+  /// @param transitioning True while the spot shows signs of changing state
+  void onSample(bool transitioning) {
+    if (transitioning) {
+      intervalScans = 1;
+    } else if (intervalScans < maxScans) {
+      intervalScans = intervalScans * 2 > maxScans ? maxScans : intervalScans * 2;
+    }
+  }
+
+  /// @brief Return to the floor interval, e.g. after the thresholds change
+  void reset() {
+    intervalScans = 1;
+    elapsedScans = 0;
+  }
+
+  uint32_t getIntervalMs() const {
+    return intervalScans * floorMs;
+  }
+
+private:
+  uint32_t floorMs;
+  uint32_t maxScans;
+  uint32_t intervalScans = 1;
+  uint32_t elapsedScans = 0;
+};
+}
+
+#endif
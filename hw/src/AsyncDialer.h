@@ -0,0 +1,332 @@
+#ifndef ASYNC_DIALER_H
+#define ASYNC_DIALER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#ifdef ARDUINO
+#include <lwip/dns.h>
+#include <lwip/sockets.h>
+#include <lwip/tcpip.h>
+#endif
+
+namespace FindSpot {
+
+/**
+ * Hands the answer of a DNS lookup from the resolver's thread to the poller.
+ *
+ * lwIP cannot cancel a lookup, so an answer may arrive after its attempt
+ * was aborted or timed out, while the next attempt is already waiting.
+ * begin() starts every lookup under a new generation and returns a Ticket
+ * carrying it, which is what the resolver's callback gets as its argument.
+ * deliver() drops an answer whose generation is no longer current. The
+ * generation and the state share one atomic word, so a stale answer is
+ * never taken for the current one, however the two threads interleave.
+ * Answers must come from one thread at a time, as lwIP's do.
+ *
+ * Portable C++, no Arduino dependency.
+ */
+template <typename Address>
+class DnsHandoff {
+public:
+  enum State : uint8_t {
+    PENDING,
+    WRITING,  // Resolver is storing the address
+    RESOLVED,
+    FAILED
+  };
+
+  /// @brief Callback argument of one lookup; free again once its answer was delivered
+  struct Ticket {
+    DnsHandoff* owner;
+    uint32_t generation;
+    std::atomic<bool> outstanding{false};
+  };
+
+  /// @brief Start a lookup under a new generation; poller side
+  /// @return Ticket to pass to the resolver, nullptr if TICKETS older lookups are still unanswered
+  Ticket* begin() {
+    Ticket* ticket = nullptr;
+    for (Ticket& t : tickets) {
+      if (!t.outstanding.load(std::memory_order_acquire)) {
+        ticket = &t;
+        break;
+      }
+    }
+    if (!ticket) {
+      return nullptr;
+    }
+    generation = (generation + 1) & GENERATION_MASK;
+    word.store(pack(generation, PENDING), std::memory_order_release);
+    ticket->owner = this;
+    ticket->generation = generation;
+    ticket->outstanding.store(true, std::memory_order_release);
+    return ticket;
+  }
+
+  /// @brief Answer for the lookup of `ticket`; nullptr if it failed. Resolver side, or the poller
+  /// for an answer known at once
+  static void deliver(void* ticket, const Address* address) {
+    Ticket* t = static_cast<Ticket*>(ticket);
+    t->owner->complete(t->generation, address);
+    t->outstanding.store(false, std::memory_order_release);
+  }
+
+  /// @brief State of the current lookup; poller side
+  /// @param address Set once it is RESOLVED
+  State poll(Address& address) const {
+    uint32_t w = word.load(std::memory_order_acquire);
+    State state = static_cast<State>(w & STATE_MASK);
+    if ((w >> 2) != generation || state == WRITING) {
+      return PENDING;
+    }
+    if (state == RESOLVED) {
+      address = resolved;
+    }
+    return state;
+  }
+
+  /// @brief Lookups issued so far
+  uint32_t getGeneration() const {
+    return generation;
+  }
+
+private:
+  static const size_t TICKETS = 4;
+  static const uint32_t STATE_MASK = 3;
+  static const uint32_t GENERATION_MASK = 0x3FFFFFFF;
+
+  Ticket tickets[TICKETS];
+  uint32_t generation = 0;  // Poller only
+  std::atomic<uint32_t> word{0};
+  Address resolved{};
+
+  static uint32_t pack(uint32_t gen, State state) {
+    return (gen << 2) | state;
+  }
+
+  void complete(uint32_t gen, const Address* address) {
+    uint32_t expected = pack(gen, PENDING);
+    if (!word.compare_exchange_strong(expected, pack(gen, WRITING), std::memory_order_acq_rel)) {
+      return;  // Superseded by a newer lookup
+    }
+    if (address) {
+      resolved = *address;
+    }
+    expected = pack(gen, WRITING);
+    word.compare_exchange_strong(expected, pack(gen, address ? RESOLVED : FAILED), std::memory_order_acq_rel);
+  }
+};
+
+#ifdef ARDUINO
+/**
+ * Opens a TCP connection in small non-blocking steps.
+ *
+ * begin() starts an lwIP DNS lookup; each poll() checks for the answer,
+ * then issues a non-blocking connect() and checks it with a zero-timeout
+ * select(). No call waits on the network, so the caller keeps sampling
+ * while a broker is slow or unreachable. Each phase fails after
+ * `timeoutMs`. A late DNS answer of an earlier attempt is dropped by the
+ * DnsHandoff.
+ *
+ * The connected socket is handed over with release(), typically to
+ * `WiFiClient(int fd)`.
+ */
+class AsyncDialer {
+public:
+  enum class Status : uint8_t {
+    IDLE,
+    PENDING,
+    CONNECTED,
+    FAILED
+  };
+
+  explicit AsyncDialer(uint32_t timeoutMs) : timeoutMs(timeoutMs) {}
+
+  ~AsyncDialer() {
+    abort();
+  }
+
+  bool begin(const char* host, uint16_t port, uint32_t nowMs) {
+    abort();
+    this->port = port;
+    phaseStartMs = nowMs;
+    failure = nullptr;
+
+    Dns::Ticket* ticket = dns.begin();
+    if (!ticket) {
+      return fail("DNS lookups of earlier attempts still unanswered", true);
+    }
+
+    ip_addr_t address;
+    err_t err;
+#if LWIP_TCPIP_CORE_LOCKING
+    LOCK_TCPIP_CORE();
+#endif
+    err = dns_gethostbyname(host, &address, onResolved, ticket);
+#if LWIP_TCPIP_CORE_LOCKING
+    UNLOCK_TCPIP_CORE();
+#endif
+
+    if (err == ERR_OK) {
+      Dns::deliver(ticket, &address);  // Literal address or cached entry; no callback follows
+    } else if (err != ERR_INPROGRESS) {
+      Dns::deliver(ticket, nullptr);
+      return fail("DNS lookup could not start", true);
+    }
+    phase = Phase::RESOLVING;
+    return true;
+  }
+
+  /// @brief Advance the connection by at most one non-blocking step
+  Status poll(uint32_t nowMs) {
+    switch (phase) {
+      case Phase::IDLE:
+        return Status::IDLE;
+
+      case Phase::RESOLVING: {
+        Dns::State lookup = dns.poll(resolved);
+        if (lookup == Dns::FAILED) {
+          fail("DNS lookup failed", true);
+        } else if (lookup == Dns::RESOLVED) {
+          startConnect(nowMs);
+        } else if (nowMs - phaseStartMs > timeoutMs) {
+          fail("DNS lookup timed out", true);
+        }
+        break;
+      }
+
+      case Phase::CONNECTING:
+        checkConnect(nowMs);
+        break;
+
+      default:
+        break;
+    }
+
+    switch (phase) {
+      case Phase::CONNECTED:
+        return Status::CONNECTED;
+      case Phase::FAILED:
+        return Status::FAILED;
+      default:
+        return Status::PENDING;
+    }
+  }
+
+  /// @brief Hand the connected socket to the caller, who then owns it
+  /// @return Socket descriptor, -1 if not connected
+  int release() {
+    if (phase != Phase::CONNECTED) {
+      return -1;
+    }
+    int fd = sock;
+    sock = -1;
+    phase = Phase::IDLE;
+    return fd;
+  }
+
+  void abort() {
+    if (sock >= 0) {
+      lwip_close(sock);
+      sock = -1;
+    }
+    phase = Phase::IDLE;
+  }
+
+  /// @brief Reason of the last failure, nullptr if none
+  const char* getFailure() const {
+    return failure;
+  }
+
+  /// @brief True if the last failure happened before an address was known
+  bool isDnsFailure() const {
+    return dnsFailure;
+  }
+
+private:
+  enum class Phase : uint8_t {
+    IDLE,
+    RESOLVING,
+    CONNECTING,
+    CONNECTED,
+    FAILED
+  };
+
+  typedef DnsHandoff<ip_addr_t> Dns;
+
+  uint32_t timeoutMs;
+  uint16_t port = 0;
+  uint32_t phaseStartMs = 0;
+  Phase phase = Phase::IDLE;
+  int sock = -1;
+  ip_addr_t resolved;
+  Dns dns;
+  const char* failure = nullptr;
+  bool dnsFailure = false;
+
+  /// @brief Runs on the lwIP thread; `arg` is the Ticket of the lookup
+  static void onResolved(const char* /* name */, const ip_addr_t* addr, void* arg) {
+    Dns::deliver(arg, addr);
+  }
+
+  /// @param dns True if the failure happened before an address was known
+  bool fail(const char* reason, bool dns) {
+    dnsFailure = dns;
+    abort();
+    failure = reason;
+    phase = Phase::FAILED;
+    return false;
+  }
+
+  void startConnect(uint32_t nowMs) {
+    sock = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0) {
+      fail("No socket available", false);
+      return;
+    }
+    lwip_fcntl(sock, F_SETFL, lwip_fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = ip4_addr_get_u32(ip_2_ip4(&resolved));
+
+    if (lwip_connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 && errno != EINPROGRESS) {
+      fail("TCP connect refused", false);
+      return;
+    }
+    phase = Phase::CONNECTING;
+    phaseStartMs = nowMs;
+  }
+
+  void checkConnect(uint32_t nowMs) {
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(sock, &writable);
+    struct timeval poll = {0, 0};
+
+    if (lwip_select(sock + 1, nullptr, &writable, nullptr, &poll) <= 0) {
+      if (nowMs - phaseStartMs > timeoutMs) {
+        fail("TCP connect timed out", false);
+      }
+      return;
+    }
+
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (lwip_getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+      fail("TCP connect failed", false);
+      return;
+    }
+
+    // Back to blocking mode, as WiFiClient::connect() leaves its sockets
+    lwip_fcntl(sock, F_SETFL, lwip_fcntl(sock, F_GETFL, 0) & ~O_NONBLOCK);
+    phase = Phase::CONNECTED;
+  }
+};
+#endif
+}
+
+#endif
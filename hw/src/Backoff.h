@@ -0,0 +1,65 @@
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <stdint.h>
+
+namespace FindSpot {
+
+/**
+ * Exponential backoff with decorrelated jitter.
+ *
+ * Each delay is drawn uniformly from [base, 3 * previous delay] and capped,
+ * so retry times grow roughly exponentially while devices that failed
+ * together quickly drift apart instead of retrying in lockstep.
+ *
+ *   uint32_t waitMs = backoff.next();  // after a failure
+ *   backoff.reset();                   // after a success
+ *
+ * Portable C++; the random seed is supplied by the caller (esp_random()
+ * on the device), so runs are reproducible on a host.
+ */
+class Backoff {
+public:
+  Backoff(uint32_t baseMs, uint32_t capMs, uint32_t seed)
+    : baseMs(baseMs), capMs(capMs), delayMs(baseMs), state(seed ? seed : 0x9E3779B9) {}
+
+  /// @brief Delay to wait before the next attempt
+  uint32_t next() {
+    uint64_t upper = static_cast<uint64_t>(delayMs) * 3;
+    if (upper > capMs) {
+      upper = capMs;
+    }
+    uint32_t span = upper > baseMs ? static_cast<uint32_t>(upper) - baseMs : 0;
+    delayMs = baseMs + (span ? random() % (span + 1) : 0);
+    attempt++;
+    return delayMs;
+  }
+
+  void reset() {
+    delayMs = baseMs;
+    attempt = 0;
+  }
+
+  /// @brief Failures since the last reset
+  uint32_t getAttempt() const {
+    return attempt;
+  }
+
+private:
+  uint32_t baseMs;
+  uint32_t capMs;
+  uint32_t delayMs;
+  uint32_t attempt = 0;
+  uint32_t state;
+
+  /// @brief xorshift32
+  uint32_t random() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+};
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "JsonWriter.h"
+
+namespace FindSpot {
+
+/**
+ * Start and end time of each boot phase, in ms since power-on.
+ *
+ * Phases overlap: sensors sample while WiFi associates, the clock syncs in
+ * the background, and registration and MQTT follow as soon as their inputs
+ * are there. The report shows how long each phase took and when it
+ * finished, so it is clear which one held up the first publish.
+ *
+ * Portable C++, no Arduino dependency.
+ */
+class BootTimeline {
+public:
+  enum Phase : uint8_t {
+    SENSORS,        // Pins set up and the first reading of every spot taken
+    WIFI,           // Associated and holding an IP address
+    CLOCK,          // NTP time available
+    REGISTRATION,   // Device ID and MQTT credentials known, cached or from the backend
+    MQTT,           // CONNACK received
+    FIRST_PUBLISH,  // First spot state handed to the broker
+    PHASE_COUNT
+  };
+
+  /// @brief Mark `phase` as started; later calls are ignored
+  void start(Phase phase, uint32_t nowMs) {
+    if (!(started & bit(phase))) {
+      startMs[phase] = nowMs;
+      started |= bit(phase);
+    }
+  }
+
+  /// @brief Mark `phase` as done, starting it too if needed; later calls are ignored
+  void finish(Phase phase, uint32_t nowMs) {
+    start(phase, nowMs);
+    if (!(finished & bit(phase))) {
+      endMs[phase] = nowMs;
+      finished |= bit(phase);
+    }
+  }
+
+  bool isStarted(Phase phase) const {
+    return started & bit(phase);
+  }
+
+  bool isFinished(Phase phase) const {
+    return finished & bit(phase);
+  }
+
+  uint32_t getDurationMs(Phase phase) const {
+    return isFinished(phase) ? endMs[phase] - startMs[phase] : 0;
+  }
+
+  static const char* name(Phase phase) {
+    static const char* const NAMES[PHASE_COUNT] = {"sensors", "wifi", "clock", "registration", "mqtt", "first_publish"};
+    return phase < PHASE_COUNT ? NAMES[phase] : "unknown";
+  }
+
+  /// @brief {"report":"boot","<phase>_ms":duration,"<phase>_at_ms":end,...} for the finished phases
+  /// @return Payload length, or 0 if it does not fit
+  size_t toJson(char* buffer, size_t capacity) const {
+    JsonWriter json(buffer, capacity);
+    json.beginObject().field("report", "boot");
+
+    char key[24];
+    for (uint8_t i = 0; i < PHASE_COUNT; i++) {
+      Phase phase = static_cast<Phase>(i);
+      if (!isFinished(phase)) {
+        continue;
+      }
+      snprintf(key, sizeof(key), "%s_ms", name(phase));
+      json.field(key, static_cast<unsigned long>(getDurationMs(phase)));
+      snprintf(key, sizeof(key), "%s_at_ms", name(phase));
+      json.field(key, static_cast<unsigned long>(endMs[phase]));
+    }
+
+    json.endObject();
+    return json.ok() ? json.length() : 0;
+  }
+
+private:
+  uint32_t startMs[PHASE_COUNT] = {};
+  uint32_t endMs[PHASE_COUNT] = {};
+  uint8_t started = 0;
+  uint8_t finished = 0;
+
+  static uint8_t bit(Phase phase) {
+    return 1u << phase;
+  }
+};
+}
+
+#endif
@@ -6,10 +6,10 @@
 #include <Arduino.h>
 #include <base64.h>  // Built-in Arduino Base64 helper
 #include "SensorInterface.h"
-#include <ArduinoJson.h>
+#include "JsonWriter.h"
 
 namespace FindSpot {
-class CameraDevice : ISensor {
+class CameraDevice : public SensorBase<CameraDevice> {
 private:
   framesize_t frameSize;
   int jpegQuality;
@@ -18,20 +18,19 @@ private:
   char isoTime[30];
 
 public:
-  CameraDevice(const Device& device, const String& sensorTech, int sensorIndex, framesize_t size = FRAMESIZE_QVGA, int quality = 12)
-      : frameSize(size), jpegQuality(quality) {
-        // Initialize base class members
-        type = "camera";
-        technology = sensorTech;
-        index = sensorIndex;
+  static constexpr const char* TYPE = "camera";
+
+  /// @param sensorTech Interned technology name, e.g. a string literal
+  CameraDevice(const Device& device, const char* sensorTech, int sensorIndex, framesize_t size = FRAMESIZE_QVGA, int quality = 12)
+      : SensorBase(sensorTech, sensorIndex), frameSize(size), jpegQuality(quality) {
         //camera_1_esp32_1
-        name = technology + "_" + String(index) + "_" + device.getName() + "_" + device.getId();
+        setName(device.getName().c_str(), device.getId());
         
         // Initialize isoTime with default value
         strcpy(isoTime, "1970-01-01T00:00:00Z");
   }
 
-  void begin() override {
+  void begin() {
     camera_config_t config;
     config.ledc_channel = LEDC_CHANNEL_0;
     config.ledc_timer   = LEDC_TIMER_0;
@@ -82,50 +81,31 @@ public:
     return fb;
   }
 
-  String getName() const override { 
-    return name; 
-  }
-
-  String getType() const override {
-    return type;
-  }
-
-  int getIndex() const override {
-    return index;
-  }
-
-  String getTechnology() const override {
-    return technology;
-  }
-
-  bool checkState() override {
+  bool checkState() {
     // do nothing yet
+    return false;
   }
 
-  String toJson() const override {
-    DynamicJsonDocument* doc = new DynamicJsonDocument(512);
-    if (!doc) {
-      return "{}";
-    }
-    
-    (*doc)["name"] = name;
-    (*doc)["index"] = index;
-    (*doc)["type"] = type;
-    (*doc)["technology"] = technology;
-    (*doc)["resolution"] = frameSizeToString(frameSize);
-    (*doc)["jpeg_quality"] = jpegQuality;
-    (*doc)["image_size"] = lastImageSize;
-    (*doc)["image_base64"] = lastImageBase64;
-    (*doc)["last_updated"] = isoTime;
-
-    String payload;
-    serializeJson(*doc, payload);
-    delete doc;
-    return payload;
+  /// @brief Serialize into `buffer`; size it for the base64 preview when one is captured
+  /// @return Payload length, or 0 if it does not fit
+  size_t toJson(char* buffer, size_t capacity) const {
+    JsonWriter json(buffer, capacity);
+    json.beginObject()
+      .field("name", name)
+      .field("index", index)
+      .field("type", TYPE)
+      .field("technology", technology)
+      .field("resolution", frameSizeToString(frameSize))
+      .field("jpeg_quality", jpegQuality)
+      .field("image_size", static_cast<unsigned long>(lastImageSize))
+      .field("image_base64", lastImageBase64.c_str())
+      .field("last_updated", isoTime)
+      .endObject();
+    return json.length();
   }
 
 private:
-  String frameSizeToString(framesize_t s) const {
+  const char* frameSizeToString(framesize_t s) const {
     switch (s) {
       case FRAMESIZE_QQVGA: return "160x120";
       case FRAMESIZE_QVGA:  return "320x240";
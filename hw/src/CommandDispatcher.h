@@ -0,0 +1,117 @@
+#ifndef COMMAND_DISPATCHER_H
+#define COMMAND_DISPATCHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <ArduinoJson.h>
+#include "TopicFilter.h"
+
+namespace FindSpot {
+
+/**
+ * Routes inbound MQTT messages to command handlers.
+ *
+ * A message on `<filter prefix>/<name>` with a JSON object payload calls the
+ * handler registered for `name`; raw handlers get the payload bytes as they
+ * are. JSON payloads are parsed in place: ArduinoJson
+ * reads from the mutable receive buffer, so strings in the arguments point
+ * into it and nothing is copied. Handlers must finish in constant time;
+ * anything longer (e.g. a snapshot of every spot) should only be scheduled.
+ *
+ *   dispatcher.compile("device/7/cmd/#");
+ *   dispatcher.on("snapshot", onSnapshot);
+ *   dispatcher.dispatch(topic, payload, length);
+ */
+template <size_t JSON_CAPACITY>
+class CommandDispatcher {
+public:
+  typedef bool (*Handler)(JsonObjectConst args);
+  typedef bool (*RawHandler)(const uint8_t* payload, size_t length);
+
+  enum class Result : uint8_t {
+    HANDLED,
+    NOT_A_COMMAND,  // Topic does not match the filter
+    UNKNOWN,        // No handler for the command name
+    BAD_PAYLOAD,    // Oversized, not JSON, or not an object
+    REJECTED        // Handler refused the arguments
+  };
+
+  static const uint8_t MAX_COMMANDS = 8;
+
+  bool compile(const char* filter) {
+    return topicFilter.compile(filter);
+  }
+
+  const char* getFilter() const {
+    return topicFilter.c_str();
+  }
+
+  /// @brief Register `handler` for `name`; the name must outlive the dispatcher
+  bool on(const char* name, Handler handler) {
+    if (commandCount == MAX_COMMANDS) {
+      return false;
+    }
+    commands[commandCount++] = {name, handler, nullptr};
+    return true;
+  }
+
+  /// @brief Register `handler` for `name`, called with the unparsed payload
+  bool onRaw(const char* name, RawHandler handler) {
+    if (commandCount == MAX_COMMANDS) {
+      return false;
+    }
+    commands[commandCount++] = {name, nullptr, handler};
+    return true;
+  }
+
+  /// @param payload Mutable message buffer, parsed in place
+  Result dispatch(const char* topic, uint8_t* payload, size_t length) {
+    const char* name;
+    if (!topicFilter.match(topic, &name)) {
+      return Result::NOT_A_COMMAND;
+    }
+
+    const Command* command = nullptr;
+    for (uint8_t i = 0; i < commandCount; i++) {
+      if (strcmp(commands[i].name, name) == 0) {
+        command = &commands[i];
+        break;
+      }
+    }
+    if (!command) {
+      return Result::UNKNOWN;
+    }
+    if (command->raw) {
+      return command->raw(payload, length) ? Result::HANDLED : Result::REJECTED;
+    }
+    Handler handler = command->handler;
+
+    // An empty payload means "no arguments"
+    if (length == 0) {
+      doc.clear();
+      return handler(doc.template to<JsonObject>()) ? Result::HANDLED : Result::REJECTED;
+    }
+
+    DeserializationError error = deserializeJson(doc, reinterpret_cast<char*>(payload), length);
+    if (error || !doc.template is<JsonObject>()) {
+      return Result::BAD_PAYLOAD;
+    }
+    return handler(doc.template as<JsonObjectConst>()) ? Result::HANDLED : Result::REJECTED;
+  }
+
+private:
+  struct Command {
+    const char* name;
+    Handler handler;
+    RawHandler raw;
+  };
+
+  TopicFilter topicFilter;
+  Command commands[MAX_COMMANDS] = {};
+  uint8_t commandCount = 0;
+  StaticJsonDocument<JSON_CAPACITY> doc;
+};
+}
+
+#endif
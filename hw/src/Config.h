@@ -4,7 +4,20 @@
 // ==================== WiFi & Backend HTTP Configuration =============== //
 // Include for WIFI_SSID, WIFI_PASS, and server settings for device registration
 #include "env.h"
+#define WIFI_CONNECT_TIMEOUT_MS  30000 // A full scan-and-associate is restarted if it has not completed by then
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 3000 // Directed reconnect to the cached BSSID/channel; then a full scan
+#define WIFI_REUSE_LEASE         0     // 1: fast reconnects reuse the cached IP lease and skip DHCP (needs long leases)
+#define WIFI_NVS_KEY             "wifi"
+#define WIFI_RETRY_BASE_MS       1000  // Failed scans are retried with decorrelated-jitter backoff
+#define WIFI_RETRY_CAP_MS        30000
 #define BACKEND_REGISTER_URL     "api/device/register"
+#define REGISTER_RETRY_BASE_MS   2000  // Registration retries use decorrelated-jitter backoff
+#define REGISTER_RETRY_CAP_MS    60000
+#define REGISTRATION_NVS_KEY     "registration" // Last registration, reused at boot and revalidated in the background
+#define REGISTER_TASK_STACK      8192           // Registration runs in its own task so sampling never waits on HTTP
+#define REGISTRATION_JSON_CAPACITY 768          // ArduinoJson pool for the filtered registration reply
+#define REGISTRATION_CONFIG_LEN    192          // Longest settings update accepted with a registration
+#define REGISTRATION_ERROR_EXCERPT 96           // Bytes of an error reply kept for the log
 
 // ==================== Device Configuration ============================ //
 #define DEVICE_PREFIX    "esp32_dev"
@@ -13,12 +26,87 @@
 #define DEVICE_LONGITUDE 21.240075184660427
 
 // ==================== Sensor Configuration ============================ //
-// Distance sensor settings
-#define DISTANCE_MIN_CM 5
-#define DISTANCE_MAX_CM 50 // Distance below this means occupied
+// Sensor pins, indices and crosstalk groups are declared in SensorTable.h; pins can be remapped at runtime
 
-// Timing settings
-#define SENSOR_READ_INTERVAL 1000  // Read sensors every 10 seconds (in milliseconds)
+// Distance sensor settings (defaults; RuntimeConfig may override them)
+#define DISTANCE_MIN_CM  5
+#define DISTANCE_MAX_CM  50 // Distance below this means occupied
+#define DISTANCE_EXIT_CM 60 // An occupied spot is freed only above this distance (hysteresis)
+
+// Speed of sound compensation
+#define SOUND_TEMP_COMPENSATION 0  // 1: scale echo times by air temperature, 0: fixed 340 m/s
+#define AMBIENT_TEMPERATURE_C   20 // Assumed air temperature until a measured one is set
+
+// Occupancy filtering
+#define OCCUPANCY_FILTER_WINDOW 5    // Samples in the running median (odd)
+#define OCCUPANCY_DWELL_MS      2000 // New state must hold this long before it is published
+
+// Size of the buffer sensor JSON payloads are serialized into
+#define SENSOR_PAYLOAD_SIZE 256
+
+// Payload format requested at registration: "json" or "binary".
+// Binary is only used if the backend confirms it in the registration response. It carries no
+// sensor name or pins, so opt in only once the backend fills them in from the registration.
+#define SENSOR_PAYLOAD_FORMAT "json"
+
+// Publish modes, may be combined
+#define PUBLISH_PER_SENSOR  0x01 // One message per changed spot on device/{id}/sensors/{index}
+#define PUBLISH_AGGREGATED  0x02 // Occupancy bitmap + changed distances on device/{id}/occupancy (binary)
+#define SENSOR_PUBLISH_MODE PUBLISH_PER_SENSOR
+#define AGGREGATE_WINDOW_MS 500  // Changes within this window share one aggregated message
+
+// Store-and-forward of per-sensor transitions while the broker is unreachable
+#define OUTBOX_CAPACITY      16                    // Transitions held in RAM
+#define OUTBOX_LOG_PATH      "/littlefs/outbox.log" // Append-only overflow log on LittleFS
+#define OUTBOX_LOG_MAX_BYTES 16384                 // Flash budget, ~1500 transitions
+#define OUTBOX_DRAIN_BATCH   8                     // Most transitions sent per networking pass
+
+// Timing settings; the interval range is also a RuntimeConfig default
+#define SENSOR_INTERVAL_MIN_MS 250   // Scan period; sampling rate of a spot that is changing
+#define SENSOR_INTERVAL_MAX_MS 8000  // Slowest sampling of a spot that has been stable for a while
+#define SCAN_SLOT_MS         40    // Separation between crosstalk groups; must cover the echo timeout
+
+// Runtime settings (intervals, thresholds, pins) persisted in NVS
+#define CONFIG_NVS_NAMESPACE "findspot"
+#define CONFIG_NVS_KEY       "settings"
+
+// ==================== MQTT Configuration ============================== //
+#define MQTT_PUBLISH_QOS     1    // 1: sensor messages are retransmitted until the broker acknowledges them
+#define MQTT_INFLIGHT_WINDOW 4    // Unacknowledged QoS 1 messages at a time
+#define MQTT_RETRY_MS        5000 // Retransmit a message not acknowledged within this time
+#define MQTT_KEEPALIVE_S     60
+#define MQTT_CONNECT_TIMEOUT_MS 5000 // Limit for each connect phase: DNS, TCP, CONNACK
+#define MQTT_PACKET_SIZE     512  // Largest packet sent or received
+#define MQTT_RETAIN_STATE    1    // Broker keeps each spot's latest state for new subscribers
+
+// Reconnect with decorrelated-jitter backoff so a fleet does not retry in lockstep
+#define MQTT_RECONNECT_BASE_MS   1000
+#define MQTT_RECONNECT_CAP_MS    60000
+#define MQTT_RECONNECT_STABLE_MS 30000 // A connection up this long resets the backoff
+
+// Connection-quality telemetry on device/{id}/telemetry
+#define MQTT_TELEMETRY_INTERVAL_MS 60000
+#define MQTT_TELEMETRY_SIZE        448 // Link metrics with every counter at UINT32_MAX take 442 bytes
+
+// Inbound commands on device/{id}/cmd/<name>: interval, thresholds, config, snapshot
+#define COMMAND_JSON_CAPACITY 256 // ArduinoJson pool for one command's arguments
+
+// ==================== Task Configuration ============================== //
+// Sampling and networking run as separate tasks on the two cores, linked by lock-free queues
+#define SENSE_TASK_CORE        1    // Where the Arduino loop runs, away from the WiFi and lwIP tasks
+#define SENSE_TASK_STACK       4096
+#define SENSE_TASK_PRIORITY    2
+#define SENSE_TASK_PERIOD_MS   1    // Pause between passes; echoes are timed by interrupts meanwhile
+#define NETWORK_TASK_CORE      0    // Next to the WiFi stack
+#define NETWORK_TASK_STACK     8192
+#define NETWORK_TASK_PRIORITY  1
+#define NETWORK_TASK_PERIOD_MS 2
+#define TRANSITION_QUEUE_CAPACITY 32 // Transitions between the tasks; a power of two, at least SENSOR_COUNT
+
+// ==================== Logging ========================================= //
+// 0 none, 1 error, 2 warn, 3 info, 4 debug; higher levels are compiled out
+#define LOG_LEVEL       3
+#define LOG_RING_BUFFER 1 // 1: lines go to a RAM ring printed by a low-priority task, 0: print inline
 
 // ==================== Camera Configuration ============================ //
 // TODO: Camera module will be added in future 
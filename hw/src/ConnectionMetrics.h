@@ -0,0 +1,133 @@
+#ifndef CONNECTION_METRICS_H
+#define CONNECTION_METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "JsonWriter.h"
+
+namespace FindSpot {
+
+/**
+ * Connection-quality counters of one link (MQTT broker or backend).
+ *
+ * Tracks attempts, failures by cause, a histogram of how long successful
+ * attempts took, and the fraction of time the link was up. Serialized with
+ * toJson() for the telemetry topic.
+ *
+ * Portable C++, no Arduino dependency.
+ */
+class ConnectionMetrics {
+public:
+  /// @brief Failure causes; CONNACK return codes 1..5 map onto REFUSED + rc - 1
+  enum Failure : uint8_t {
+    DNS,
+    TCP,
+    TIMEOUT,
+    REFUSED,
+    FAILURE_KINDS = REFUSED + 5
+  };
+
+  static constexpr uint8_t HISTOGRAM_BUCKETS = 7;
+
+  /// @brief Upper bounds of the time-to-connect buckets; the last one is open-ended
+  static constexpr uint32_t BUCKET_LIMIT_MS[HISTOGRAM_BUCKETS - 1] = {250, 500, 1000, 2000, 5000, 10000};
+
+  void onAttempt(uint32_t nowMs) {
+    attempts++;
+    attemptStartMs = nowMs;
+  }
+
+  void onConnected(uint32_t nowMs) {
+    uint32_t took = nowMs - attemptStartMs;
+    uint8_t bucket = 0;
+    while (bucket < HISTOGRAM_BUCKETS - 1 && took >= BUCKET_LIMIT_MS[bucket]) {
+      bucket++;
+    }
+    connectHistogram[bucket]++;
+    connects++;
+    up = true;
+    upSinceMs = nowMs;
+  }
+
+  void onFailure(Failure cause) {
+    failures[cause < FAILURE_KINDS ? cause : TIMEOUT]++;
+  }
+
+  /// @brief CONNACK refusal with MQTT return code `rc`
+  void onRefused(uint8_t rc) {
+    onFailure(rc >= 1 && rc <= 5 ? static_cast<Failure>(REFUSED + rc - 1) : REFUSED);
+  }
+
+  void onDisconnected(uint32_t nowMs) {
+    if (up) {
+      upMs += nowMs - upSinceMs;
+      up = false;
+    }
+  }
+
+  /// @brief Share of time since `startMs` the link was up, in 1/1000
+  uint16_t uptimePermille(uint32_t startMs, uint32_t nowMs) const {
+    uint32_t total = nowMs - startMs;
+    uint64_t upTotal = upMs + (up ? nowMs - upSinceMs : 0);
+    return total ? static_cast<uint16_t>(upTotal * 1000 / total) : (up ? 1000 : 0);
+  }
+
+  uint32_t getAttempts() const {
+    return attempts;
+  }
+
+  uint32_t getFailures() const {
+    uint32_t total = 0;
+    for (uint32_t count : failures) {
+      total += count;
+    }
+    return total;
+  }
+
+  /// @return Payload length, or 0 if it does not fit
+  size_t toJson(const char* link, uint32_t startMs, uint32_t nowMs, char* buffer, size_t capacity) const {
+    JsonWriter json(buffer, capacity);
+    json.beginObject()
+      .field("link", link)
+      .field("attempts", static_cast<unsigned long>(attempts))
+      .field("connects", static_cast<unsigned long>(connects))
+      .field("fail_dns", static_cast<unsigned long>(failures[DNS]))
+      .field("fail_tcp", static_cast<unsigned long>(failures[TCP]))
+      .field("fail_timeout", static_cast<unsigned long>(failures[TIMEOUT]));
+
+    // One counter per CONNACK return code: fail_rc1 .. fail_rc5
+    char key[sizeof("connect_") + 10];  // Longest key: a 10-digit bucket limit
+    for (uint8_t rc = 1; rc <= 5; rc++) {
+      snprintf(key, sizeof(key), "fail_rc%u", rc);
+      json.field(key, static_cast<unsigned long>(failures[REFUSED + rc - 1]));
+    }
+
+    // Time to connect: connect_250 .. connect_10000, then connect_inf
+    for (uint8_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+      if (i < HISTOGRAM_BUCKETS - 1) {
+        snprintf(key, sizeof(key), "connect_%lu", static_cast<unsigned long>(BUCKET_LIMIT_MS[i]));
+      } else {
+        snprintf(key, sizeof(key), "connect_inf");
+      }
+      json.field(key, static_cast<unsigned long>(connectHistogram[i]));
+    }
+
+    json.field("uptime_permille", static_cast<int>(uptimePermille(startMs, nowMs)))
+      .endObject();
+    return json.length();
+  }
+
+private:
+  uint32_t attempts = 0;
+  uint32_t connects = 0;
+  uint32_t failures[FAILURE_KINDS] = {};
+  uint32_t connectHistogram[HISTOGRAM_BUCKETS] = {};
+  uint32_t attemptStartMs = 0;
+  uint32_t upSinceMs = 0;
+  uint64_t upMs = 0;
+  bool up = false;
+};
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef DISTANCE_CONVERSION_H
+#define DISTANCE_CONVERSION_H
+
+#include <stdint.h>
+
+namespace FindSpot {
+
+/**
+ * Integer echo-time to distance conversion.
+ *
+ * distance_mm = pulse_us * c / 2000, with c the speed of sound in m/s. The
+ * factor c / 2000 is kept as an unsigned Q20 fixed-point number, so a sample
+ * costs one 32x32->64 multiply and a shift. Scale factors are constexpr and
+ * rounded up, so a result is never short: it equals the exact product for
+ * every pulse width up to the echo timeout at the fixed 340 m/s, and is at
+ * most 1 mm long with a temperature-compensated scale.
+ */
+namespace DistanceConversion {
+
+constexpr uint8_t SCALE_BITS = 20;
+
+/// @brief Speed of sound in dm/s for an air temperature in tenths of a degree C
+/// @note Linear approximation c = 331.3 + 0.606 * T, valid for outdoor temperatures
+constexpr int32_t speedOfSoundDmps(int32_t deciCelsius) {
+  return 3313 + (606 * deciCelsius + (deciCelsius >= 0 ? 500 : -500)) / 1000;
+}
+
+/// @brief Q20 millimetres-per-microsecond factor for a speed of sound in dm/s
+constexpr uint32_t scaleForSpeed(int32_t speedDmps) {
+  // mm/us = (dm/s / 10) / 2000 = dm/s / 20000; round up (see above)
+  return static_cast<uint32_t>(((static_cast<uint64_t>(speedDmps) << SCALE_BITS) + 19999) / 20000);
+}
+
+constexpr uint32_t scaleForTemperature(int32_t deciCelsius) {
+  return scaleForSpeed(speedOfSoundDmps(deciCelsius));
+}
+
+// 0.034 cm/us, the constant the floating-point path has always used (340 m/s)
+constexpr uint32_t FIXED_SPEED_SCALE = scaleForSpeed(3400);
+
+static_assert(scaleForSpeed(3400) == 178258, "Fixed-speed scale must match 0.017 mm/us in Q20");
+static_assert(speedOfSoundDmps(200) == 3434, "343.4 m/s expected at 20 C");
+
+/// @brief Convert an echo width to millimetres with a precomputed scale
+inline uint32_t pulseToMm(uint32_t pulseUs, uint32_t scale) {
+  return static_cast<uint32_t>((static_cast<uint64_t>(pulseUs) * scale) >> SCALE_BITS);
+}
+}
+}
+
+#endif
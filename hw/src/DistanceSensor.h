@@ -2,128 +2,202 @@
 #define DISTANCE_SENSOR_H
 
 #include <Arduino.h>
-#include "Device.h"
 #include "SensorInterface.h"
+#include "EchoCapture.h"
+#include "OccupancyFilter.h"
+#include "DistanceConversion.h"
+#include "AdaptiveInterval.h"
+#include "SensorTable.h"
+#include "JsonWriter.h"
+#include "PayloadCodec.h"
+#include "Log.h"
 #include "Config.h"
 
 #define INVALID_DISTANCE -1
 
+// time() values below this mean NTP has not synchronized yet (2020-01-01)
+#define CLOCK_VALID_AFTER 1577836800
+
 namespace FindSpot {
 
-class DistanceSensor : public ISensor {
+class DistanceSensor final : public SensorBase<DistanceSensor> {
 private:
-  int trigPin;
-  int echoPin;
-  char isoTime[30];
-  long lastDistance = INVALID_DISTANCE;
-  bool occupied = false;
-
+  EchoChannel echoChannel;
+  uint8_t crosstalkGroup;
+  uint32_t lastUpdated = 0;
+  long lastDistanceMm = INVALID_DISTANCE;
+  uint32_t mmScale = SOUND_TEMP_COMPENSATION
+    ? DistanceConversion::scaleForTemperature(AMBIENT_TEMPERATURE_C * 10)
+    : DistanceConversion::FIXED_SPEED_SCALE;
+  OccupancyFilter<OCCUPANCY_FILTER_WINDOW> filter;
+  AdaptiveInterval sampling;
 
 public:
-  DistanceSensor(const Device& device, const String& sensorTech, int sensorIndex, int trig, int echo)
-    : trigPin(trig), echoPin(echo) {
-      // Initialize base class members
-      type = "distance";
-      technology = sensorTech;
-      index = sensorIndex;
-      // Format: ultrasonic_0_esp32_dev_1 (includes device ID)
-      name = technology + "_" + String(index) + "_" + device.getName() + "_" + String(device.getId());
-      
-      // Initialize isoTime with default value
-      strcpy(isoTime, "1970-01-01T00:00:00Z");
+  static constexpr const char* TYPE = "distance";
+
+  /// @brief Placeholder for `last_updated` until the clock is synchronized
+  static constexpr const char* UNSYNCED_TIME = "1970-01-01T00:00:00Z";
+
+  /// @brief What the JSON payload says about a sensor besides its state.
+  /// The networking task keeps its own copy, so publishing never reads a sensor the sensing task is updating.
+  struct Label {
+    char name[SENSOR_NAME_LEN];
+    const char* technology;
+    int trigPin;
+    int echoPin;
+  };
+
+  explicit DistanceSensor(const SensorSpec& spec)
+    : SensorBase(spec.technology, spec.index),
+      echoChannel(spec.trigPin, spec.echoPin), crosstalkGroup(spec.group),
+      filter(DISTANCE_MIN_CM, DISTANCE_MAX_CM, DISTANCE_EXIT_CM, OCCUPANCY_DWELL_MS),
+      sampling(SENSOR_INTERVAL_MIN_MS, SENSOR_INTERVAL_MAX_MS) {}
+
+  void begin() {
+    echoChannel.begin();
   }
 
-  void begin() override {
-    pinMode(trigPin, OUTPUT);
-    pinMode(echoPin, INPUT);
+  /// @brief Fire a ping; the result is collected by a later `checkState()`
+  /// @return False if the previous echo is still pending
+  bool trigger() {
+    return echoChannel.trigger();
   }
 
-  /// @brief Calculate the `lastDistance`, and set `occupied` if the parking spot is to consider taken 
-  /// @return True if parking spot is occupied (car detected), false otherwise
-  bool checkState() override {
+  /// @brief Called once per scan in this sensor's slot; pings only when the adaptive interval has elapsed
+  /// @return True if a ping was fired
+  bool triggerIfDue() {
+    return sampling.tick() && trigger();
+  }
+
+  /// @brief Current sampling interval, short while the spot is changing and long while it is stable
+  uint32_t getSampleIntervalMs() const {
+    return sampling.getIntervalMs();
+  }
+
+  /// @brief Change the adaptive sampling range; `minMs` must match the scan period
+  void setSamplingLimits(uint32_t minMs, uint32_t maxMs) {
+    sampling.setLimits(minMs, maxMs);
+  }
+
+  /// @brief Retune the occupancy thresholds; samples at the floor rate until the spot settles again
+  void setThresholds(uint16_t minCm, uint16_t enterCm, uint16_t exitCm) {
+    filter.setThresholds(minCm, enterCm, exitCm);
+    sampling.reset();
+  }
 
-    lastDistance = getDistance();
-    Serial.print(lastDistance);
-    Serial.println(" cm");
+  /// @brief Rewire to another trigger/echo pair without a restart
+  void setPins(uint8_t trigPin, uint8_t echoPin) {
+    echoChannel.setPins(trigPin, echoPin);
+    sampling.reset();
+  }
 
-    // Occupied when distance is valid AND within the threshold (car is close enough)
-    if(lastDistance <= DISTANCE_MAX_CM && lastDistance >= DISTANCE_MIN_CM)
-      occupied = true;
-    else {
-      occupied = false;
+  uint8_t getGroup() const {
+    return crosstalkGroup;
+  }
+
+  /// @brief Feed the latest completed echo into the occupancy filter.
+  /// Never waits for the echo; returns the previous state until a new measurement completes.
+  /// @return True if parking spot is occupied (car detected), false otherwise
+  bool checkState() {
+    uint32_t pulseUs;
+    if (!echoChannel.poll(pulseUs)) {
+      return filter.isOccupied();
     }
 
-    // Update timestamp - simplified to avoid strftime issues
-    strcpy(isoTime, "2025-01-01T00:00:00Z");
+    lastDistanceMm = getDistanceMm(pulseUs);
+    long distanceCm = lastDistanceMm == INVALID_DISTANCE ? INVALID_DISTANCE : lastDistanceMm / 10;
+
+    LOG_DEBUG("%s_%d: %ld cm", technology, index, distanceCm);
+
+    // Median + hysteresis + dwell time; a single outlier never flips the state
+    bool occupied = filter.update(distanceCm, millis());
+    sampling.onSample(filter.isTransitioning());
+
+    // Formatted only when published, on the networking task
+    time_t now = time(nullptr);
+    lastUpdated = now > CLOCK_VALID_AFTER ? static_cast<uint32_t>(now) : 0;
 
     return occupied;
   }
 
-  long getDistance() {
-    // Disable interrupts temporarily to get a clean reading
-    noInterrupts();
-    digitalWrite(trigPin, LOW);
-    delayMicroseconds(2);
-    digitalWrite(trigPin, HIGH);
-    delayMicroseconds(10);
-    digitalWrite(trigPin, LOW);
-    interrupts();
-    
-    // Use shorter timeout (30ms) to prevent blocking too long
-    long duration = pulseIn(echoPin, HIGH, 30000);
-    
-    // If pulseIn times out, it returns 0
-    if (duration == 0) {
+  /// @brief Convert an echo pulse width to millimetres (integer fixed-point)
+  /// @param pulseUs Echo width reported by the capture, 0 on timeout
+  long getDistanceMm(uint32_t pulseUs) const {
+    if (pulseUs == 0) {
       return INVALID_DISTANCE;
     }
     
-    long distance = (duration * 0.034 / 2);
-
-    return (distance < DISTANCE_MIN_CM || distance > DISTANCE_MAX_CM) 
-      ? INVALID_DISTANCE 
-      : distance;
+    return DistanceConversion::pulseToMm(pulseUs, mmScale);
   }
 
-  String getName() const override { 
-    return name; 
+  /// @brief Most recent raw distance in millimetres, INVALID_DISTANCE if the echo was lost
+  long getLastDistanceMm() const {
+    return lastDistanceMm;
   }
 
-  String getType() const override {
-    return type;
+  /// @brief Compensate the speed of sound for a measured air temperature
+  /// @note Has no effect unless SOUND_TEMP_COMPENSATION is enabled
+  void setAmbientTemperature(int16_t deciCelsius) {
+    if (SOUND_TEMP_COMPENSATION) {
+      mmScale = DistanceConversion::scaleForTemperature(deciCelsius);
+    }
   }
 
-  int getIndex() const override {
-    return index;
+  /// @brief Filtered distance used for the occupancy decision
+  long getFilteredDistance() const {
+    uint16_t median = filter.getMedian();
+    return median == filter.NO_ECHO ? INVALID_DISTANCE : median;
   }
 
-  String getTechnology() const override {
-    return technology;
+  /// @brief Compact view of the state for the binary payload format
+  SensorUpdate getUpdate() const {
+    long distance = getFilteredDistance();
+    SensorUpdate update;
+    update.index = index;
+    update.occupied = filter.isOccupied();
+    update.distanceCm = distance == INVALID_DISTANCE ? PayloadCodec::NO_DISTANCE : distance;
+    update.timestamp = lastUpdated;
+    return update;
   }
 
-  String toJson() const override {
-    // Use smaller static JSON document to reduce memory usage
-    StaticJsonDocument<256> doc;
-    
-    doc["name"] = name;
-    doc["index"] = index;
-    doc["type"] = type;
-    doc["technology"] = technology;
-    doc["trigger_pin"] = trigPin;
-    doc["echo_pin"] = echoPin;
-    doc["is_occupied"] = occupied;
-    doc["current_distance"] = lastDistance;
-    doc["last_updated"] = isoTime;
-
-    String payload;
-    payload.reserve(200); // Pre-allocate to avoid fragmentation
-    size_t len = serializeJson(doc, payload);
-    
-    if (len == 0) {
-      Serial.println("JSON serialization failed!");
-      return "";
+  /// @brief Serialize a transition straight into `buffer`, without heap allocation; reads no sensor
+  /// @return Payload length, or 0 if it does not fit
+  static size_t toJson(const Label& label, const SensorUpdate& update, char* buffer, size_t capacity) {
+    char timestamp[30];
+    formatTimestamp(update.timestamp, timestamp, sizeof(timestamp));
+
+    JsonWriter json(buffer, capacity);
+    json.beginObject()
+      .field("name", label.name)
+      .field("index", static_cast<int>(update.index))
+      .field("type", TYPE)
+      .field("technology", label.technology)
+      .field("trigger_pin", label.trigPin)
+      .field("echo_pin", label.echoPin)
+      .field("is_occupied", update.occupied)
+      .field("current_distance", update.distanceCm == PayloadCodec::NO_DISTANCE ? INVALID_DISTANCE : update.distanceCm)
+      .field("last_updated", timestamp)
+      .endObject();
+
+    if (!json.ok()) {
+      LOG_ERROR("%s: JSON serialization failed", label.name);
     }
     
-    return payload;
+    return json.length();
+  }
+
+private:
+  /// @brief ISO 8601 UTC time of `seconds`, or the placeholder before the clock is synchronized
+  static void formatTimestamp(uint32_t seconds, char* out, size_t capacity) {
+    if (seconds == 0) {
+      snprintf(out, capacity, "%s", UNSYNCED_TIME);
+      return;
+    }
+    time_t t = seconds;
+    struct tm utc;
+    gmtime_r(&t, &utc);
+    snprintf(out, capacity, "%04d-%02d-%02dT%02d:%02d:%02dZ",
+             utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec);
   }
 };
 }
@@ -0,0 +1,169 @@
+#ifndef ECHO_CAPTURE_H
+#define ECHO_CAPTURE_H
+
+#include <stdint.h>
+#include <atomic>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+// Maximum echo wait before a measurement is reported as lost (~5 m round trip)
+#define ECHO_TIMEOUT_US 30000
+
+namespace FindSpot {
+
+/**
+ * Edge-driven echo pulse measurement.
+ *
+ * The ISR side only calls `onEdge()` with the pin level and a timestamp; the
+ * loop side calls `arm()` after firing the trigger and `poll()` to collect the
+ * pulse width. The two sides hand over through a single atomic state word, so
+ * no interrupt masking or blocking wait is needed. Time and pin access are
+ * injected, which lets the state machine run on a host with simulated edges.
+ */
+class EchoCapture {
+public:
+  enum State : uint8_t {
+    IDLE,       // No measurement in progress
+    WAIT_RISE,  // Trigger fired, waiting for the echo line to go high
+    WAIT_FALL,  // Echo high, waiting for it to drop
+    DONE        // Pulse width published, waiting for poll()
+  };
+
+  /// @brief Start a measurement; call right after the trigger pulse
+  /// @return False if a measurement is still in progress
+  bool arm(uint32_t nowUs) {
+    uint8_t expected = IDLE;
+    if (!state.compare_exchange_strong(expected, WAIT_RISE, std::memory_order_acq_rel)) {
+      return false;  // The running measurement keeps its start time, and with it its timeout
+    }
+    armedAtUs = nowUs;  // Only poll() reads it, on this same side
+    return true;
+  }
+
+  /// @brief Feed an echo pin transition; safe to call from an ISR
+  void onEdge(bool level, uint32_t nowUs) {
+    uint8_t current = state.load(std::memory_order_acquire);
+    if (current == WAIT_RISE && level) {
+      riseUs = nowUs;
+      state.compare_exchange_strong(current, WAIT_FALL, std::memory_order_acq_rel);
+    } else if (current == WAIT_FALL && !level) {
+      widthUs = nowUs - riseUs;
+      state.compare_exchange_strong(current, DONE, std::memory_order_acq_rel);
+    }
+  }
+
+  /// @brief Collect a finished measurement without blocking
+  /// @param pulseUs Set to the echo width, or 0 when the echo timed out
+  /// @return True if a measurement completed (or timed out) since the last call
+  bool poll(uint32_t nowUs, uint32_t& pulseUs) {
+    uint8_t current = state.load(std::memory_order_acquire);
+
+    if (current == DONE) {
+      pulseUs = widthUs;
+      state.store(IDLE, std::memory_order_release);
+      return true;
+    }
+
+    if (current != IDLE && nowUs - armedAtUs > ECHO_TIMEOUT_US) {
+      // Lose the race gracefully: if the ISR just finished, the next poll picks it up
+      if (state.compare_exchange_strong(current, IDLE, std::memory_order_acq_rel)) {
+        pulseUs = 0;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool isIdle() const {
+    return state.load(std::memory_order_acquire) == IDLE;
+  }
+
+  /// @brief Abandon any measurement in progress; the ISR must be detached
+  void reset() {
+    state.store(IDLE, std::memory_order_release);
+  }
+
+private:
+  std::atomic<uint8_t> state{IDLE};
+  uint32_t armedAtUs = 0;
+  volatile uint32_t riseUs = 0;
+  volatile uint32_t widthUs = 0;
+};
+
+#ifdef ARDUINO
+/**
+ * Binds an EchoCapture to a trigger/echo pin pair on the ESP32.
+ * The echo pin raises an interrupt on every edge and timestamps it with micros().
+ */
+class EchoChannel {
+public:
+  EchoChannel(int trig, int echo) : trigPin(trig), echoPin(echo) {}
+
+  void begin() {
+    pinMode(trigPin, OUTPUT);
+    digitalWrite(trigPin, LOW);
+    pinMode(echoPin, INPUT);
+    attachInterruptArg(digitalPinToInterrupt(echoPin), onEchoEdge, this, CHANGE);
+    started = true;
+  }
+
+  /// @brief Move to another pin pair; once started, the old pins are released and the new ones armed
+  void setPins(int trig, int echo) {
+    if (started) {
+      detachInterrupt(digitalPinToInterrupt(echoPin));
+      pinMode(trigPin, INPUT);
+    }
+    trigPin = trig;
+    echoPin = echo;
+    capture.reset();
+    if (started) {
+      begin();
+    }
+  }
+
+  /// @brief Emit the 10us trigger pulse and arm the capture
+  /// @return False if the previous measurement has not finished yet
+  bool trigger() {
+    if (!capture.isIdle()) {
+      return false;
+    }
+    digitalWrite(trigPin, HIGH);
+    delayMicroseconds(10);
+    digitalWrite(trigPin, LOW);
+    return capture.arm(micros());
+  }
+
+  bool poll(uint32_t& pulseUs) {
+    return capture.poll(micros(), pulseUs);
+  }
+
+  bool isIdle() const {
+    return capture.isIdle();
+  }
+
+  int getTrigPin() const {
+    return trigPin;
+  }
+
+  int getEchoPin() const {
+    return echoPin;
+  }
+
+private:
+  int trigPin;
+  int echoPin;
+  bool started = false;
+  EchoCapture capture;
+
+  static void IRAM_ATTR onEchoEdge(void* arg) {
+    EchoChannel* self = static_cast<EchoChannel*>(arg);
+    self->capture.onEdge(digitalRead(self->echoPin), micros());
+  }
+};
+#endif
+}
+
+#endif
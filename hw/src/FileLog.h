@@ -0,0 +1,82 @@
+#ifndef FILE_LOG_H
+#define FILE_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+namespace FindSpot {
+
+/**
+ * Append-only byte log in a single file, through stdio.
+ *
+ * On the ESP32 the path points into the mounted LittleFS partition
+ * (e.g. "/littlefs/outbox.log"); on a host it is an ordinary file, which is
+ * what the outbox is tested against. Every append is closed before returning,
+ * which is the point at which LittleFS commits it, so a power loss can tear
+ * at most the record being written.
+ *
+ * This is the storage interface Outbox expects:
+ *   bool append(const uint8_t* data, size_t length);
+ *   size_t read(size_t offset, uint8_t* out, size_t length);
+ *   size_t size();
+ *   bool clear();
+ */
+class FileLog {
+public:
+  explicit FileLog(const char* path) : path(path) {}
+
+  bool append(const uint8_t* data, size_t length) {
+    FILE* file = fopen(path, "ab");
+    if (!file) {
+      return false;
+    }
+    size_t written = fwrite(data, 1, length, file);
+    bool closed = fclose(file) == 0;
+    if (cachedSize != UNKNOWN) {
+      cachedSize += written;
+    }
+    return written == length && closed;
+  }
+
+  /// @return Bytes read, short at the end of the log
+  size_t read(size_t offset, uint8_t* out, size_t length) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+      return 0;
+    }
+    size_t n = fseek(file, static_cast<long>(offset), SEEK_SET) == 0 ? fread(out, 1, length, file) : 0;
+    fclose(file);
+    return n;
+  }
+
+  size_t size() {
+    if (cachedSize == UNKNOWN) {
+      cachedSize = 0;
+      FILE* file = fopen(path, "rb");
+      if (file) {
+        if (fseek(file, 0, SEEK_END) == 0) {
+          long end = ftell(file);
+          cachedSize = end > 0 ? static_cast<size_t>(end) : 0;
+        }
+        fclose(file);
+      }
+    }
+    return cachedSize;
+  }
+
+  bool clear() {
+    cachedSize = 0;
+    remove(path);
+    return true;
+  }
+
+private:
+  static constexpr size_t UNKNOWN = static_cast<size_t>(-1);
+
+  const char* path;
+  size_t cachedSize = UNKNOWN;
+};
+}
+
+#endif
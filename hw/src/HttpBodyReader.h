@@ -0,0 +1,201 @@
+#ifndef HTTP_BODY_READER_H
+#define HTTP_BODY_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace FindSpot {
+
+/**
+ * Byte reader over an HTTP response body that undoes chunked transfer encoding.
+ *
+ * Once the headers are read, HTTPClient hands out the raw socket. Under
+ * `Transfer-Encoding: chunked` that stream still carries the chunk-size
+ * lines, which a JSON parser would reject. This reader strips them as it
+ * goes, one byte at a time with no buffer. It stops at the end of the
+ * body: the zero-size chunk, `Content-Length` bytes, or the connection
+ * closing. Chunk extensions and trailers are ignored.
+ *
+ * read() and readBytes() are the pair ArduinoJson accepts as a custom
+ * reader, so a response is deserialized straight off the socket.
+ *
+ * `Source` is an Arduino Stream:
+ *   size_t readBytes(char* buf, size_t length);  // Waits up to the stream's timeout
+ */
+template <typename Source>
+class HttpBodyReader {
+public:
+  /// @param contentLength Body length, or -1 if unknown; ignored when chunked
+  HttpBodyReader(Source& source, bool chunked, int32_t contentLength)
+    : source(source), chunked(chunked), remaining(contentLength < 0 ? 0 : contentLength),
+      untilClose(!chunked && contentLength < 0), state(chunked ? State::SIZE : State::DATA) {}
+
+  /// @return Next body byte, or -1 at the end of the body or on a framing error
+  int read() {
+    if (!chunked) {
+      return readIdentity();
+    }
+
+    while (state != State::DATA) {
+      if (state == State::DONE) {
+        return -1;
+      }
+      int c = next();
+      if (c < 0 || !frame(static_cast<char>(c))) {
+        return fail();
+      }
+    }
+
+    int c = next();
+    if (c < 0) {
+      return fail();
+    }
+    if (--remaining == 0) {
+      state = State::DATA_CR;
+    }
+    consumed++;
+    return c;
+  }
+
+  size_t readBytes(char* buf, size_t length) {
+    size_t n = 0;
+    while (n < length) {
+      int c = read();
+      if (c < 0) {
+        break;
+      }
+      buf[n++] = static_cast<char>(c);
+    }
+    return n;
+  }
+
+  /// @brief True if the chunk framing was malformed or the body was cut short
+  bool failed() const {
+    return error;
+  }
+
+  /// @brief Body bytes delivered so far
+  size_t getConsumed() const {
+    return consumed;
+  }
+
+private:
+  enum class State : uint8_t {
+    SIZE,       // Hex digits of the chunk size
+    EXTENSION,  // Rest of the size line
+    DATA,
+    DATA_CR,    // CRLF closing a chunk
+    DATA_LF,
+    DONE
+  };
+
+  // Larger chunks are refused rather than risk the counter overflowing
+  static const uint32_t MAX_CHUNK = 0x0FFFFFFF;
+
+  Source& source;
+  bool chunked;
+  uint32_t remaining;
+  bool untilClose;
+  State state;
+  uint8_t digits = 0;
+  bool error = false;
+  size_t consumed = 0;
+
+  int next() {
+    char c;
+    return source.readBytes(&c, 1) == 1 ? static_cast<uint8_t>(c) : -1;
+  }
+
+  int fail() {
+    error = true;
+    state = State::DONE;
+    return -1;
+  }
+
+  int readIdentity() {
+    if (state == State::DONE || (!untilClose && remaining == 0)) {
+      return -1;
+    }
+    int c = next();
+    if (c < 0) {
+      state = State::DONE;
+      error = !untilClose;
+      return -1;
+    }
+    remaining--;
+    consumed++;
+    return c;
+  }
+
+  /// @brief Consume one byte of chunk framing
+  /// @return False if it is not valid framing
+  bool frame(char c) {
+    switch (state) {
+      case State::SIZE: {
+        int value = hexValue(c);
+        if (value >= 0) {
+          if (remaining > MAX_CHUNK >> 4) {
+            return false;
+          }
+          remaining = (remaining << 4) | value;
+          digits++;
+          return true;
+        }
+        if (digits == 0) {
+          return false;
+        }
+        if (c == '\n') {
+          return endSizeLine();
+        }
+        state = State::EXTENSION;
+        return c == '\r' || c == ';' || c == ' ' || c == '\t';
+      }
+
+      case State::EXTENSION:
+        return c != '\n' || endSizeLine();
+
+      case State::DATA_CR:
+        if (c == '\n') {
+          beginChunk();  // Bare LF; tolerated
+          return true;
+        }
+        state = State::DATA_LF;
+        return c == '\r';
+
+      case State::DATA_LF:
+        beginChunk();
+        return c == '\n';
+
+      default:
+        return false;
+    }
+  }
+
+  bool endSizeLine() {
+    state = remaining == 0 ? State::DONE : State::DATA;
+    return true;
+  }
+
+  void beginChunk() {
+    state = State::SIZE;
+    remaining = 0;
+    digits = 0;
+  }
+
+  static int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+      return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+      return c - 'A' + 10;
+    }
+    return -1;
+  }
+};
+
+}
+
+#endif
@@ -7,40 +7,138 @@
 #include "esp_task_wdt.h"
 #include "Device.h"
 #include "Config.h"
+#include "HttpBodyReader.h"
+#include "PayloadCodec.h"
+#include "RegistrationCache.h"
+#include "Log.h"
 
 namespace FindSpot {
 
 struct RegistrationResponse {
   bool success;
   int device_id;
-  String mqtt_username;
-  String mqtt_password;
-  String mqtt_broker;
+  char mqtt_username[REGISTRATION_FIELD_LEN];
+  char mqtt_password[REGISTRATION_FIELD_LEN];
+  char mqtt_broker[REGISTRATION_FIELD_LEN];
   int mqtt_port;
-  String sensor_topic;
+  char sensor_topic[REGISTRATION_FIELD_LEN];
+  PayloadFormat payload_format;
+  char config[REGISTRATION_CONFIG_LEN];  // Optional settings update in RuntimeConfig's key=value form
   String error_message;
+  
+  /// @return False if a field is too long to be cached
+  bool toCache(uint32_t token, CachedRegistration& entry) const {
+    entry = {};
+    entry.token = token;
+    entry.deviceId = device_id;
+    entry.mqttPort = mqtt_port;
+    entry.payloadFormat = static_cast<uint8_t>(payload_format);
+    return CachedRegistration::copyField(entry.mqttUsername, mqtt_username)
+      && CachedRegistration::copyField(entry.mqttPassword, mqtt_password)
+      && CachedRegistration::copyField(entry.mqttBroker, mqtt_broker)
+      && CachedRegistration::copyField(entry.sensorTopic, sensor_topic);
+  }
+  
+  static RegistrationResponse fromCache(const CachedRegistration& entry) {
+    RegistrationResponse response = {};
+    response.success = true;
+    response.device_id = entry.deviceId;
+    memcpy(response.mqtt_username, entry.mqttUsername, REGISTRATION_FIELD_LEN);
+    memcpy(response.mqtt_password, entry.mqttPassword, REGISTRATION_FIELD_LEN);
+    memcpy(response.mqtt_broker, entry.mqttBroker, REGISTRATION_FIELD_LEN);
+    response.mqtt_port = entry.mqttPort;
+    memcpy(response.sensor_topic, entry.sensorTopic, REGISTRATION_FIELD_LEN);
+    response.payload_format = static_cast<PayloadFormat>(entry.payloadFormat);
+    return response;
+  }
 };
 
 class HttpClient {
 private:
   HTTPClient http;
   
+  /// @return False if `value` is not a string or does not fit
+  template <size_t N>
+  static bool copyText(char (&field)[N], JsonVariantConst value, bool optional = false) {
+    const char* text = value.as<const char*>();
+    if (!text) {
+      field[0] = '\0';
+      return optional && value.isNull();
+    }
+    size_t length = strlen(text);
+    if (length >= N) {
+      return false;
+    }
+    memcpy(field, text, length + 1);
+    return true;
+  }
+  
+  /**
+   * Parse the registration reply straight off the socket. The filter lets
+   * only the keys used here into the document, so padding, extra fields or a
+   * long body cost no RAM, and each value is copied into a fixed buffer.
+   */
+  template <typename Reader>
+  static bool parseRegistration(Reader& body, RegistrationResponse& response) {
+    StaticJsonDocument<256> filter;
+    filter["device_id"] = true;
+    filter["mqtt_username"] = true;
+    filter["mqtt_password"] = true;
+    filter["mqtt_broker"] = true;
+    filter["mqtt_port"] = true;
+    filter["sensor_topic"] = true;
+    filter["payload_format"] = true;
+    filter["config"] = true;
+    
+    StaticJsonDocument<REGISTRATION_JSON_CAPACITY> doc;
+    DeserializationError error = deserializeJson(doc, body, DeserializationOption::Filter(filter));
+    if (error || body.failed()) {
+      response.error_message = String("Failed to parse response JSON: ") + (error ? error.c_str() : "bad chunk framing");
+      return false;
+    }
+    
+    if (!copyText(response.mqtt_username, doc["mqtt_username"])
+        || !copyText(response.mqtt_password, doc["mqtt_password"])
+        || !copyText(response.mqtt_broker, doc["mqtt_broker"])
+        || !copyText(response.sensor_topic, doc["sensor_topic"])
+        || !copyText(response.config, doc["config"], true)) {
+      response.error_message = "Response field missing or too long";
+      return false;
+    }
+    // A missing or non-numeric value reads as 0; none of them may be cached or used
+    long deviceId = doc["device_id"] | 0L;
+    long mqttPort = doc["mqtt_port"] | 0L;
+    if (deviceId <= 0 || deviceId > INT32_MAX || mqttPort <= 0 || mqttPort > UINT16_MAX) {
+      response.error_message = "Response device_id or mqtt_port missing or out of range";
+      return false;
+    }
+    response.device_id = deviceId;
+    response.mqtt_port = mqttPort;
+
+    // Only switch to binary if the backend confirms it can decode it
+    if (strcmp(doc["payload_format"] | "", "binary") == 0) {
+      response.payload_format = PayloadFormat::BINARY;
+    }
+    return true;
+  }
+  
 public:
   /**
    * Register device with backend via HTTP
    * Returns device_id and MQTT credentials
    */
   RegistrationResponse registerDevice(Device& device) {
-    RegistrationResponse response;
+    RegistrationResponse response = {};
     response.success = false;
     response.device_id = -1;
+    response.payload_format = PayloadFormat::JSON;
     
     if (WiFi.status() != WL_CONNECTED) {
       response.error_message = "WiFi not connected";
       return response;
     }
     
-    Serial.println("Registering device with backend via HTTP...");
+    LOG_INFO("Registering device with backend via HTTP...");
     
     // Build registration URL
     String url = String("http://") + BACKEND_HOST + ":" + String(BACKEND_PORT) + "/" + String(BACKEND_REGISTER_URL);
@@ -52,19 +150,20 @@ public:
     doc["location"] = device.getLocation();
     doc["latitude"] = device.getLatitude();
     doc["longitude"] = device.getLongitude();
+    doc["payload_format"] = SENSOR_PAYLOAD_FORMAT;
     
     String json;
     serializeJson(doc, json);
     
-    Serial.println("Sending to: " + url);
-    Serial.println("Payload: " + json);
+    LOG_INFO("Sending to: %s", url.c_str());
+    LOG_DEBUG("Payload: %s", json.c_str());
     
     // Send HTTP POST request with timeout
     http.begin(url);
     http.setTimeout(5000); // 5 second timeout to prevent watchdog issues
     http.addHeader("Content-Type", "application/json");
-    
-    Serial.println("Sending POST request...");
+    const char* headerKeys[] = {"Transfer-Encoding"};
+    http.collectHeaders(headerKeys, 1);
     
     // Reset watchdog BEFORE the blocking HTTP call
     esp_task_wdt_reset();
@@ -77,47 +176,37 @@ public:
     if (httpCode <= 0) {
       // HTTP request failed
       response.error_message = "HTTP request failed: " + http.errorToString(httpCode);
-      Serial.println(response.error_message);
+      LOG_ERROR("%s", response.error_message.c_str());
       http.end();
       return response;
     }
     
-    Serial.println("Getting response...");
-    String responseBody = http.getString();
-    http.end();
-    
-    // Reset watchdog again after getting response
-    esp_task_wdt_reset();
+    LOG_INFO("HTTP Response Code: %d", httpCode);
     
-    Serial.println("HTTP Response Code: " + String(httpCode));
-    Serial.println("Response: " + responseBody);
+    // Read the body off the socket as it arrives instead of buffering it whole
+    HttpBodyReader<WiFiClient> body(http.getStream(), http.header("Transfer-Encoding").equalsIgnoreCase("chunked"),
+                                    http.getSize());
     
-    // Parse response
     if (httpCode == 200 || httpCode == 201) {
-      StaticJsonDocument<1024> responseDoc;
-      DeserializationError error = deserializeJson(responseDoc, responseBody);
-      
-      if (!error) {
-        response.success = true;
-        response.device_id = responseDoc["device_id"];
-        response.mqtt_username = responseDoc["mqtt_username"].as<String>();
-        response.mqtt_password = responseDoc["mqtt_password"].as<String>();
-        response.mqtt_broker = responseDoc["mqtt_broker"].as<String>();
-        response.mqtt_port = responseDoc["mqtt_port"];
-        response.sensor_topic = responseDoc["sensor_topic"].as<String>();
-        
-        Serial.println("Registration successful!");
-        Serial.println("Device ID: " + String(response.device_id));
-        Serial.println("MQTT Username: " + response.mqtt_username);
-        Serial.println("Sensor Topic: " + response.sensor_topic);
+      response.success = parseRegistration(body, response);
+      if (response.success) {
+        LOG_INFO("Registration successful! Device ID: %d, MQTT user: %s, topic: %s",
+                 response.device_id, response.mqtt_username, response.sensor_topic);
       } else {
-        response.error_message = "Failed to parse response JSON";
-        Serial.println(response.error_message);
+        LOG_ERROR("%s", response.error_message.c_str());
       }
     } else {
-      response.error_message = "HTTP error " + String(httpCode) + ": " + responseBody;
-      Serial.println("Registration failed: " + response.error_message);
+      // The start of the body is enough to tell what went wrong
+      char excerpt[REGISTRATION_ERROR_EXCERPT];
+      size_t length = body.readBytes(excerpt, sizeof(excerpt) - 1);
+      excerpt[length] = '\0';
+      response.error_message = "HTTP error " + String(httpCode) + ": " + excerpt;
+      LOG_ERROR("Registration failed: %s", response.error_message.c_str());
     }
+    http.end();
+    
+    // Reset watchdog again after reading the response
+    esp_task_wdt_reset();
     
     return response;
   }
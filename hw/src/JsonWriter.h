@@ -0,0 +1,151 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+namespace FindSpot {
+
+/**
+ * Streaming JSON object writer over a caller-provided buffer.
+ *
+ * Writes keys and values straight into the buffer as they are added; there is
+ * no intermediate document and no heap allocation. Output that does not fit
+ * marks the writer as overflowed instead of being truncated silently.
+ *
+ *   JsonWriter json(buffer, sizeof(buffer));
+ *   json.beginObject().field("index", 3).field("is_occupied", true).endObject();
+ *   if (json.ok()) publish(buffer, json.length());
+ */
+class JsonWriter {
+public:
+  JsonWriter(char* buffer, size_t capacity) : buf(buffer), cap(capacity) {
+    if (cap > 0) {
+      buf[0] = '\0';
+    } else {
+      overflow = true;
+    }
+  }
+
+  JsonWriter& beginObject() {
+    put('{');
+    first = true;
+    return *this;
+  }
+
+  JsonWriter& endObject() {
+    put('}');
+    first = false;
+    return *this;
+  }
+
+  JsonWriter& field(const char* key, const char* value) {
+    writeKey(key);
+    writeString(value);
+    return *this;
+  }
+
+  JsonWriter& field(const char* key, long value) {
+    writeKey(key);
+    writeInteger(value);
+    return *this;
+  }
+
+  JsonWriter& field(const char* key, int value) {
+    return field(key, static_cast<long>(value));
+  }
+
+  JsonWriter& field(const char* key, unsigned long value) {
+    writeKey(key);
+    char digits[DIGITS];
+    int n = snprintf(digits, sizeof(digits), "%lu", value);
+    append(digits, n);
+    return *this;
+  }
+
+  JsonWriter& field(const char* key, bool value) {
+    writeKey(key);
+    value ? append("true", 4) : append("false", 5);
+    return *this;
+  }
+
+  bool ok() const {
+    return !overflow;
+  }
+
+  /// @brief Bytes written, excluding the terminator; 0 after an overflow
+  size_t length() const {
+    return overflow ? 0 : len;
+  }
+
+  const char* c_str() const {
+    return buf;
+  }
+
+private:
+  // Sign, the digits of the widest long (32 bits on the ESP32, 64 on a host) and the terminator
+  static const size_t DIGITS = 3 * sizeof(long) + 2;
+
+  char* buf;
+  size_t cap;
+  size_t len = 0;
+  bool first = true;
+  bool overflow = false;
+
+  void put(char c) {
+    if (len + 1 >= cap) {
+      overflow = true;
+      return;
+    }
+    buf[len++] = c;
+    buf[len] = '\0';
+  }
+
+  void append(const char* s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      put(s[i]);
+    }
+  }
+
+  void separate() {
+    if (!first) {
+      put(',');
+    }
+    first = false;
+  }
+
+  void writeKey(const char* key) {
+    separate();
+    writeString(key);
+    put(':');
+  }
+
+  void writeInteger(long value) {
+    char digits[DIGITS];
+    int n = snprintf(digits, sizeof(digits), "%ld", value);
+    append(digits, n);
+  }
+
+  void writeString(const char* s) {
+    static const char hex[] = "0123456789abcdef";
+    put('"');
+    for (; s && *s; s++) {
+      uint8_t c = static_cast<uint8_t>(*s);
+      if (c == '"' || c == '\\') {
+        put('\\');
+        put(c);
+      } else if (c < 0x20) {
+        append("\\u00", 4);
+        put(hex[c >> 4]);
+        put(hex[c & 0x0F]);
+      } else {
+        put(c);
+      }
+    }
+    put('"');
+  }
+};
+}
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "Config.h"
+#endif
+
+// ==================== Log levels ====================================== //
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#ifndef LOG_RING_BUFFER
+#define LOG_RING_BUFFER 0
+#endif
+
+#ifndef LOG_LINE_LEN
+#define LOG_LINE_LEN 128
+#endif
+
+#ifndef LOG_RING_LINES
+#define LOG_RING_LINES 32
+#endif
+
+// Levels above LOG_LEVEL compile to nothing, arguments included
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) ::FindSpot::Log::write('E', __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) ::FindSpot::Log::write('W', __VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) ::FindSpot::Log::write('I', __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) ::FindSpot::Log::write('D', __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+namespace FindSpot {
+namespace Log {
+
+/// @brief Receives finished lines (without newline); Serial on the device
+typedef void (*Sink)(const char* line, size_t length);
+
+/**
+ * Lock-free ring of fixed-size log lines: any number of writers, one reader.
+ *
+ * A writer claims a slot with a single fetch_add and formats straight into
+ * it, then publishes the slot's sequence number. The reader copies a line
+ * out and re-checks the sequence, so a line overwritten while being read is
+ * discarded rather than printed torn. When writers lap the reader the oldest
+ * lines are dropped and counted.
+ */
+template <size_t LINES, size_t LEN>
+class Ring {
+public:
+  /// @brief Format one line into the next slot; never blocks
+  void vprintf(char level, const char* format, va_list args) {
+    uint32_t seq = head.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots[seq % LINES];
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    int n = snprintf(slot.line, LEN, "%c ", level);
+    vsnprintf(slot.line + n, LEN - n, format, args);
+
+    slot.seq.store(seq + 1, std::memory_order_release);
+  }
+
+  /// @brief Hand every completed line to `sink`, oldest first
+  /// @return Number of lines drained
+  size_t drain(Sink sink) {
+    char line[LEN];
+    size_t count = 0;
+
+    for (;;) {
+      uint32_t newest = head.load(std::memory_order_acquire);
+      if (newest - tail > LINES) {
+        dropped += newest - tail - LINES;
+        tail = newest - LINES;
+      }
+      if (tail == newest) {
+        return count;
+      }
+
+      Slot& slot = slots[tail % LINES];
+      if (slot.seq.load(std::memory_order_acquire) != tail + 1) {
+        return count;  // Still being written
+      }
+      memcpy(line, slot.line, LEN);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) == tail + 1) {
+        line[LEN - 1] = '\0';
+        sink(line, strlen(line));
+        count++;
+      } else {
+        dropped++;
+      }
+      tail++;
+    }
+  }
+
+  uint32_t getDropped() const {
+    return dropped;
+  }
+
+private:
+  struct Slot {
+    std::atomic<uint32_t> seq{0};
+    char line[LEN];
+  };
+
+  Slot slots[LINES];
+  std::atomic<uint32_t> head{0};
+  uint32_t tail = 0;
+  uint32_t dropped = 0;
+};
+
+inline Ring<LOG_RING_LINES, LOG_LINE_LEN>& ring() {
+  static Ring<LOG_RING_LINES, LOG_LINE_LEN> instance;
+  return instance;
+}
+
+#ifdef ARDUINO
+inline void serialSink(const char* line, size_t length) {
+  Serial.write(reinterpret_cast<const uint8_t*>(line), length);
+  Serial.write('\n');
+}
+
+inline Sink& sink() {
+  static Sink instance = serialSink;
+  return instance;
+}
+#else
+inline Sink& sink() {
+  static Sink instance = [](const char* line, size_t length) {
+    fwrite(line, 1, length, stdout);
+    fputc('\n', stdout);
+  };
+  return instance;
+}
+#endif
+
+/// @brief Redirect output, e.g. to a counting sink in a host benchmark
+inline void setSink(Sink output) {
+  sink() = output;
+}
+
+/// @brief Format and emit one line; use the LOG_* macros instead of calling this
+inline void write(char level, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+#if LOG_RING_BUFFER
+  ring().vprintf(level, format, args);
+#else
+  // Direct mode: format into one static buffer and write synchronously
+  static char line[LOG_LINE_LEN];
+  static std::mutex lock;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    int n = snprintf(line, sizeof(line), "%c ", level);
+    vsnprintf(line + n, sizeof(line) - n, format, args);
+    sink()(line, strlen(line));
+  }
+#endif
+  va_end(args);
+}
+
+#if defined(ARDUINO) && LOG_RING_BUFFER
+/// @brief Start the low-priority task that drains the ring to Serial
+inline void begin() {
+  xTaskCreate([](void*) {
+    for (;;) {
+      ring().drain(sink());
+      vTaskDelay(pdMS_TO_TICKS(10));
+    }
+  }, "log", 3072, nullptr, tskIDLE_PRIORITY + 1, nullptr);
+}
+#else
+inline void begin() {}
+#endif
+}
+}
+
+#endif
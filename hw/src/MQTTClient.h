@@ -2,16 +2,42 @@
 #define MQTTCLIENT_H
 
 #include <WiFi.h>
-#include <PubSubClient.h>
 #include <ArduinoJson.h>
 #include "Config.h"
+#include "SensorTable.h"
+#include "Log.h"
+#include "MqttSession.h"
+#include "AsyncDialer.h"
+#include "ReconnectSchedule.h"
+#include "ConnectionMetrics.h"
+#include "MqttTopics.h"
+
+// Largest payload that fits a PUBLISH packet with the longest topic
+#define MQTT_MAX_PAYLOAD (MQTT_PACKET_SIZE - 5 - 2 - MQTT_TOPIC_LEN - 2)
+static_assert(SENSOR_PAYLOAD_SIZE <= MQTT_MAX_PAYLOAD, "MQTT_PACKET_SIZE too small for sensor payloads");
+static_assert(MQTT_TELEMETRY_SIZE <= MQTT_MAX_PAYLOAD, "MQTT_PACKET_SIZE too small for telemetry");
 
 namespace FindSpot {
 
 class MQTTClient {
+public:
+  typedef MqttSession<WiFiClient, MQTT_INFLIGHT_WINDOW, MQTT_PACKET_SIZE> Session;
+
 private:
+  // Connection progress; every state is advanced by non-blocking steps from loop()
+  enum class ConnState : uint8_t {
+    IDLE,       // Waiting for the next attempt
+    DIALING,    // DNS lookup and TCP connect
+    HANDSHAKE,  // CONNECT sent, waiting for CONNACK
+    CONNECTED
+  };
+
   WiFiClient wifiClient;
-  PubSubClient mqttClient;
+  Session session;
+  AsyncDialer dialer;
+  ConnState connState = ConnState::IDLE;
+  ReconnectSchedule schedule;  // Backoff between attempts, held while WiFi is down
+  ConnectionMetrics metrics;
   
   String mqttUsername;
   String mqttPassword;
@@ -20,37 +46,186 @@ private:
   String sensorTopic;
   int deviceId;
   
-  unsigned long lastReconnectAttempt;
-  static const unsigned long RECONNECT_INTERVAL = 5000; // 5 seconds
+  // Built once in setCredentials(), so publishing does no formatting or allocation
+  MqttTopics<SENSOR_COUNT> topics;
   
-  bool reconnect() {
+  // Presence on the status topic: retained "online" after every connect, and the
+  // broker publishes the retained "offline" will when the link dies uncleanly
+  static constexpr const char* STATUS_ONLINE = "{\"status\":\"online\"}";
+  static constexpr const char* STATUS_OFFLINE = "{\"status\":\"offline\"}";
+  
+  uint32_t connectedSinceMs = 0;
+  uint32_t metricsStartMs = 0;
+  uint32_t lastTelemetryMs = 0;
+  MqttPacket::Will lastWill = {};
+  bool statusPending = false;  // "online" not yet accepted into the in-flight window
+  bool credentialsRejected = false;  // CONNACK 4 or 5 not yet reported to the caller
+  
+  /// @brief Start an attempt; it progresses in advanceConnection()
+  bool reconnect(uint32_t nowMs) {
     if (mqttUsername.isEmpty() || mqttBroker.isEmpty()) {
-      Serial.println("MQTT credentials not set");
+      LOG_ERROR("MQTT credentials not set");
       return false;
     }
     
-    Serial.print("Attempting MQTT connection to " + mqttBroker + "...");
+    LOG_INFO("Attempting MQTT connection to %s...", mqttBroker.c_str());
+    metrics.onAttempt(nowMs);
     
-    String clientId = String(DEVICE_PREFIX) + String(deviceId);
+    if (!dialer.begin(mqttBroker.c_str(), mqttPort, nowMs)) {
+      metrics.onFailure(ConnectionMetrics::DNS);
+      return connectFailed(dialer.getFailure(), nowMs);
+    }
+    connState = ConnState::DIALING;
+    return true;
+  }
+
+  /// @brief Give up on the current attempt and schedule the next one with jittered backoff
+  bool connectFailed(const char* reason, uint32_t nowMs) {
+    dialer.abort();
+    wifiClient.stop();
+    scheduleReconnect(nowMs);
+    LOG_WARN("MQTT connection failed: %s, retrying in %lu ms...", reason, static_cast<unsigned long>(schedule.getDelayMs()));
+    return false;
+  }
+
+  void scheduleReconnect(uint32_t nowMs) {
+    schedule.onFailure(nowMs);
+    connState = ConnState::IDLE;
+  }
+
+  void publishTelemetry(uint32_t nowMs) {
+    char json[MQTT_TELEMETRY_SIZE];
+    size_t length = metrics.toJson("mqtt", metricsStartMs, nowMs, json, sizeof(json));
+    if (length > 0) {
+      session.publish(topics.telemetry, reinterpret_cast<const uint8_t*>(json), length, 0, false, nowMs);
+    }
+    lastTelemetryMs = nowMs;
+  }
+
+  /// @brief One non-blocking step of the connection state machine
+  void advanceConnection(uint32_t nowMs) {
+    switch (connState) {
+      case ConnState::IDLE:
+        if (schedule.isDue(nowMs)) {
+          reconnect(nowMs);
+        }
+        break;
+        
+      case ConnState::DIALING:
+        switch (dialer.poll(nowMs)) {
+          case AsyncDialer::Status::CONNECTED:
+            wifiClient = WiFiClient(dialer.release());
+            wifiClient.setNoDelay(true);
+            if (!session.beginSession(topics.clientId, mqttUsername.c_str(), mqttPassword.c_str(),
+                                      MQTT_KEEPALIVE_S, &lastWill, nowMs)) {
+              metrics.onFailure(ConnectionMetrics::TCP);
+              connectFailed("CONNECT not sent", nowMs);
+              break;
+            }
+            connState = ConnState::HANDSHAKE;
+            break;
+          case AsyncDialer::Status::FAILED:
+            metrics.onFailure(dialer.isDnsFailure() ? ConnectionMetrics::DNS : ConnectionMetrics::TCP);
+            connectFailed(dialer.getFailure(), nowMs);
+            break;
+          default:
+            break;
+        }
+        break;
+        
+      case ConnState::HANDSHAKE:
+        session.loop(nowMs);
+        if (session.connected()) {
+          LOG_INFO("MQTT connected as %s (user %s, keep-alive %ds, %u in flight)",
+                   topics.clientId, mqttUsername.c_str(), MQTT_KEEPALIVE_S, static_cast<unsigned>(session.getInflight()));
+          metrics.onConnected(nowMs);
+          connectedSinceMs = nowMs;
+          connState = ConnState::CONNECTED;
+          statusPending = true;
+          publishStatus(nowMs);
+          // Clean session: subscriptions are renewed on every connect
+          session.subscribe(topics.commandFilter, 1, nowMs);
+        } else if (session.getState() == Session::State::DISCONNECTED) {
+          if (session.getConnackCode() < 0) {
+            metrics.onFailure(ConnectionMetrics::TIMEOUT);
+            connectFailed("no CONNACK", nowMs);
+          } else {
+            metrics.onRefused(session.getConnackCode());
+            // 4: bad user name or password, 5: not authorized
+            credentialsRejected = credentialsRejected || session.getConnackCode() == 4 || session.getConnackCode() == 5;
+            connectFailed("CONNECT refused", nowMs);
+          }
+        }
+        break;
+        
+      case ConnState::CONNECTED:
+        session.loop(nowMs);
+        if (!session.connected()) {
+          metrics.onDisconnected(nowMs);
+          // Only a connection that held for a while earns an immediate-ish retry
+          schedule.onLost(nowMs, nowMs - connectedSinceMs);
+          connState = ConnState::IDLE;
+          LOG_WARN("MQTT connection lost, %u messages in flight, reconnecting in %lu ms",
+                   static_cast<unsigned>(session.getInflight()), static_cast<unsigned long>(schedule.getDelayMs()));
+        } else if (statusPending) {
+          publishStatus(nowMs);
+        } else if (nowMs - lastTelemetryMs >= MQTT_TELEMETRY_INTERVAL_MS) {
+          publishTelemetry(nowMs);
+        }
+        break;
+    }
+  }
+
+  /**
+   * Replace the retained "offline" will with "online". The window may still be full of
+   * messages resent after CONNACK, so this is retried from loop() until a slot frees up
+   */
+  void publishStatus(uint32_t nowMs) {
+    statusPending = !session.publish(topics.status, reinterpret_cast<const uint8_t*>(STATUS_ONLINE),
+                                     strlen(STATUS_ONLINE), 1, true, nowMs);
+  }
+
+  /// @param retain Broker keeps the message as the topic's current state for new subscribers
+  bool publish(const char* topic, const uint8_t* payload, size_t length, bool retain) {
+    if (!session.connected()) {
+      LOG_WARN("MQTT not connected, cannot publish");
+      return false;
+    }
     
-    if (mqttClient.connect(clientId.c_str(), mqttUsername.c_str(), mqttPassword.c_str())) {
-      Serial.println(" connected!");
-      Serial.println("MQTT Client ID: " + clientId);
-      Serial.println("MQTT Username: " + mqttUsername);
-      Serial.println("MQTT Keep-Alive: 60s");
-      return true;
-    } else {
-      Serial.print(" failed, rc=");
-      Serial.print(mqttClient.state());
-      Serial.println(" retrying in 5 seconds...");
+    // The first free slot goes to the presence status; the caller retries later
+    if (statusPending) {
+      return false;
+    }
+    
+    // Validate payload
+    if (length == 0) {
+      LOG_ERROR("Empty payload, cannot publish");
+      return false;
+    }
+    
+    if (length > MQTT_MAX_PAYLOAD) {
+      LOG_ERROR("Payload too large (%u bytes), cannot publish", static_cast<unsigned>(length));
       return false;
     }
+    
+    // QoS 1: true means queued in the in-flight window, retransmitted until the broker acknowledges it
+    bool result = session.publish(topic, payload, length, MQTT_PUBLISH_QOS, retain, millis());
+    
+    if (!result) {
+      LOG_WARN("Publish to %s deferred, %u messages in flight",
+               topic, static_cast<unsigned>(session.getInflight()));
+    } else {
+      LOG_DEBUG("Published %u bytes to %s", static_cast<unsigned>(length), topic);
+    }
+    
+    return result;
   }
 
 public:
   MQTTClient() 
-    : mqttClient(wifiClient), 
-      lastReconnectAttempt(0),
+    : session(wifiClient, MQTT_RETRY_MS, MQTT_CONNECT_TIMEOUT_MS),
+      dialer(MQTT_CONNECT_TIMEOUT_MS),
+      schedule(Backoff(MQTT_RECONNECT_BASE_MS, MQTT_RECONNECT_CAP_MS, esp_random()), MQTT_RECONNECT_STABLE_MS),
       deviceId(-1),
       mqttPort(1883) { }
 
@@ -66,98 +241,130 @@ public:
     sensorTopic = topic;
     deviceId = devId;
     
-    Serial.println("\nMQTT Configuration:");
-    Serial.println("  Broker: " + mqttBroker + ":" + String(mqttPort));
-    Serial.println("  Username: " + mqttUsername);
-    Serial.println("  Device ID: " + String(deviceId));
-    Serial.println("  Sensor Topic: " + sensorTopic);
+    if (!topics.build(DEVICE_PREFIX, deviceId)) {
+      LOG_ERROR("MQTT client ID or topics of device %d cut short", deviceId);
+    }
+    lastWill = {topics.status, reinterpret_cast<const uint8_t*>(STATUS_OFFLINE), strlen(STATUS_OFFLINE), 1, true};
+    
+    LOG_INFO("MQTT broker %s:%d, user %s, device %d, topic %s",
+             mqttBroker.c_str(), mqttPort, mqttUsername.c_str(), deviceId, sensorTopic.c_str());
   }
 
   /**
-   * Connect to MQTT broker
+   * Start connecting to the MQTT broker; loop() completes the connection
+   * @return False if the attempt could not be started
    */
   bool connect() {
-    mqttClient.setServer(mqttBroker.c_str(), mqttPort);
-    mqttClient.setBufferSize(2048);
-    mqttClient.setKeepAlive(60); // Set keep-alive to 60 seconds (default is 15)
-    
-    Serial.println("\nConnecting to MQTT broker...");
-    return reconnect();
+    metricsStartMs = millis();
+    lastTelemetryMs = metricsStartMs;
+    return reconnect(metricsStartMs);
+  }
+
+  /**
+   * Drop the current connection and connect again right away, e.g. after
+   * setCredentials() with new credentials; messages in flight are kept
+   */
+  void restart() {
+    uint32_t nowMs = millis();
+    if (connState == ConnState::CONNECTED) {
+      metrics.onDisconnected(nowMs);
+    }
+    session.disconnect(nowMs);
+    dialer.abort();
+    connState = ConnState::IDLE;
+    schedule.retryNow(nowMs);
+  }
+
+  /**
+   * The WiFi link dropped: close the connection or abandon the attempt, and
+   * hold further attempts until onNetworkUp() instead of failing them into
+   * a long backoff; messages in flight are kept
+   */
+  void onNetworkDown() {
+    uint32_t nowMs = millis();
+    if (connState == ConnState::CONNECTED) {
+      metrics.onDisconnected(nowMs);
+      LOG_WARN("MQTT paused while WiFi is down, %u messages in flight", static_cast<unsigned>(session.getInflight()));
+    }
+    session.abort();
+    dialer.abort();
+    connState = ConnState::IDLE;
+    schedule.onNetworkDown();
+  }
+
+  /**
+   * The WiFi link is back: connect right away, the outage was not the broker's fault
+   */
+  void onNetworkUp() {
+    schedule.onNetworkUp(millis());
   }
 
   /**
    * Set callback for incoming MQTT messages
    */
-  void setCallback(MQTT_CALLBACK_SIGNATURE) {
-    mqttClient.setCallback(callback);
+  void setCallback(Session::MessageCallback callback) {
+    session.setCallback(callback);
   }
 
   /**
    * Maintain MQTT connection and process messages
    */
   void loop() {
-    if (!mqttClient.connected()) {
-      unsigned long now = millis();
-      if (now - lastReconnectAttempt > RECONNECT_INTERVAL) {
-        lastReconnectAttempt = now;
-        if (reconnect()) {
-          lastReconnectAttempt = 0;
-        }
-      }
-    } else {
-      mqttClient.loop();
-    }
+    advanceConnection(millis());
   }
 
   /**
    * Publish sensor data to MQTT broker
-   * Topic: device/{device_id}/sensors/{sensor_index}
+   * Topic: device/{device_id}/sensors/{sensor_index}, retained as the spot's current state
    */
-  bool publishSensorData(int sensorIndex, const String& sensorJson) {
-    if (!mqttClient.connected()) {
-      Serial.println("X MQTT not connected, cannot publish");
-      Serial.print("   MQTT state: ");
-      Serial.println(mqttClient.state());
-      return false;
-    }
-    
-    // Validate payload
-    if (sensorJson.length() == 0) {
-      Serial.println("X Empty payload, cannot publish");
-      return false;
-    }
-    
-    if (sensorJson.length() > 2048) {
-      Serial.println("X Payload too large, cannot publish");
+  bool publishSensorData(int sensorIndex, const uint8_t* payload, size_t length) {
+    if (sensorIndex < 0 || static_cast<size_t>(sensorIndex) >= SENSOR_COUNT) {
+      LOG_ERROR("Unknown sensor index %d, cannot publish", sensorIndex);
       return false;
     }
-    
-    // Build topic: device/{device_id}/sensors/{sensor_index}
-    String topic = "device/" + String(deviceId) + "/sensors/" + String(sensorIndex);
-    
-    Serial.println("Publishing to MQTT:");
-    Serial.println("   Topic: " + topic);
-    Serial.println("   Payload: " + sensorJson);
-    
-    // Convert to c_str early to avoid multiple allocations
-    const char* topicCStr = topic.c_str();
-    const char* payloadCStr = sensorJson.c_str();
-    
-    bool result = mqttClient.publish(topicCStr, payloadCStr);
-    
-    if (!result) {
-      Serial.print("X Publish failed (rc=");
-      Serial.print(mqttClient.state());
-      Serial.println(")");
-    } else {
-      Serial.println("MQTT publish successful!");
-    }
-    
-    return result;
+    return publish(topics.sensors[sensorIndex], payload, length, MQTT_RETAIN_STATE);
+  }
+
+  /**
+   * Publish the aggregated occupancy of all spots
+   * Topic: device/{device_id}/occupancy, retained
+   */
+  bool publishOccupancy(const uint8_t* payload, size_t length) {
+    return publish(topics.occupancy, payload, length, MQTT_RETAIN_STATE);
+  }
+
+  /**
+   * Publish a one-off report, e.g. boot timings
+   * Topic: device/{device_id}/telemetry, QoS 0
+   */
+  bool publishReport(const char* json, size_t length) {
+    return session.publish(topics.telemetry, reinterpret_cast<const uint8_t*>(json), length, 0, false, millis());
   }
 
   bool isConnected() {
-    return mqttClient.connected();
+    return session.connected();
+  }
+
+  /// @return True once after the broker refused the credentials (CONNACK 4 or 5)
+  bool takeCredentialsRejected() {
+    bool rejected = credentialsRejected;
+    credentialsRejected = false;
+    return rejected;
+  }
+
+  /// @brief Filter of the inbound command topics, "device/{id}/cmd/#"
+  const char* getCommandFilter() const {
+    return topics.commandFilter;
+  }
+
+  /// @brief Attempts, failures by cause, time-to-connect histogram and uptime of the broker link
+  const ConnectionMetrics& getMetrics() const {
+    return metrics;
+  }
+
+  /// @brief Delivery counters of the QoS 1 window
+  const Session::Stats& getPublishStats() const {
+    return session.getStats();
   }
 
   int getDeviceId() const {
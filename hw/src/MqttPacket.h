@@ -0,0 +1,303 @@
+#ifndef MQTT_PACKET_H
+#define MQTT_PACKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace FindSpot {
+
+/**
+ * MQTT 3.1.1 packet encoding and decoding over caller-provided buffers.
+ *
+ * Builders return the encoded length, or 0 if the packet does not fit.
+ * Reader reassembles incoming packets from a byte stream one byte at a time,
+ * so it never blocks on a partially received packet.
+ *
+ * Portable C++, no Arduino dependency.
+ */
+namespace MqttPacket {
+
+enum Type : uint8_t {
+  CONNECT = 1,
+  CONNACK = 2,
+  PUBLISH = 3,
+  PUBACK = 4,
+  SUBSCRIBE = 8,
+  SUBACK = 9,
+  PINGREQ = 12,
+  PINGRESP = 13,
+  DISCONNECT = 14
+};
+
+constexpr uint8_t PROTOCOL_LEVEL = 4;  // 3.1.1
+constexpr uint8_t FLAG_DUP = 0x08;
+constexpr uint8_t FLAG_RETAIN = 0x01;
+
+/// @brief Last Will sent with CONNECT
+struct Will {
+  const char* topic;
+  const uint8_t* payload;
+  size_t length;
+  uint8_t qos;
+  bool retain;
+};
+
+/// @brief Fields of a received PUBLISH; topic and payload point into the reader's buffer
+struct Publish {
+  char* topic;
+  uint8_t* payload;
+  size_t length;
+  uint8_t qos;
+  bool retain;
+  uint16_t packetId;
+};
+
+constexpr size_t remainingLengthSize(size_t remaining) {
+  return remaining < 128 ? 1 : remaining < 16384 ? 2 : remaining < 2097152 ? 3 : 4;
+}
+
+/// @return Header length
+inline size_t writeHeader(uint8_t* out, uint8_t firstByte, size_t remaining) {
+  size_t n = 0;
+  out[n++] = firstByte;
+  do {
+    uint8_t digit = remaining % 128;
+    remaining /= 128;
+    out[n++] = remaining > 0 ? digit | 0x80 : digit;
+  } while (remaining > 0);
+  return n;
+}
+
+inline uint8_t* putU16(uint8_t* out, uint16_t v) {
+  out[0] = v >> 8;
+  out[1] = v & 0xFF;
+  return out + 2;
+}
+
+inline uint8_t* putBytes(uint8_t* out, const void* data, size_t length) {
+  out = putU16(out, length);
+  memcpy(out, data, length);
+  return out + length;
+}
+
+inline uint8_t* putString(uint8_t* out, const char* s) {
+  return putBytes(out, s, strlen(s));
+}
+
+inline size_t connect(uint8_t* out, size_t capacity, const char* clientId, const char* username,
+                      const char* password, uint16_t keepAliveS, const Will* will) {
+  size_t remaining = 10 + 2 + strlen(clientId);
+  uint8_t flags = 0x02;  // Clean session
+  if (will) {
+    remaining += 2 + strlen(will->topic) + 2 + will->length;
+    flags |= 0x04 | (will->qos << 3) | (will->retain ? 0x20 : 0);
+  }
+  if (username && *username) {
+    remaining += 2 + strlen(username);
+    flags |= 0x80;
+    if (password && *password) {
+      remaining += 2 + strlen(password);
+      flags |= 0x40;
+    }
+  }
+  if (1 + remainingLengthSize(remaining) + remaining > capacity) {
+    return 0;
+  }
+
+  uint8_t* pos = out + writeHeader(out, CONNECT << 4, remaining);
+  pos = putString(pos, "MQTT");
+  *pos++ = PROTOCOL_LEVEL;
+  *pos++ = flags;
+  pos = putU16(pos, keepAliveS);
+  pos = putString(pos, clientId);
+  if (will) {
+    pos = putString(pos, will->topic);
+    pos = putBytes(pos, will->payload, will->length);
+  }
+  if (flags & 0x80) {
+    pos = putString(pos, username);
+  }
+  if (flags & 0x40) {
+    pos = putString(pos, password);
+  }
+  return pos - out;
+}
+
+/// @param packetId Ignored for QoS 0
+inline size_t publish(uint8_t* out, size_t capacity, const char* topic, const uint8_t* payload, size_t length,
+                      uint8_t qos, bool retain, uint16_t packetId) {
+  size_t remaining = 2 + strlen(topic) + (qos > 0 ? 2 : 0) + length;
+  if (1 + remainingLengthSize(remaining) + remaining > capacity) {
+    return 0;
+  }
+
+  uint8_t* pos = out + writeHeader(out, (PUBLISH << 4) | (qos << 1) | (retain ? FLAG_RETAIN : 0), remaining);
+  pos = putString(pos, topic);
+  if (qos > 0) {
+    pos = putU16(pos, packetId);
+  }
+  memcpy(pos, payload, length);
+  return pos + length - out;
+}
+
+inline size_t puback(uint8_t* out, uint16_t packetId) {
+  out[0] = PUBACK << 4;
+  out[1] = 2;
+  putU16(out + 2, packetId);
+  return 4;
+}
+
+inline size_t subscribe(uint8_t* out, size_t capacity, uint16_t packetId, const char* topic, uint8_t qos) {
+  size_t remaining = 2 + 2 + strlen(topic) + 1;
+  if (1 + remainingLengthSize(remaining) + remaining > capacity) {
+    return 0;
+  }
+
+  uint8_t* pos = out + writeHeader(out, (SUBSCRIBE << 4) | 0x02, remaining);
+  pos = putU16(pos, packetId);
+  pos = putString(pos, topic);
+  *pos++ = qos;
+  return pos - out;
+}
+
+inline size_t pingreq(uint8_t* out) {
+  out[0] = PINGREQ << 4;
+  out[1] = 0;
+  return 2;
+}
+
+inline size_t disconnect(uint8_t* out) {
+  out[0] = DISCONNECT << 4;
+  out[1] = 0;
+  return 2;
+}
+
+/// @brief Mark an already encoded PUBLISH as a retransmission
+inline void setDup(uint8_t* packet) {
+  packet[0] |= FLAG_DUP;
+}
+
+inline uint16_t getU16(const uint8_t* in) {
+  return (in[0] << 8) | in[1];
+}
+
+/**
+ * Parse a PUBLISH body in place. The topic is moved two bytes back over its
+ * length prefix so it can be NUL-terminated without copying.
+ * @return False if the body is malformed
+ */
+inline bool parsePublish(uint8_t flags, uint8_t* body, size_t length, Publish& out) {
+  if (length < 2) {
+    return false;
+  }
+  size_t topicLength = getU16(body);
+  out.qos = (flags >> 1) & 0x03;
+  out.retain = flags & FLAG_RETAIN;
+  size_t idSize = out.qos > 0 ? 2 : 0;
+  if (2 + topicLength + idSize > length) {
+    return false;
+  }
+
+  out.packetId = idSize ? getU16(body + 2 + topicLength) : 0;
+  memmove(body, body + 2, topicLength);
+  body[topicLength] = '\0';
+  out.topic = reinterpret_cast<char*>(body);
+  out.payload = body + 2 + topicLength + idSize;
+  out.length = length - 2 - topicLength - idSize;
+  return true;
+}
+
+/**
+ * Incremental packet reassembly into a fixed buffer of SIZE bytes.
+ *
+ * Packets whose body does not fit are consumed and dropped; getDropped()
+ * counts them.
+ */
+template <size_t SIZE>
+class Reader {
+public:
+  /// @return True once a complete packet is available through type(), flags() and body()
+  bool feed(uint8_t byte) {
+    switch (state) {
+      case HEADER:
+        header = byte;
+        remaining = 0;
+        shift = 0;
+        state = LENGTH;
+        return false;
+
+      case LENGTH:
+        remaining |= static_cast<size_t>(byte & 0x7F) << shift;
+        shift += 7;
+        if (byte & 0x80) {
+          if (shift > 21) {
+            state = HEADER;  // Malformed length, resynchronize on the next byte
+          }
+          return false;
+        }
+        received = 0;
+        if (remaining > SIZE) {
+          dropped++;
+          state = remaining ? SKIP : HEADER;
+          return false;
+        }
+        state = remaining ? BODY : HEADER;
+        return remaining == 0;
+
+      case BODY:
+        buffer[received++] = byte;
+        if (received < remaining) {
+          return false;
+        }
+        state = HEADER;
+        return true;
+
+      case SKIP:
+        if (++received >= remaining) {
+          state = HEADER;
+        }
+        return false;
+    }
+    return false;
+  }
+
+  void reset() {
+    state = HEADER;
+  }
+
+  uint8_t type() const {
+    return header >> 4;
+  }
+
+  uint8_t flags() const {
+    return header & 0x0F;
+  }
+
+  uint8_t* body() {
+    return buffer;
+  }
+
+  size_t length() const {
+    return remaining;
+  }
+
+  uint32_t getDropped() const {
+    return dropped;
+  }
+
+private:
+  enum State : uint8_t { HEADER, LENGTH, BODY, SKIP };
+
+  State state = HEADER;
+  uint8_t header = 0;
+  uint8_t shift = 0;
+  size_t remaining = 0;
+  size_t received = 0;
+  uint32_t dropped = 0;
+  uint8_t buffer[SIZE];
+};
+}
+}
+
+#endif
@@ -0,0 +1,334 @@
+#ifndef MQTT_SESSION_H
+#define MQTT_SESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "MqttPacket.h"
+
+namespace FindSpot {
+
+/**
+ * MQTT 3.1.1 client session with QoS 1 publishing, over any byte transport.
+ *
+ * `Transport` needs the read side of Arduino's Client interface:
+ *   int available();  int read(uint8_t* buf, size_t size);
+ *   size_t write(const uint8_t* buf, size_t size);
+ *   uint8_t connected();  void stop();
+ * so WiFiClient works on the device and an in-memory stand-in on a host.
+ *
+ * A QoS 1 publish is copied into one of WINDOW in-flight slots and written
+ * once; loop() then matches PUBACKs and retransmits (with DUP) every slot
+ * older than `retryMs`. Nothing ever waits for an acknowledgement: publish()
+ * fails fast when the window is full. Slots survive a dropped connection
+ * and are resent right after the next CONNACK, so a transition accepted by
+ * publish() is delivered at least once unless the device restarts.
+ *
+ * All timing comes from the `nowMs` arguments.
+ */
+template <typename Transport, size_t WINDOW, size_t PACKET_SIZE>
+class MqttSession {
+  static_assert(WINDOW > 0, "In-flight window needs at least one slot");
+
+public:
+  typedef void (*MessageCallback)(char* topic, uint8_t* payload, unsigned int length);
+
+  enum class State : uint8_t {
+    DISCONNECTED,
+    AWAIT_CONNACK,
+    CONNECTED
+  };
+
+  /// @brief Counters since construction
+  struct Stats {
+    uint32_t published;    // QoS 1 messages accepted into the window
+    uint32_t acknowledged; // PUBACKs matched to a slot
+    uint32_t retransmits;
+  };
+
+  MqttSession(Transport& transport, uint32_t retryMs, uint32_t connackTimeoutMs)
+    : transport(transport), retryMs(retryMs), connackTimeoutMs(connackTimeoutMs) {}
+
+  void setCallback(MessageCallback cb) {
+    callback = cb;
+  }
+
+  /// @brief Send CONNECT on an already open transport; CONNACK is handled by loop()
+  bool beginSession(const char* clientId, const char* username, const char* password,
+                    uint16_t keepAliveS, const MqttPacket::Will* will, uint32_t nowMs) {
+    reader.reset();
+    keepAliveMs = keepAliveS * 1000UL;
+    size_t n = MqttPacket::connect(scratch, sizeof(scratch), clientId, username, password, keepAliveS, will);
+    if (n == 0 || !send(scratch, n, nowMs)) {
+      return false;
+    }
+    state = State::AWAIT_CONNACK;
+    stateSinceMs = nowMs;
+    lastReceivedMs = nowMs;
+    return true;
+  }
+
+  /// @brief Read incoming packets, retransmit unacknowledged publishes and keep the session alive
+  void loop(uint32_t nowMs) {
+    if (state == State::DISCONNECTED) {
+      return;
+    }
+    if (!transport.connected()) {
+      drop();
+      return;
+    }
+
+    uint8_t chunk[64];
+    int avail;
+    while ((avail = transport.available()) > 0) {
+      int n = transport.read(chunk, avail < static_cast<int>(sizeof(chunk)) ? avail : sizeof(chunk));
+      if (n <= 0) {
+        break;
+      }
+      lastReceivedMs = nowMs;
+      for (int i = 0; i < n && state != State::DISCONNECTED; i++) {
+        if (reader.feed(chunk[i])) {
+          handlePacket(nowMs);
+        }
+      }
+    }
+
+    if (state == State::AWAIT_CONNACK) {
+      if (nowMs - stateSinceMs > connackTimeoutMs) {
+        drop();
+      }
+      return;
+    }
+    if (state != State::CONNECTED) {
+      return;
+    }
+
+    retransmitDue(nowMs);
+
+    if (keepAliveMs > 0) {
+      if (nowMs - lastReceivedMs > keepAliveMs + keepAliveMs / 2) {
+        drop();  // Broker silent for 1.5 keep-alive periods
+        return;
+      }
+      if (nowMs - lastSentMs >= keepAliveMs) {
+        size_t n = MqttPacket::pingreq(scratch);
+        send(scratch, n, nowMs);
+      }
+    }
+  }
+
+  /// @return False if not connected, the window is full, or the packet does not fit
+  bool publish(const char* topic, const uint8_t* payload, size_t length, uint8_t qos, bool retain, uint32_t nowMs) {
+    if (state != State::CONNECTED) {
+      return false;
+    }
+    if (qos == 0) {
+      size_t n = MqttPacket::publish(scratch, sizeof(scratch), topic, payload, length, 0, retain, 0);
+      return n > 0 && send(scratch, n, nowMs);
+    }
+
+    Slot* slot = freeSlot();
+    if (!slot) {
+      return false;
+    }
+    uint16_t id = nextPacketId();
+    size_t n = MqttPacket::publish(slot->packet, PACKET_SIZE, topic, payload, length, 1, retain, id);
+    if (n == 0) {
+      return false;
+    }
+    slot->packetId = id;
+    slot->length = n;
+    slot->sentAtMs = nowMs;
+    slot->order = nextOrder++;
+    stats.published++;
+
+    // A failed write is picked up by the retransmit timer or the next CONNACK
+    send(slot->packet, n, nowMs);
+    return true;
+  }
+
+  /// @brief Subscribe with QoS 0 or 1; the SUBACK is not tracked
+  bool subscribe(const char* topic, uint8_t qos, uint32_t nowMs) {
+    if (state != State::CONNECTED) {
+      return false;
+    }
+    size_t n = MqttPacket::subscribe(scratch, sizeof(scratch), nextPacketId(), topic, qos);
+    return n > 0 && send(scratch, n, nowMs);
+  }
+
+  void disconnect(uint32_t nowMs) {
+    if (state == State::CONNECTED) {
+      size_t n = MqttPacket::disconnect(scratch);
+      send(scratch, n, nowMs);
+    }
+    drop();
+  }
+
+  /// @brief Close the transport without a DISCONNECT, for a link that is already gone; the broker sends the will
+  void abort() {
+    drop();
+  }
+
+  bool connected() const {
+    return state == State::CONNECTED;
+  }
+
+  State getState() const {
+    return state;
+  }
+
+  /// @brief Return code of the last CONNACK, or -1 if the last attempt timed out or the link dropped
+  int getConnackCode() const {
+    return connackCode;
+  }
+
+  size_t getInflight() const {
+    size_t count = 0;
+    for (const Slot& slot : slots) {
+      count += slot.length > 0;
+    }
+    return count;
+  }
+
+  const Stats& getStats() const {
+    return stats;
+  }
+
+private:
+  struct Slot {
+    uint16_t packetId = 0;
+    size_t length = 0;  // 0 = free
+    uint32_t sentAtMs = 0;
+    uint32_t order = 0;
+    uint8_t packet[PACKET_SIZE];
+  };
+
+  Transport& transport;
+  uint32_t retryMs;
+  uint32_t connackTimeoutMs;
+  MessageCallback callback = nullptr;
+  MqttPacket::Reader<PACKET_SIZE> reader;
+  State state = State::DISCONNECTED;
+  int connackCode = -1;
+  uint32_t stateSinceMs = 0;
+  uint32_t lastSentMs = 0;
+  uint32_t lastReceivedMs = 0;
+  uint32_t keepAliveMs = 0;
+  uint16_t packetId = 0;
+  uint32_t nextOrder = 0;
+  Slot slots[WINDOW];
+  uint8_t scratch[PACKET_SIZE];
+  Stats stats = {};
+
+  bool send(const uint8_t* data, size_t length, uint32_t nowMs) {
+    if (transport.write(data, length) != length) {
+      return false;
+    }
+    lastSentMs = nowMs;
+    return true;
+  }
+
+  void drop() {
+    transport.stop();
+    if (state == State::AWAIT_CONNACK) {
+      connackCode = -1;
+    }
+    state = State::DISCONNECTED;
+  }
+
+  uint16_t nextPacketId() {
+    if (++packetId == 0) {
+      packetId = 1;
+    }
+    return packetId;
+  }
+
+  Slot* freeSlot() {
+    for (Slot& slot : slots) {
+      if (slot.length == 0) {
+        return &slot;
+      }
+    }
+    return nullptr;
+  }
+
+  void handlePacket(uint32_t nowMs) {
+    uint8_t* body = reader.body();
+    size_t length = reader.length();
+
+    switch (reader.type()) {
+      case MqttPacket::CONNACK:
+        if (state != State::AWAIT_CONNACK || length < 2) {
+          return;
+        }
+        if (body[1] != 0) {
+          drop();
+          connackCode = body[1];  // Set after drop(), which clears it for attempts that got no answer
+          return;
+        }
+        connackCode = 0;
+        state = State::CONNECTED;
+        stateSinceMs = nowMs;
+        // Whatever was in flight when the link dropped goes out again first
+        for (Slot& slot : slots) {
+          slot.sentAtMs = nowMs - retryMs;
+        }
+        retransmitDue(nowMs);
+        return;
+
+      case MqttPacket::PUBACK:
+        if (length >= 2) {
+          uint16_t id = MqttPacket::getU16(body);
+          for (Slot& slot : slots) {
+            if (slot.length > 0 && slot.packetId == id) {
+              slot.length = 0;
+              stats.acknowledged++;
+            }
+          }
+        }
+        return;
+
+      case MqttPacket::PUBLISH: {
+        MqttPacket::Publish message;
+        if (!MqttPacket::parsePublish(reader.flags(), body, length, message)) {
+          return;
+        }
+        if (message.qos == 1) {
+          uint8_t ack[4];
+          send(ack, MqttPacket::puback(ack, message.packetId), nowMs);
+        }
+        if (callback) {
+          callback(message.topic, message.payload, message.length);
+        }
+        return;
+      }
+
+      default:
+        return;  // PINGRESP and SUBACK only refresh lastReceivedMs
+    }
+  }
+
+  /// @brief Resend expired slots, oldest first
+  void retransmitDue(uint32_t nowMs) {
+    for (;;) {
+      Slot* oldest = nullptr;
+      for (Slot& slot : slots) {
+        if (slot.length > 0 && nowMs - slot.sentAtMs >= retryMs
+            && (!oldest || static_cast<int32_t>(slot.order - oldest->order) < 0)) {
+          oldest = &slot;
+        }
+      }
+      if (!oldest) {
+        return;
+      }
+      MqttPacket::setDup(oldest->packet);
+      oldest->sentAtMs = nowMs;
+      stats.retransmits++;
+      if (!send(oldest->packet, oldest->length, nowMs)) {
+        return;
+      }
+    }
+  }
+};
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef MQTT_TOPICS_H
+#define MQTT_TOPICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Fits "device/{id}/sensors/{index}", "device/{id}/occupancy" and "device/{id}/telemetry"
+#define MQTT_TOPIC_LEN     40
+#define MQTT_CLIENT_ID_LEN 32
+
+namespace FindSpot {
+
+/**
+ * Client ID and topics of one device for `SENSORS` spots.
+ *
+ * Formatted once by build() when the device ID is known, so the publish
+ * path only indexes null-terminated buffers: no formatting, no allocation.
+ *
+ * Portable C++, no Arduino dependency.
+ */
+template <size_t SENSORS>
+struct MqttTopics {
+  char clientId[MQTT_CLIENT_ID_LEN] = "";
+  char sensors[SENSORS][MQTT_TOPIC_LEN] = {};  // device/{id}/sensors/{index}
+  char occupancy[MQTT_TOPIC_LEN] = "";         // device/{id}/occupancy
+  char telemetry[MQTT_TOPIC_LEN] = "";         // device/{id}/telemetry
+  char status[MQTT_TOPIC_LEN] = "";            // device/{id}/status
+  char commandFilter[MQTT_TOPIC_LEN] = "";     // device/{id}/cmd/#
+
+  /// @brief Client ID "<prefix><id>" and every topic of device `deviceId`
+  /// @return False if one of them was cut short
+  bool build(const char* clientPrefix, int deviceId) {
+    bool fits = fitted(snprintf(clientId, sizeof(clientId), "%s%d", clientPrefix, deviceId), sizeof(clientId));
+    for (size_t i = 0; i < SENSORS; i++) {
+      fits &= fitted(snprintf(sensors[i], MQTT_TOPIC_LEN, "device/%d/sensors/%u", deviceId, static_cast<unsigned>(i)),
+                     MQTT_TOPIC_LEN);
+    }
+    fits &= fitted(snprintf(occupancy, sizeof(occupancy), "device/%d/occupancy", deviceId), sizeof(occupancy));
+    fits &= fitted(snprintf(telemetry, sizeof(telemetry), "device/%d/telemetry", deviceId), sizeof(telemetry));
+    fits &= fitted(snprintf(status, sizeof(status), "device/%d/status", deviceId), sizeof(status));
+    fits &= fitted(snprintf(commandFilter, sizeof(commandFilter), "device/%d/cmd/#", deviceId), sizeof(commandFilter));
+    return fits;
+  }
+
+private:
+  static bool fitted(int written, size_t capacity) {
+    return written >= 0 && static_cast<size_t>(written) < capacity;
+  }
+};
+}
+
+#endif
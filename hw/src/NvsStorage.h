@@ -0,0 +1,49 @@
+#ifndef NVS_STORAGE_H
+#define NVS_STORAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ARDUINO
+#include <Preferences.h>
+#endif
+
+namespace FindSpot {
+
+#ifdef ARDUINO
+/**
+ * One blob under a key of an NVS namespace, for RuntimeConfig,
+ * RegistrationCache and WifiConnector. NVS checksums each entry and
+ * replaces it atomically, so a power loss keeps either the old blob or
+ * the new one.
+ */
+class NvsStorage {
+public:
+  NvsStorage(const char* ns, const char* key) : ns(ns), key(key) {}
+
+  bool begin() {
+    return prefs.begin(ns, false);
+  }
+
+  /// @return Stored length, 0 if nothing is stored or it does not fit
+  size_t load(uint8_t* out, size_t capacity) {
+    size_t length = prefs.getBytesLength(key);
+    if (length == 0 || length > capacity) {
+      return 0;
+    }
+    return prefs.getBytes(key, out, length);
+  }
+
+  bool save(const uint8_t* data, size_t length) {
+    return prefs.putBytes(key, data, length) == length;
+  }
+
+private:
+  const char* ns;
+  const char* key;
+  Preferences prefs;
+};
+#endif
+}
+
+#endif
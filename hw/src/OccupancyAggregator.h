@@ -0,0 +1,86 @@
+#ifndef OCCUPANCY_AGGREGATOR_H
+#define OCCUPANCY_AGGREGATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "PayloadCodec.h"
+
+namespace FindSpot {
+
+/**
+ * Coalesces state changes of all spots into one device-level message.
+ *
+ * The first change opens a window of `windowMs`; every change recorded until
+ * it closes lands in the same aggregate: the full occupancy bitmap plus the
+ * distance of each spot that changed. A lot-wide burst thus costs one publish
+ * instead of one per spot.
+ */
+template <uint8_t SPOTS>
+class OccupancyAggregator {
+  static_assert(SPOTS > 0 && SPOTS <= PayloadCodec::MAX_AGGREGATE_SPOTS, "Aggregate supports 1..64 spots");
+
+public:
+  static constexpr size_t MAX_SIZE = PayloadCodec::aggregateSize(SPOTS, SPOTS);
+
+  explicit OccupancyAggregator(uint32_t windowMs) : windowMs(windowMs) {}
+
+  void record(const SensorUpdate& update, uint32_t nowMs) {
+    if (update.index >= SPOTS) {
+      return;
+    }
+    if (!changed) {
+      windowStartMs = nowMs;
+    }
+
+    uint64_t bit = 1ULL << update.index;
+    bitmap = update.occupied ? bitmap | bit : bitmap & ~bit;
+    changed |= bit;
+    distances[update.index] = update.distanceCm;
+    if (update.timestamp > timestamp) {
+      timestamp = update.timestamp;
+    }
+  }
+
+  /// @brief True once the coalescing window of a pending change has closed
+  bool isDue(uint32_t nowMs) const {
+    return changed && nowMs - windowStartMs >= windowMs;
+  }
+
+  /// @brief Encode the pending aggregate; call markPublished() once it is sent
+  /// @return Encoded length, 0 if nothing is pending or `capacity` is too small
+  size_t encode(uint8_t* out, size_t capacity) const {
+    if (!changed) {
+      return 0;
+    }
+
+    SpotDelta deltas[SPOTS];
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < SPOTS; i++) {
+      if (changed & (1ULL << i)) {
+        deltas[count].index = i;
+        deltas[count].distanceCm = distances[i];
+        count++;
+      }
+    }
+    return PayloadCodec::encodeAggregate(bitmap, SPOTS, deltas, count, timestamp, out, capacity);
+  }
+
+  void markPublished() {
+    changed = 0;
+  }
+
+  uint64_t getBitmap() const {
+    return bitmap;
+  }
+
+private:
+  uint32_t windowMs;
+  uint32_t windowStartMs = 0;
+  uint64_t bitmap = 0;
+  uint64_t changed = 0;
+  uint16_t distances[SPOTS] = {};
+  uint32_t timestamp = 0;
+};
+}
+
+#endif
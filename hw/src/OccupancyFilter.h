@@ -0,0 +1,147 @@
+#ifndef OCCUPANCY_FILTER_H
+#define OCCUPANCY_FILTER_H
+
+#include <stdint.h>
+
+namespace FindSpot {
+
+/**
+ * Debounced occupancy decision for one parking spot.
+ *
+ * Raw distances go through a running median over the last `N` samples, then
+ * through a hysteresis band: a spot becomes occupied once the median drops to
+ * `enterCm` and is freed only when it rises above `exitCm`. A new state must
+ * also hold for `dwellMs` before it is committed, so single noisy samples
+ * never produce a state change (and thus a publish).
+ */
+template <uint8_t N>
+class OccupancyFilter {
+  static_assert(N > 0 && N % 2 == 1, "Median window must have an odd length");
+
+public:
+  // Stored for samples without a usable echo; sorts above every real distance
+  static const uint16_t NO_ECHO = 0xFFFF;
+
+  OccupancyFilter(uint16_t minCm, uint16_t enterCm, uint16_t exitCm, uint32_t dwellMs)
+    : minCm(minCm), enterCm(enterCm), exitCm(exitCm), dwellMs(dwellMs) {
+    for (uint8_t i = 0; i < N; i++) {
+      window[i] = NO_ECHO;
+      sorted[i] = NO_ECHO;
+    }
+  }
+
+  /// @brief Add a raw sample and re-evaluate the committed state
+  /// @param distanceCm Raw distance, negative when the echo was lost
+  /// @return The committed (debounced) occupancy
+  bool update(long distanceCm, uint32_t nowMs) {
+    uint16_t sample = (distanceCm < minCm || distanceCm >= NO_ECHO)
+      ? NO_ECHO
+      : static_cast<uint16_t>(distanceCm);
+
+    // The first sample seeds the whole window, so the initial state needs no dwell
+    if (!primed) {
+      primed = true;
+      for (uint8_t i = 0; i < N; i++) {
+        window[i] = sample;
+        sorted[i] = sample;
+      }
+      committed = sample <= enterCm;
+      return committed;
+    }
+
+    replaceSample(window[head], sample);
+    window[head] = sample;
+    head = (head + 1) % N;
+
+    uint16_t median = getMedian();
+    bool next = committed
+      ? median <= exitCm
+      : median <= enterCm;
+
+    // The raw sample may disagree long before the median moves
+    sampleAgrees = (committed ? sample <= exitCm : sample <= enterCm) == committed;
+
+    if (next == committed) {
+      settling = false;
+    } else if (!settling) {
+      settling = true;
+      candidateSinceMs = nowMs;
+    } else if (nowMs - candidateSinceMs >= dwellMs) {
+      committed = next;
+      settling = false;
+    }
+
+    return committed;
+  }
+
+  /// @brief Change the distance thresholds; the committed state is re-evaluated by the next sample
+  void setThresholds(uint16_t minCm, uint16_t enterCm, uint16_t exitCm) {
+    this->minCm = minCm;
+    this->enterCm = enterCm;
+    this->exitCm = exitCm;
+    settling = false;
+  }
+
+  /// @brief Median of the current window, NO_ECHO if most samples had no echo
+  uint16_t getMedian() const {
+    return sorted[N / 2];
+  }
+
+  bool isOccupied() const {
+    return committed;
+  }
+
+  /// @brief True while a state change is pending its dwell time
+  bool isSettling() const {
+    return settling;
+  }
+
+  /// @brief True if the spot shows any sign of changing: a pending state or a disagreeing sample
+  bool isTransitioning() const {
+    return settling || !sampleAgrees;
+  }
+
+private:
+  uint16_t minCm;
+  uint16_t enterCm;
+  uint16_t exitCm;
+  uint32_t dwellMs;
+
+  uint16_t window[N];  // Samples in arrival order (ring)
+  uint16_t sorted[N];  // Same samples, kept sorted
+  uint8_t head = 0;
+
+  bool primed = false;
+  bool committed = false;
+  bool settling = false;
+  bool sampleAgrees = true;
+  uint32_t candidateSinceMs = 0;
+
+  /// Swap the outgoing sample for the incoming one in the sorted copy.
+  /// O(N) per sample: one scan to find the outgoing value, then one insertion pass.
+  void replaceSample(uint16_t outgoing, uint16_t incoming) {
+    uint8_t pos = 0;
+    while (sorted[pos] != outgoing) {
+      pos++;
+    }
+    sorted[pos] = incoming;
+
+    while (pos > 0 && sorted[pos - 1] > sorted[pos]) {
+      swap(pos - 1, pos);
+      pos--;
+    }
+    while (pos + 1 < N && sorted[pos + 1] < sorted[pos]) {
+      swap(pos, pos + 1);
+      pos++;
+    }
+  }
+
+  void swap(uint8_t a, uint8_t b) {
+    uint16_t tmp = sorted[a];
+    sorted[a] = sorted[b];
+    sorted[b] = tmp;
+  }
+};
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "PayloadCodec.h"
+
+namespace FindSpot {
+
+/**
+ * Store-and-forward queue of occupancy transitions.
+ *
+ * Transitions are queued in a RAM ring of CAPACITY entries. Once it is full,
+ * or while older entries are still on flash, new ones are appended to an
+ * append-only log in `Storage` (see FileLog for the interface), so delivery
+ * order always matches recording order. Draining moves log records back into
+ * the ring in batches and clears the log once every record in it has been
+ * popped.
+ *
+ * Log record (11 bytes): MAGIC | 9-byte PayloadCodec SensorUpdate | CRC-8.
+ * A record torn by a power loss fails its check and the reader resynchronizes
+ * on the next valid record. After a reboot the whole log is replayed, so a
+ * transition may be delivered twice but is never lost once it reached flash;
+ * entries still in RAM are lost with power.
+ *
+ * Portable C++, no Arduino dependency.
+ */
+template <size_t CAPACITY, typename Storage>
+class Outbox {
+  static_assert(CAPACITY > 0, "Outbox needs at least one RAM slot");
+
+public:
+  static constexpr uint8_t MAGIC = 0xA5;
+  static constexpr size_t RECORD_SIZE = PayloadCodec::SENSOR_UPDATE_SIZE + 2;
+
+  /// @param maxLogBytes Flash budget; transitions beyond it are dropped and counted
+  Outbox(Storage& storage, size_t maxLogBytes) : storage(storage), maxLogBytes(maxLogBytes) {}
+
+  /// @brief Queue a transition
+  /// @return False if both the ring and the flash budget are exhausted
+  bool push(const SensorUpdate& update) {
+    if (storage.size() == 0 && count < CAPACITY) {
+      ring[(head + count) % CAPACITY] = update;
+      count++;
+      return true;
+    }
+
+    uint8_t record[RECORD_SIZE];
+    record[0] = MAGIC;
+    PayloadCodec::encode(update, record + 1, PayloadCodec::SENSOR_UPDATE_SIZE);
+    record[RECORD_SIZE - 1] = crc8(record + 1, PayloadCodec::SENSOR_UPDATE_SIZE);
+
+    if (storage.size() + RECORD_SIZE > maxLogBytes || !storage.append(record, RECORD_SIZE)) {
+      dropped++;
+      return false;
+    }
+    return true;
+  }
+
+  /// @brief Oldest queued transition, without removing it
+  /// @return False if nothing is queued
+  bool peek(SensorUpdate& update) {
+    if (count == 0) {
+      refill();
+    }
+    if (count == 0) {
+      return false;
+    }
+    update = ring[head];
+    return true;
+  }
+
+  /// @brief Remove the transition returned by the last successful peek()
+  void pop() {
+    if (count == 0) {
+      return;
+    }
+    head = (head + 1) % CAPACITY;
+    count--;
+
+    // Everything that was on flash has now been handed out
+    if (count == 0 && readOffset > 0 && readOffset >= storage.size()) {
+      storage.clear();
+      readOffset = 0;
+    }
+  }
+
+  bool isEmpty() {
+    return count == 0 && readOffset >= storage.size();
+  }
+
+  /// @brief Transitions currently held in RAM
+  size_t getRamCount() const {
+    return count;
+  }
+
+  /// @brief Bytes of log not yet moved back into RAM
+  size_t getLogBacklog() {
+    size_t size = storage.size();
+    return size > readOffset ? size - readOffset : 0;
+  }
+
+  uint32_t getDropped() const {
+    return dropped;
+  }
+
+  static uint8_t crc8(const uint8_t* data, size_t length) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+      crc ^= data[i];
+      for (uint8_t bit = 0; bit < 8; bit++) {
+        crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+      }
+    }
+    return crc;
+  }
+
+private:
+  Storage& storage;
+  size_t maxLogBytes;
+  SensorUpdate ring[CAPACITY];
+  size_t head = 0;
+  size_t count = 0;
+  size_t readOffset = 0;
+  uint32_t dropped = 0;
+
+  /// @brief Move the next batch of valid log records into the empty ring
+  void refill() {
+    uint8_t record[RECORD_SIZE];
+    size_t end = storage.size();
+    head = 0;
+
+    while (count < CAPACITY && readOffset + RECORD_SIZE <= end) {
+      if (storage.read(readOffset, record, RECORD_SIZE) != RECORD_SIZE) {
+        break;
+      }
+      if (record[0] == MAGIC
+          && crc8(record + 1, PayloadCodec::SENSOR_UPDATE_SIZE) == record[RECORD_SIZE - 1]
+          && PayloadCodec::decode(record + 1, PayloadCodec::SENSOR_UPDATE_SIZE, ring[count])) {
+        count++;
+        readOffset += RECORD_SIZE;
+      } else {
+        readOffset++;  // Torn or corrupt record, resynchronize
+      }
+    }
+
+    // Only a torn tail is left
+    if (count == 0 && readOffset + RECORD_SIZE > end && end > 0) {
+      storage.clear();
+      readOffset = 0;
+    }
+  }
+};
+}
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef PAYLOAD_CODEC_H
+#define PAYLOAD_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace FindSpot {
+
+enum class PayloadFormat : uint8_t {
+  JSON,    // Self-describing object with name, pins and ISO timestamp
+  BINARY   // Fixed little-endian record, see PayloadCodec
+};
+
+/// @brief The part of a sensor's state that changes between publishes
+struct SensorUpdate {
+  uint8_t index;
+  bool occupied;
+  uint16_t distanceCm;  // PayloadCodec::NO_DISTANCE when there is no valid echo
+  uint32_t timestamp;   // Unix seconds, 0 before the clock is synchronized
+};
+
+/// @brief Distance of one spot that changed within an aggregate window
+struct SpotDelta {
+  uint8_t index;
+  uint16_t distanceCm;
+};
+
+/**
+ * Versioned binary encoding of a SensorUpdate.
+ *
+ * Layout (little-endian, 9 bytes):
+ *   [0]    version (PayloadCodec::VERSION)
+ *   [1]    sensor index
+ *   [2]    flags, bit 0 = occupied
+ *   [3..4] distance in cm
+ *   [5..8] timestamp
+ *
+ * A JSON payload always starts with '{', so a receiver can tell the two
+ * formats apart from the first byte.
+ *
+ * Device-level aggregate (little-endian):
+ *   [0]      version (PayloadCodec::AGGREGATE_VERSION)
+ *   [1]      spot count N
+ *   [2..5]   timestamp
+ *   [6..]    ceil(N / 8) bitmap bytes, bit i set = spot i occupied
+ *   then     delta count M, followed by M x (index, distance in cm)
+ *
+ * Portable C++, no Arduino dependency.
+ */
+namespace PayloadCodec {
+
+constexpr uint8_t VERSION = 1;
+constexpr uint16_t NO_DISTANCE = 0xFFFF;
+constexpr size_t SENSOR_UPDATE_SIZE = 9;
+constexpr uint8_t FLAG_OCCUPIED = 0x01;
+
+constexpr uint8_t AGGREGATE_VERSION = 1;
+constexpr uint8_t MAX_AGGREGATE_SPOTS = 64;
+
+constexpr size_t aggregateSize(uint8_t spots, uint8_t deltas) {
+  return 6 + (spots + 7) / 8 + 1 + deltas * 3;
+}
+
+inline void putU16(uint8_t* out, uint16_t v) {
+  out[0] = v & 0xFF;
+  out[1] = v >> 8;
+}
+
+inline void putU32(uint8_t* out, uint32_t v) {
+  for (uint8_t i = 0; i < 4; i++) {
+    out[i] = (v >> (8 * i)) & 0xFF;
+  }
+}
+
+inline uint16_t getU16(const uint8_t* in) {
+  return in[0] | (in[1] << 8);
+}
+
+inline uint32_t getU32(const uint8_t* in) {
+  uint32_t v = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    v |= static_cast<uint32_t>(in[i]) << (8 * i);
+  }
+  return v;
+}
+
+/// @return Encoded length, or 0 if `capacity` is too small
+inline size_t encode(const SensorUpdate& update, uint8_t* out, size_t capacity) {
+  if (capacity < SENSOR_UPDATE_SIZE) {
+    return 0;
+  }
+  out[0] = VERSION;
+  out[1] = update.index;
+  out[2] = update.occupied ? FLAG_OCCUPIED : 0;
+  putU16(out + 3, update.distanceCm);
+  putU32(out + 5, update.timestamp);
+  return SENSOR_UPDATE_SIZE;
+}
+
+/// @return False if the buffer is not a SensorUpdate of a known version
+inline bool decode(const uint8_t* in, size_t length, SensorUpdate& update) {
+  if (length < SENSOR_UPDATE_SIZE || in[0] != VERSION) {
+    return false;
+  }
+  update.index = in[1];
+  update.occupied = in[2] & FLAG_OCCUPIED;
+  update.distanceCm = getU16(in + 3);
+  update.timestamp = getU32(in + 5);
+  return true;
+}
+
+/// @return Encoded length, or 0 if the arguments or `capacity` are out of range
+inline size_t encodeAggregate(uint64_t bitmap, uint8_t spots, const SpotDelta* deltas, uint8_t deltaCount,
+                              uint32_t timestamp, uint8_t* out, size_t capacity) {
+  size_t size = aggregateSize(spots, deltaCount);
+  if (spots > MAX_AGGREGATE_SPOTS || deltaCount > spots || capacity < size) {
+    return 0;
+  }
+  out[0] = AGGREGATE_VERSION;
+  out[1] = spots;
+  putU32(out + 2, timestamp);
+
+  uint8_t* pos = out + 6;
+  for (uint8_t i = 0; i < (spots + 7) / 8; i++) {
+    *pos++ = (bitmap >> (8 * i)) & 0xFF;
+  }
+
+  *pos++ = deltaCount;
+  for (uint8_t i = 0; i < deltaCount; i++) {
+    *pos++ = deltas[i].index;
+    putU16(pos, deltas[i].distanceCm);
+    pos += 2;
+  }
+  return size;
+}
+
+/// @param deltas Receives up to `maxDeltas` entries; `deltaCount` reports how many were encoded
+/// @return False if the buffer is malformed or of an unknown version
+inline bool decodeAggregate(const uint8_t* in, size_t length, uint64_t& bitmap, uint8_t& spots,
+                            uint32_t& timestamp, SpotDelta* deltas, uint8_t maxDeltas, uint8_t& deltaCount) {
+  if (length < 7 || in[0] != AGGREGATE_VERSION || in[1] > MAX_AGGREGATE_SPOTS) {
+    return false;
+  }
+  spots = in[1];
+  timestamp = getU32(in + 2);
+
+  size_t bitmapBytes = (spots + 7) / 8;
+  if (length < 6 + bitmapBytes + 1) {
+    return false;
+  }
+  bitmap = 0;
+  for (size_t i = 0; i < bitmapBytes; i++) {
+    bitmap |= static_cast<uint64_t>(in[6 + i]) << (8 * i);
+  }
+
+  deltaCount = in[6 + bitmapBytes];
+  if (length < aggregateSize(spots, deltaCount) || deltaCount > maxDeltas) {
+    return false;
+  }
+  const uint8_t* pos = in + 6 + bitmapBytes + 1;
+  for (uint8_t i = 0; i < deltaCount; i++) {
+    deltas[i].index = pos[0];
+    deltas[i].distanceCm = getU16(pos + 1);
+    pos += 3;
+  }
+  return true;
+}
+}
+}
+
+#endif
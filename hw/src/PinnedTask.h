@@ -0,0 +1,103 @@
+#ifndef PINNED_TASK_H
+#define PINNED_TASK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "esp_task_wdt.h"
+#else
+#include <chrono>
+#include <thread>
+#endif
+
+namespace FindSpot {
+
+/**
+ * Calls `step` forever, pausing `periodMs` between calls, on a task of its own.
+ *
+ * On the device this is a FreeRTOS task pinned to one core. It is
+ * subscribed to the task watchdog, which it feeds before every step, so a
+ * step that hangs resets the board. The pause yields the core, and the
+ * idle task the watchdog also watches gets to run. On a host the same loop
+ * runs on a std::thread and `core`, `stackBytes` and `priority` are
+ * ignored, so the task split can be stress-tested off the device.
+ */
+class PinnedTask {
+public:
+  typedef void (*Step)();
+
+  PinnedTask(const char* name, Step step, uint32_t periodMs) : name(name), step(step), periodMs(periodMs) {}
+
+  PinnedTask(const PinnedTask&) = delete;
+  PinnedTask& operator=(const PinnedTask&) = delete;
+
+#ifdef ARDUINO
+  /// @return False if the task could not be created
+  bool start(uint8_t core, uint32_t stackBytes, uint8_t priority) {
+    running.store(true);
+    return xTaskCreatePinnedToCore(run, name, stackBytes, this, priority, nullptr, core) == pdPASS;
+  }
+#else
+  /// @brief Host build: a plain thread; core, stack size and priority are left to the OS
+  bool start(uint8_t /* core */, uint32_t /* stackBytes */, uint8_t /* priority */) {
+    running.store(true);
+    thread = std::thread(run, this);
+    return true;
+  }
+
+  /// @brief Finish the current step and join; host only
+  void stop() {
+    running.store(false);
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+
+  ~PinnedTask() {
+    stop();
+  }
+#endif
+
+  /// @brief Steps completed so far
+  uint32_t getSteps() const {
+    return steps.load(std::memory_order_relaxed);
+  }
+
+private:
+  const char* name;
+  Step step;
+  uint32_t periodMs;
+  std::atomic<bool> running{false};
+  std::atomic<uint32_t> steps{0};
+#ifndef ARDUINO
+  std::thread thread;
+#endif
+
+#ifdef ARDUINO
+  static void run(void* arg) {
+    PinnedTask* task = static_cast<PinnedTask*>(arg);
+    esp_task_wdt_add(NULL);
+    for (;;) {
+      esp_task_wdt_reset();
+      task->step();
+      task->steps.fetch_add(1, std::memory_order_relaxed);
+      vTaskDelay(pdMS_TO_TICKS(task->periodMs) > 0 ? pdMS_TO_TICKS(task->periodMs) : 1);
+    }
+  }
+#else
+  static void run(PinnedTask* task) {
+    while (task->running.load()) {
+      task->step();
+      task->steps.fetch_add(1, std::memory_order_relaxed);
+      std::this_thread::sleep_for(std::chrono::milliseconds(task->periodMs));
+    }
+  }
+#endif
+};
+
+}
+
+#endif
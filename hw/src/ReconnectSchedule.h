@@ -0,0 +1,90 @@
+#ifndef RECONNECT_SCHEDULE_H
+#define RECONNECT_SCHEDULE_H
+
+#include <stdint.h>
+#include "Backoff.h"
+
+namespace FindSpot {
+
+/**
+ * When the next broker connection attempt may start.
+ *
+ * Failed attempts are spaced by a jittered backoff, and a connection that
+ * held for `stableMs` earns the short delay back. While the network link is
+ * down no attempt is due at all, so an outage is not counted against the
+ * broker and does not grow the backoff; once the link is back the next
+ * attempt is due at once.
+ *
+ *   if (schedule.isDue(nowMs)) startAttempt();
+ *   schedule.onFailure(nowMs);     // the attempt failed
+ *   schedule.onNetworkDown();      // from the link listener
+ *
+ * Portable C++, no Arduino dependency.
+ */
+class ReconnectSchedule {
+public:
+  ReconnectSchedule(const Backoff& backoff, uint32_t stableMs) : backoff(backoff), stableMs(stableMs) {}
+
+  /// @return True if an attempt may start now
+  bool isDue(uint32_t nowMs) const {
+    return networkUp && nowMs - lastAttemptMs >= delayMs;
+  }
+
+  /// @brief An attempt failed; the next one waits out the backoff
+  /// @return Delay before the next attempt
+  uint32_t onFailure(uint32_t nowMs) {
+    delayMs = backoff.next();
+    lastAttemptMs = nowMs;
+    return delayMs;
+  }
+
+  /// @brief An established connection dropped after `connectedForMs`
+  /// @return Delay before the next attempt
+  uint32_t onLost(uint32_t nowMs, uint32_t connectedForMs) {
+    if (connectedForMs >= stableMs) {
+      backoff.reset();
+    }
+    return onFailure(nowMs);
+  }
+
+  /// @brief Make the next attempt due right away, with the backoff reset
+  void retryNow(uint32_t nowMs) {
+    backoff.reset();
+    delayMs = 0;
+    lastAttemptMs = nowMs;
+  }
+
+  /// @brief Hold all attempts until onNetworkUp()
+  void onNetworkDown() {
+    networkUp = false;
+  }
+
+  /// @brief The link is back; the outage was not the broker's fault, so connect right away
+  void onNetworkUp(uint32_t nowMs) {
+    networkUp = true;
+    retryNow(nowMs);
+  }
+
+  bool isNetworkUp() const {
+    return networkUp;
+  }
+
+  uint32_t getDelayMs() const {
+    return delayMs;
+  }
+
+  /// @brief Failed attempts since the backoff was last reset
+  uint32_t getFailures() const {
+    return backoff.getAttempt();
+  }
+
+private:
+  Backoff backoff;
+  uint32_t stableMs;
+  uint32_t delayMs = 0;
+  uint32_t lastAttemptMs = 0;
+  bool networkUp = true;
+};
+}
+
+#endif
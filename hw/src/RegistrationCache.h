@@ -0,0 +1,114 @@
+#ifndef REGISTRATION_CACHE_H
+#define REGISTRATION_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Longest credential, broker host or topic kept in the cache
+#define REGISTRATION_FIELD_LEN 64
+
+namespace FindSpot {
+
+/// @brief What the device needs from a registration to go straight to MQTT
+struct CachedRegistration {
+  static const uint8_t VERSION = 1;
+
+  uint32_t token;          // Fingerprint of the setup the registration was made with
+  int32_t deviceId;
+  uint16_t mqttPort;
+  uint8_t payloadFormat;   // PayloadFormat value
+  char mqttUsername[REGISTRATION_FIELD_LEN];
+  char mqttPassword[REGISTRATION_FIELD_LEN];
+  char mqttBroker[REGISTRATION_FIELD_LEN];
+  char sensorTopic[REGISTRATION_FIELD_LEN];
+
+  /// @return False if the text does not fit
+  static bool copyField(char (&field)[REGISTRATION_FIELD_LEN], const char* text) {
+    size_t length = strlen(text);
+    if (length >= REGISTRATION_FIELD_LEN) {
+      return false;
+    }
+    memcpy(field, text, length + 1);
+    return true;
+  }
+
+  bool operator==(const CachedRegistration& other) const {
+    return token == other.token && deviceId == other.deviceId && mqttPort == other.mqttPort
+      && payloadFormat == other.payloadFormat
+      && strcmp(mqttUsername, other.mqttUsername) == 0 && strcmp(mqttPassword, other.mqttPassword) == 0
+      && strcmp(mqttBroker, other.mqttBroker) == 0 && strcmp(sensorTopic, other.sensorTopic) == 0;
+  }
+};
+
+/**
+ * Last successful registration, kept across reboots so the device can
+ * connect to the broker without waiting for the backend.
+ *
+ * Each entry carries a validity token, a fingerprint of everything the
+ * registration depends on (MAC, backend address, requested payload
+ * format). A firmware built for another backend, or a board swap, changes
+ * the token and the stale entry is ignored. The caller still revalidates
+ * a cached entry against the backend once the device is running.
+ *
+ * `Storage` is the one-blob interface of RuntimeConfig (NvsStorage on the
+ * device):
+ *   size_t load(uint8_t* out, size_t capacity);
+ *   bool save(const uint8_t* data, size_t length);
+ */
+template <typename Storage>
+class RegistrationCache {
+public:
+  explicit RegistrationCache(Storage& storage) : storage(storage) {}
+
+  /// @brief FNV-1a over `text` and its terminator, chained through `hash` to combine several inputs
+  /// @note The terminator keeps the inputs apart: "10.0.0.1" + "80" and "10.0.0.18" + "0" differ
+  static uint32_t fingerprint(const char* text, uint32_t hash = 2166136261UL) {
+    do {
+      hash ^= static_cast<uint8_t>(*text);
+      hash *= 16777619UL;
+    } while (*text++);
+    return hash;
+  }
+
+  /// @return True if an entry with this token is stored
+  bool load(uint32_t token, CachedRegistration& out) {
+    uint8_t blob[BLOB_SIZE];
+    if (storage.load(blob, sizeof(blob)) != BLOB_SIZE || blob[0] != CachedRegistration::VERSION) {
+      return false;
+    }
+    CachedRegistration entry;
+    memcpy(&entry, blob + 1, sizeof(entry));
+    if (entry.token != token || entry.deviceId <= 0 || entry.mqttPort == 0 || !terminated(entry)) {
+      return false;
+    }
+    out = entry;
+    return true;
+  }
+
+  bool save(const CachedRegistration& entry) {
+    uint8_t blob[BLOB_SIZE];
+    blob[0] = CachedRegistration::VERSION;
+    memcpy(blob + 1, &entry, sizeof(entry));
+    return storage.save(blob, sizeof(blob));
+  }
+
+  /// @brief Forget the entry, so the next boot registers over HTTP
+  bool clear() {
+    uint8_t empty = 0;
+    return storage.save(&empty, 1);
+  }
+
+private:
+  static const size_t BLOB_SIZE = 1 + sizeof(CachedRegistration);
+
+  Storage& storage;
+
+  static bool terminated(const CachedRegistration& entry) {
+    return memchr(entry.mqttUsername, '\0', REGISTRATION_FIELD_LEN) && memchr(entry.mqttPassword, '\0', REGISTRATION_FIELD_LEN)
+      && memchr(entry.mqttBroker, '\0', REGISTRATION_FIELD_LEN) && memchr(entry.sensorTopic, '\0', REGISTRATION_FIELD_LEN);
+  }
+};
+}
+
+#endif
@@ -0,0 +1,380 @@
+#ifndef RUNTIME_CONFIG_H
+#define RUNTIME_CONFIG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "SensorTable.h"
+#include "PayloadCodec.h"
+
+namespace FindSpot {
+
+/**
+ * Settings that can be changed without reflashing.
+ *
+ * Persisted field by field in a fixed little-endian layout behind a
+ * version byte (see RuntimeConfig), never as the raw struct, so the
+ * stored form does not depend on SENSOR_COUNT or on padding.
+ */
+struct Settings {
+  static const uint8_t VERSION = 2;
+
+  uint32_t sampleMinMs;  // Scan period and fastest sampling of a spot
+  uint32_t sampleMaxMs;  // Slowest sampling of a stable spot
+  uint16_t minCm;        // Readings below this are discarded
+  uint16_t enterCm;      // Below this the spot becomes occupied
+  uint16_t exitCm;       // Above this an occupied spot is freed
+  uint8_t trigPin[SENSOR_COUNT];
+  uint8_t echoPin[SENSOR_COUNT];
+
+  /// @brief Settings with the given tuning and the pins of SENSOR_TABLE
+  static Settings make(uint32_t sampleMinMs, uint32_t sampleMaxMs,
+                       uint16_t minCm, uint16_t enterCm, uint16_t exitCm) {
+    Settings settings = {};
+    settings.sampleMinMs = sampleMinMs;
+    settings.sampleMaxMs = sampleMaxMs;
+    settings.minCm = minCm;
+    settings.enterCm = enterCm;
+    settings.exitCm = exitCm;
+    for (size_t i = 0; i < SENSOR_COUNT; i++) {
+      settings.trigPin[i] = SENSOR_TABLE[i].trigPin;
+      settings.echoPin[i] = SENSOR_TABLE[i].echoPin;
+    }
+    return settings;
+  }
+
+  bool sameThresholds(const Settings& other) const {
+    return minCm == other.minCm && enterCm == other.enterCm && exitCm == other.exitCm;
+  }
+
+  bool samePins(const Settings& other, size_t i) const {
+    return trigPin[i] == other.trigPin[i] && echoPin[i] == other.echoPin[i];
+  }
+
+  bool operator==(const Settings& other) const {
+    if (sampleMinMs != other.sampleMinMs || sampleMaxMs != other.sampleMaxMs || !sameThresholds(other)) {
+      return false;
+    }
+    for (size_t i = 0; i < SENSOR_COUNT; i++) {
+      if (!samePins(other, i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+/**
+ * Validated, persistent store of the runtime Settings.
+ *
+ * Every change goes through set(): the candidate is checked as a whole,
+ * written to storage, and only then made current and handed to the
+ * listener, which applies it to the running hardware. An invalid value
+ * or a failed write leaves both the stored and the live settings
+ * untouched, so a change is applied completely or not at all.
+ *
+ * apply() reads the compact text form used over MQTT and HTTP:
+ *   "min_ms=250,max_ms=8000,min_cm=5,enter_cm=50,exit_cm=60,trig0=22,echo0=23"
+ * Pairs may be separated by ',', '&', ';' or whitespace; keys that are not
+ * given keep their current value.
+ *
+ * Stored layout (little-endian):
+ *   [0]      Settings::VERSION
+ *   [1..4]   sampleMinMs
+ *   [5..8]   sampleMaxMs
+ *   [9..14]  minCm, enterCm, exitCm
+ *   [15]     spot count N
+ *   then     N x (index, table trig, table echo, trig, echo)
+ * Each spot's pins are keyed by its index and the pins SENSOR_TABLE gave
+ * it when they were saved. A reflash that changes a row of the table, or
+ * drops it, discards that spot's stored pins and the new table applies.
+ * Version 1 stored the raw struct; only its leading scalar fields, whose
+ * layout never depended on the table, are taken over.
+ *
+ * `Storage` holds one blob:
+ *   size_t load(uint8_t* out, size_t capacity);  // stored length, 0 if none or too large
+ *   bool save(const uint8_t* data, size_t length);
+ * NvsStorage backs it on the device; a host test can use a byte array.
+ */
+template <typename Storage>
+class RuntimeConfig {
+public:
+  typedef void (*Listener)(const Settings& previous, const Settings& current);
+
+  enum class Source : uint8_t {
+    STORED,    // Loaded as saved
+    MIGRATED,  // Saved by an older firmware or for another sensor table; what no longer applies has its default
+    DEFAULTS   // Nothing usable stored
+  };
+
+  enum class Result : uint8_t {
+    APPLIED,
+    UNCHANGED,
+    BAD_FORMAT,  // Update text could not be parsed
+    INVALID,     // Settings out of range; nothing changed
+    NOT_SAVED    // Storage write failed; nothing changed
+  };
+
+  /// @param minPeriodMs Shortest allowed scan period, one slot per crosstalk group
+  RuntimeConfig(Storage& storage, const Settings& defaults, uint32_t minPeriodMs)
+    : storage(storage), defaults(defaults), current(defaults), minPeriodMs(minPeriodMs) {}
+
+  /// @brief Load the stored settings; falls back to the defaults if they are missing or invalid
+  Source begin() {
+    uint8_t blob[HEADER_SIZE + MAX_STORED_SPOTS * SPOT_SIZE];
+    size_t length = storage.load(blob, sizeof(blob));
+    Settings loaded = defaults;
+    Source source = Source::DEFAULTS;
+
+    if (length >= HEADER_SIZE && blob[0] == Settings::VERSION) {
+      source = decode(blob, length, loaded);
+    } else if (length >= 1 + SCALAR_SIZE && blob[0] == LEGACY_VERSION) {
+      decodeScalars(blob + 1, loaded);
+      source = Source::MIGRATED;
+    }
+
+    if (source != Source::DEFAULTS && !isValid(loaded)) {
+      loaded = defaults;
+      source = Source::DEFAULTS;
+    }
+    current = loaded;
+    return source;
+  }
+
+  void setListener(Listener cb) {
+    listener = cb;
+  }
+
+  const Settings& get() const {
+    return current;
+  }
+
+  const Settings& getDefaults() const {
+    return defaults;
+  }
+
+  /// @brief Validate, persist and apply `candidate` as one step
+  Result set(const Settings& candidate) {
+    if (!isValid(candidate)) {
+      return Result::INVALID;
+    }
+    if (candidate == current) {
+      return Result::UNCHANGED;
+    }
+
+    uint8_t blob[BLOB_SIZE];
+    encode(candidate, blob);
+    if (!storage.save(blob, sizeof(blob))) {
+      return Result::NOT_SAVED;
+    }
+
+    Settings previous = current;
+    current = candidate;
+    if (listener) {
+      listener(previous, current);
+    }
+    return Result::APPLIED;
+  }
+
+  /// @brief Apply an update in the compact `key=value` form; the text need not be NUL-terminated
+  Result apply(const char* text, size_t length) {
+    Settings candidate = current;
+    const char* end = text + length;
+    const char* p = text;
+
+    while (p < end) {
+      if (*p == ',' || *p == '&' || *p == ';' || *p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') {
+        p++;
+        continue;
+      }
+
+      const char* key = p;
+      while (p < end && *p != '=') {
+        p++;
+      }
+      if (p == end) {
+        return Result::BAD_FORMAT;
+      }
+      size_t keyLength = p - key;
+      p++;
+
+      uint32_t value;
+      if (!parseNumber(p, end, value) || !assign(candidate, key, keyLength, value)) {
+        return Result::BAD_FORMAT;
+      }
+    }
+    return set(candidate);
+  }
+
+  /// @return True if every field is in range and no pin is used twice
+  bool isValid(const Settings& s) const {
+    if (s.sampleMinMs < minPeriodMs || s.sampleMaxMs < s.sampleMinMs || s.sampleMaxMs > MAX_INTERVAL_MS) {
+      return false;
+    }
+    if (s.minCm == 0 || s.enterCm <= s.minCm || s.exitCm < s.enterCm || s.exitCm > MAX_DISTANCE_CM) {
+      return false;
+    }
+
+    uint64_t used = 0;
+    for (size_t i = 0; i < SENSOR_COUNT; i++) {
+      if (!isOutputPin(s.trigPin[i]) || !isInputPin(s.echoPin[i])) {
+        return false;
+      }
+      uint64_t pins = (1ULL << s.trigPin[i]) | (1ULL << s.echoPin[i]);
+      if (s.trigPin[i] == s.echoPin[i] || (used & pins)) {
+        return false;
+      }
+      used |= pins;
+    }
+    return true;
+  }
+
+  static const char* describe(Result result) {
+    switch (result) {
+      case Result::APPLIED:    return "applied";
+      case Result::UNCHANGED:  return "unchanged";
+      case Result::BAD_FORMAT: return "bad format";
+      case Result::INVALID:    return "invalid value";
+      case Result::NOT_SAVED:  return "storage write failed";
+    }
+    return "unknown";
+  }
+
+private:
+  static const uint8_t LEGACY_VERSION = 1;  // The raw struct
+  static const size_t SCALAR_SIZE = 14;
+  static const size_t HEADER_SIZE = 1 + SCALAR_SIZE + 1;
+  static const size_t SPOT_SIZE = 5;
+  static const size_t MAX_STORED_SPOTS = 64;  // Largest table whose blob is still read
+  static const size_t BLOB_SIZE = HEADER_SIZE + SENSOR_COUNT * SPOT_SIZE;
+  static_assert(SENSOR_COUNT <= MAX_STORED_SPOTS, "A stored blob could not be read back");
+  static const uint32_t MAX_INTERVAL_MS = 3600000UL;
+  static const uint16_t MAX_DISTANCE_CM = 400;  // HC-SR04 range
+
+  Storage& storage;
+  Settings defaults;
+  Settings current;
+  uint32_t minPeriodMs;
+  Listener listener = nullptr;
+
+  /// @brief ESP32 GPIOs usable for input; 1 and 3 are UART0 (console), 6..11 belong to the flash
+  static bool isInputPin(uint8_t pin) {
+    return pin <= 39 && pin != 1 && pin != 3 && !(pin >= 6 && pin <= 11) && pin != 20 && pin != 24
+      && !(pin >= 28 && pin <= 31);
+  }
+
+  /// @brief 34..39 are input-only
+  static bool isOutputPin(uint8_t pin) {
+    return pin < 34 && isInputPin(pin);
+  }
+
+  static void encode(const Settings& s, uint8_t* out) {
+    out[0] = Settings::VERSION;
+    PayloadCodec::putU32(out + 1, s.sampleMinMs);
+    PayloadCodec::putU32(out + 5, s.sampleMaxMs);
+    PayloadCodec::putU16(out + 9, s.minCm);
+    PayloadCodec::putU16(out + 11, s.enterCm);
+    PayloadCodec::putU16(out + 13, s.exitCm);
+    out[15] = SENSOR_COUNT;
+    uint8_t* spot = out + HEADER_SIZE;
+    for (size_t i = 0; i < SENSOR_COUNT; i++, spot += SPOT_SIZE) {
+      spot[0] = i;
+      spot[1] = SENSOR_TABLE[i].trigPin;
+      spot[2] = SENSOR_TABLE[i].echoPin;
+      spot[3] = s.trigPin[i];
+      spot[4] = s.echoPin[i];
+    }
+  }
+
+  /// @brief Scalar fields, in the same place in both versions
+  static void decodeScalars(const uint8_t* in, Settings& s) {
+    s.sampleMinMs = PayloadCodec::getU32(in);
+    s.sampleMaxMs = PayloadCodec::getU32(in + 4);
+    s.minCm = PayloadCodec::getU16(in + 8);
+    s.enterCm = PayloadCodec::getU16(in + 10);
+    s.exitCm = PayloadCodec::getU16(in + 12);
+  }
+
+  /// @brief Read a current-version blob over `s`, which holds the defaults
+  static Source decode(const uint8_t* in, size_t length, Settings& s) {
+    size_t spots = in[15];
+    if (length != HEADER_SIZE + spots * SPOT_SIZE) {
+      return Source::DEFAULTS;
+    }
+    decodeScalars(in + 1, s);
+
+    size_t matched = 0;
+    const uint8_t* spot = in + HEADER_SIZE;
+    for (size_t n = 0; n < spots; n++, spot += SPOT_SIZE) {
+      size_t i = spot[0];
+      if (i < SENSOR_COUNT && spot[1] == SENSOR_TABLE[i].trigPin && spot[2] == SENSOR_TABLE[i].echoPin) {
+        s.trigPin[i] = spot[3];
+        s.echoPin[i] = spot[4];
+        matched++;
+      }
+    }
+    return spots == SENSOR_COUNT && matched == SENSOR_COUNT ? Source::STORED : Source::MIGRATED;
+  }
+
+  static bool parseNumber(const char*& p, const char* end, uint32_t& value) {
+    const char* start = p;
+    uint64_t n = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+      n = n * 10 + (*p - '0');
+      if (n > UINT32_MAX) {
+        return false;
+      }
+      p++;
+    }
+    value = static_cast<uint32_t>(n);
+    return p > start;
+  }
+
+  static bool keyIs(const char* key, size_t length, const char* name) {
+    return strlen(name) == length && memcmp(key, name, length) == 0;
+  }
+
+  /// @brief Parse the sensor index of a "trig<N>"/"echo<N>" key
+  static bool pinIndex(const char* key, size_t length, const char* prefix, size_t& index) {
+    if (length <= 4 || memcmp(key, prefix, 4) != 0) {
+      return false;
+    }
+    const char* p = key + 4;
+    uint32_t n;
+    if (!parseNumber(p, key + length, n) || p != key + length || n >= SENSOR_COUNT) {
+      return false;
+    }
+    index = n;
+    return true;
+  }
+
+  static bool assign(Settings& s, const char* key, size_t length, uint32_t value) {
+    size_t index;
+    if (keyIs(key, length, "min_ms")) {
+      s.sampleMinMs = value;
+    } else if (keyIs(key, length, "max_ms")) {
+      s.sampleMaxMs = value;
+    } else if (value > UINT16_MAX) {
+      return false;
+    } else if (keyIs(key, length, "min_cm")) {
+      s.minCm = value;
+    } else if (keyIs(key, length, "enter_cm")) {
+      s.enterCm = value;
+    } else if (keyIs(key, length, "exit_cm")) {
+      s.exitCm = value;
+    } else if (value > UINT8_MAX) {
+      return false;
+    } else if (pinIndex(key, length, "trig", index)) {
+      s.trigPin[index] = value;
+    } else if (pinIndex(key, length, "echo", index)) {
+      s.echoPin[index] = value;
+    } else {
+      return false;
+    }
+    return true;
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef SCAN_SCHEDULER_H
+#define SCAN_SCHEDULER_H
+
+#include <stdint.h>
+
+namespace FindSpot {
+
+/**
+ * Time-slot scheduler for ultrasonic sensors.
+ *
+ * Sensors are split into crosstalk groups: sensors in the same group are far
+ * enough apart to ping at the same time, while different groups must not
+ * overlap. A scan fires each group in its own slot of `slotUs` (the minimum
+ * separation between groups), then waits until `periodUs` has elapsed since
+ * the scan started. Pure timing logic, driven by the caller's clock.
+ */
+class ScanScheduler {
+public:
+  static const int NO_GROUP = -1;
+
+  ScanScheduler(uint8_t groups, uint32_t slotDurationUs, uint32_t scanPeriodUs)
+    : groupCount(groups ? groups : 1), slotUs(slotDurationUs), periodUs(scanPeriodUs) {}
+
+  /// @brief Advance the schedule
+  /// @return The crosstalk group to fire now, or NO_GROUP if nothing is due
+  int poll(uint32_t nowUs) {
+    if (!started) {
+      started = true;
+      return startScan(nowUs);
+    }
+
+    if (nextGroup < groupCount) {
+      if (nowUs - slotStartUs < slotUs) {
+        return NO_GROUP;
+      }
+      slotStartUs = nowUs;
+      return nextGroup++;
+    }
+
+    // All groups fired; the last slot must still expire before the next scan
+    if (nowUs - slotStartUs < slotUs || nowUs - scanStartUs < periodUs) {
+      return NO_GROUP;
+    }
+
+    lastScanUs = nowUs - scanStartUs;
+    scanCount++;
+    return startScan(nowUs);
+  }
+
+  /// @brief Change the scan period; takes effect from the next scan
+  void setPeriodUs(uint32_t scanPeriodUs) {
+    periodUs = scanPeriodUs;
+  }
+
+  /// @brief Duration of the last completed scan, in microseconds
+  uint32_t getLastScanUs() const {
+    return lastScanUs;
+  }
+
+  /// @brief Achieved full-scan rate, based on the last completed scan
+  float getScanRateHz() const {
+    return lastScanUs ? 1000000.0f / lastScanUs : 0.0f;
+  }
+
+  uint32_t getScanCount() const {
+    return scanCount;
+  }
+
+  uint8_t getGroupCount() const {
+    return groupCount;
+  }
+
+private:
+  uint8_t groupCount;
+  uint32_t slotUs;
+  uint32_t periodUs;
+
+  bool started = false;
+  uint8_t nextGroup = 0;
+  uint32_t scanStartUs = 0;
+  uint32_t slotStartUs = 0;
+  uint32_t lastScanUs = 0;
+  uint32_t scanCount = 0;
+
+  int startScan(uint32_t nowUs) {
+    scanStartUs = nowUs;
+    slotStartUs = nowUs;
+    nextGroup = 1;
+    return 0;
+  }
+};
+}
+
+#endif
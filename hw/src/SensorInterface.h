@@ -1,26 +1,69 @@
 #ifndef SENSOR_H
 #define SENSOR_H
 
-#include <Arduino.h>
-#include <ArduinoJson.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Room for "<technology>_<index>_<device name>_<device id>"
+#define SENSOR_NAME_LEN 48
 
 namespace FindSpot {
-class ISensor {
+
+/**
+ * Common base for all sensors, resolved at compile time (CRTP).
+ *
+ * A sensor type derives as `class X : public SensorBase<X>` and provides:
+ *   static constexpr const char* TYPE;  // e.g. "distance"
+ *   void begin();
+ *   bool checkState();
+ * and serializes its state in its own way (DistanceSensor from a Label
+ * and a SensorUpdate, so publishing never reads the sensor).
+ *
+ * Sensors are always used through their concrete type, so none of these
+ * calls go through a vtable. Names are kept in a fixed buffer and the
+ * technology points at an interned literal, so the accessors return views
+ * and never allocate.
+ *
+ * Portable C++, no Arduino dependency.
+ */
+template <typename Derived>
+class SensorBase {
 protected:
-    String name;
-    String type;
-    String technology;
-    int index;
+  char name[SENSOR_NAME_LEN] = "";
+  const char* technology = "";
+  int index = 0;
+
+  SensorBase(const char* sensorTech, int sensorIndex)
+    : technology(sensorTech), index(sensorIndex) {}
+
+  /// @brief Format: ultrasonic_0_esp32_dev_1 (includes device ID)
+  void setName(const char* deviceName, int deviceId) {
+    formatName(name, sizeof(name), technology, index, deviceName, deviceId);
+  }
+
 public:
-    virtual ~ISensor() = default;
-    virtual String toJson() const = 0;
-    virtual String getName() const = 0;
-    virtual String getType() const = 0;
-    virtual String getTechnology() const = 0;
-    virtual int getIndex() const = 0;
-    virtual bool checkState() = 0;
-    virtual void begin() = 0;
+  /// @brief Sensor name as setName() builds it, for code that labels sensors without touching them
+  static void formatName(char* out, size_t capacity, const char* technology, int index,
+                         const char* deviceName, int deviceId) {
+    snprintf(out, capacity, "%s_%d_%s_%d", technology, index, deviceName, deviceId);
+  }
+
+  const char* getName() const {
+    return name;
+  }
+
+  const char* getType() const {
+    return Derived::TYPE;
+  }
+
+  const char* getTechnology() const {
+    return technology;
+  }
+
+  int getIndex() const {
+    return index;
+  }
 };
 }
 
-#endif
\ No newline at end of file
+#endif
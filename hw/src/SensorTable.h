@@ -0,0 +1,123 @@
+#ifndef SENSOR_TABLE_H
+#define SENSOR_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+#include <utility>
+
+namespace FindSpot {
+
+/// @brief Compile-time description of one sensor attached to this device
+struct SensorSpec {
+  const char* type;        // Only "distance" is supported for now
+  const char* technology;  // e.g. "ultrasonic"
+  uint8_t index;           // Parking spot index, equal to the position in the table
+  uint8_t trigPin;
+  uint8_t echoPin;
+  uint8_t group;           // Crosstalk group; sensors sharing a group are pinged simultaneously
+};
+
+// ==================== Sensor Table ==================================== //
+// Each entry represents a parking spot. Sensors that cannot hear each
+// other may share a crosstalk group to be scanned in the same time slot.
+constexpr SensorSpec SENSOR_TABLE[] = {
+  // type        technology    index  trig  echo  group
+  { "distance", "ultrasonic",  0,     22,   23,   0 },
+  { "distance", "ultrasonic",  1,     14,   12,   1 },
+  { "distance", "ultrasonic",  2,     33,   32,   2 },
+};
+
+constexpr size_t SENSOR_COUNT = sizeof(SENSOR_TABLE) / sizeof(SENSOR_TABLE[0]);
+
+// ==================== Table validation ================================ //
+namespace SensorTableCheck {
+
+constexpr bool sameString(const char* a, const char* b) {
+  while (*a && *a == *b) {
+    a++;
+    b++;
+  }
+  return *a == *b;
+}
+
+constexpr bool typesSupported() {
+  for (size_t i = 0; i < SENSOR_COUNT; i++) {
+    if (!sameString(SENSOR_TABLE[i].type, "distance")) {
+      return false;
+    }
+  }
+  return true;
+}
+
+constexpr bool indicesMatchPositions() {
+  for (size_t i = 0; i < SENSOR_COUNT; i++) {
+    if (SENSOR_TABLE[i].index != i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+constexpr bool pinsUnique() {
+  for (size_t i = 0; i < SENSOR_COUNT; i++) {
+    if (SENSOR_TABLE[i].trigPin == SENSOR_TABLE[i].echoPin) {
+      return false;
+    }
+    for (size_t j = i + 1; j < SENSOR_COUNT; j++) {
+      const SensorSpec& a = SENSOR_TABLE[i];
+      const SensorSpec& b = SENSOR_TABLE[j];
+      if (a.trigPin == b.trigPin || a.trigPin == b.echoPin ||
+          a.echoPin == b.trigPin || a.echoPin == b.echoPin) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+constexpr uint8_t groupCount() {
+  uint8_t count = 0;
+  for (size_t i = 0; i < SENSOR_COUNT; i++) {
+    if (SENSOR_TABLE[i].group >= count) {
+      count = SENSOR_TABLE[i].group + 1;
+    }
+  }
+  return count;
+}
+
+constexpr bool groupsContiguous() {
+  for (uint8_t g = 0; g < groupCount(); g++) {
+    bool used = false;
+    for (size_t i = 0; i < SENSOR_COUNT; i++) {
+      used = used || SENSOR_TABLE[i].group == g;
+    }
+    if (!used) {
+      return false;
+    }
+  }
+  return true;
+}
+}
+
+constexpr uint8_t SENSOR_GROUP_COUNT = SensorTableCheck::groupCount();
+
+static_assert(SENSOR_COUNT > 0, "SENSOR_TABLE is empty");
+static_assert(SensorTableCheck::typesSupported(), "SENSOR_TABLE contains an unsupported sensor type");
+static_assert(SensorTableCheck::indicesMatchPositions(), "SENSOR_TABLE indices must be 0..N-1 in table order");
+static_assert(SensorTableCheck::pinsUnique(), "SENSOR_TABLE uses a pin more than once");
+static_assert(SensorTableCheck::groupsContiguous(), "SENSOR_TABLE crosstalk groups must be numbered without gaps");
+
+/// @brief Build one statically allocated sensor per table entry
+template <typename Sensor, size_t... I>
+std::array<Sensor, sizeof...(I)> makeSensors(std::index_sequence<I...>) {
+  return {{ Sensor(SENSOR_TABLE[I])... }};
+}
+
+template <typename Sensor>
+std::array<Sensor, SENSOR_COUNT> makeSensors() {
+  return makeSensors<Sensor>(std::make_index_sequence<SENSOR_COUNT>{});
+}
+}
+
+#endif
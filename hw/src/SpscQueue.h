@@ -0,0 +1,67 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+namespace FindSpot {
+
+/**
+ * Lock-free ring of CAPACITY items between exactly one producer and one consumer.
+ *
+ * The producer only writes `head` and the consumer only writes `tail`, so
+ * neither side ever waits for the other: push() fails when the ring is
+ * full and pop() when it is empty. An item is copied in before `head` is
+ * published (release) and read after it is observed (acquire). The two
+ * sides may run on different cores, or different threads of a host test.
+ */
+template <typename T, size_t CAPACITY>
+class SpscQueue {
+  static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "Capacity must be a power of two");
+
+public:
+  /// @brief Producer side
+  /// @return False if the queue is full
+  bool push(const T& item) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == CAPACITY) {
+      return false;
+    }
+    items[h & MASK] = item;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// @brief Consumer side
+  /// @return False if the queue is empty
+  bool pop(T& item) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = items[t & MASK];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// @brief Items queued; exact only on the consumer side, a snapshot elsewhere
+  size_t size() const {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+  }
+
+  bool isEmpty() const {
+    return size() == 0;
+  }
+
+private:
+  static const uint32_t MASK = CAPACITY - 1;
+
+  T items[CAPACITY];
+  std::atomic<uint32_t> head{0};  // Next slot to write; producer only
+  std::atomic<uint32_t> tail{0};  // Next slot to read; consumer only
+};
+
+}
+
+#endif
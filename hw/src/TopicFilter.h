@@ -0,0 +1,96 @@
+#ifndef TOPIC_FILTER_H
+#define TOPIC_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Longest topic filter, e.g. "device/{id}/cmd/#"
+#define TOPIC_FILTER_LEN 40
+
+namespace FindSpot {
+
+/**
+ * MQTT topic filter, split into levels once so matching is a single pass.
+ *
+ * Supports the MQTT wildcards: `+` matches one level, a trailing `#` matches
+ * the rest of the topic, which match() reports as the tail.
+ *
+ * Portable C++, no Arduino dependency.
+ */
+class TopicFilter {
+public:
+  static const uint8_t MAX_LEVELS = 8;
+
+  /// @return False if the pattern is too long or has too many levels
+  bool compile(const char* filter) {
+    size_t length = strlen(filter);
+    levelCount = 0;
+    if (length >= sizeof(pattern)) {
+      return false;
+    }
+    memcpy(pattern, filter, length + 1);
+
+    size_t start = 0;
+    for (size_t i = 0; i <= length; i++) {
+      if (pattern[i] == '/' || pattern[i] == '\0') {
+        if (levelCount == MAX_LEVELS) {
+          levelCount = 0;  // Match nothing rather than a prefix of the filter
+          return false;
+        }
+        levelStart[levelCount] = start;
+        levelLength[levelCount] = i - start;
+        levelCount++;
+        start = i + 1;
+      }
+    }
+    return true;
+  }
+
+  /// @param tail Set to the part matched by a trailing `#`, or to "" if there is none
+  bool match(const char* topic, const char** tail) const {
+    const char* pos = topic;
+    for (uint8_t level = 0; level < levelCount; level++) {
+      const char* p = pattern + levelStart[level];
+      uint8_t n = levelLength[level];
+
+      if (n == 1 && p[0] == '#') {
+        *tail = pos;
+        return true;
+      }
+
+      const char* end = strchr(pos, '/');
+      size_t topicLength = end ? static_cast<size_t>(end - pos) : strlen(pos);
+      if (!(n == 1 && p[0] == '+') && (topicLength != n || memcmp(pos, p, n) != 0)) {
+        return false;
+      }
+
+      bool lastLevel = level + 1 == levelCount;
+      if (!end) {
+        if (!lastLevel) {
+          return false;
+        }
+        *tail = pos + topicLength;
+        return true;
+      }
+      if (lastLevel) {
+        return false;
+      }
+      pos = end + 1;
+    }
+    return false;
+  }
+
+  const char* c_str() const {
+    return pattern;
+  }
+
+private:
+  char pattern[TOPIC_FILTER_LEN] = "";
+  uint8_t levelStart[MAX_LEVELS] = {};
+  uint8_t levelLength[MAX_LEVELS] = {};
+  uint8_t levelCount = 0;
+};
+}
+
+#endif
@@ -2,42 +2,150 @@
 #define WIFI_MANAGER_H
 
 #include <WiFi.h>
+#include <atomic>
 #include "esp_task_wdt.h"
 #include "Config.h"
+#include "NvsStorage.h"
+#include "WifiConnector.h"
+#include "Log.h"
 
 namespace FindSpot {
-class WiFiManager {
+
+/**
+ * The ESP32 WiFi driver as WifiConnector's Radio; link losses are counted from driver events
+ */
+class EspWifiRadio {
 public:
-  void connect() {
+  /// @brief Subscribe to the driver's link-loss events; once, before the first attempt
+  void begin() {
+    WiFi.onEvent(onLinkLost, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    WiFi.onEvent(onLinkLost, ARDUINO_EVENT_WIFI_STA_LOST_IP);
+  }
+
+  void beginFull() {
+    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);  // Back to DHCP
     WiFi.begin(WIFI_SSID, WIFI_PASS);
-    Serial.print("Connecting to WiFi");
-    
-    int attempts = 0;
-    const int maxAttempts = 60; // 30 seconds timeout (60 * 500ms)
-    
-    while (WiFi.status() != WL_CONNECTED && attempts < maxAttempts) {
-      delay(500);
-      Serial.print(".");
-      attempts++;
-      
-      // Reset watchdog every 5 attempts (2.5 seconds)
-      if (attempts % 5 == 0) {
-        esp_task_wdt_reset();
-      }
-    }
-    
-    if (WiFi.status() == WL_CONNECTED) {
-      Serial.println("\nWiFi connected!");
-      Serial.println(WiFi.localIP());
+  }
+
+  void beginDirected(const WifiLink& link, bool useLease) {
+    if (useLease) {
+      WiFi.config(IPAddress(link.ip), IPAddress(link.gateway), IPAddress(link.subnet), IPAddress(link.dns));
     } else {
-      Serial.println("\nWiFi connection failed!");
-      Serial.println("Please check your WiFi credentials and restart.");
+      WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
     }
+    WiFi.begin(WIFI_SSID, WIFI_PASS, link.channel, link.bssid);
   }
 
-  bool isConnected() {
+  bool connected() {
     return WiFi.status() == WL_CONNECTED;
   }
+
+  uint32_t getDisconnects() {
+    return linkLosses().load();
+  }
+
+  void readLink(WifiLink& link) {
+    const uint8_t* bssid = WiFi.BSSID();
+    if (bssid) {
+      memcpy(link.bssid, bssid, sizeof(link.bssid));
+    }
+    link.channel = WiFi.channel();
+    link.hasLease = 1;
+    link.ip = WiFi.localIP();
+    link.gateway = WiFi.gatewayIP();
+    link.subnet = WiFi.subnetMask();
+    link.dns = WiFi.dnsIP();
+  }
+
+  void disconnect() {
+    WiFi.disconnect();
+  }
+
+private:
+  static std::atomic<uint32_t>& linkLosses() {
+    static std::atomic<uint32_t> count{0};
+    return count;
+  }
+
+  /// @brief Runs on the WiFi event task
+  static void onLinkLost(arduino_event_id_t event) {
+    linkLosses().fetch_add(1);
+  }
+};
+
+class WiFiManager {
+public:
+  typedef WifiConnector<EspWifiRadio, NvsStorage> Connector;
+
+  WiFiManager()
+    : storage(CONFIG_NVS_NAMESPACE, WIFI_NVS_KEY),
+      connector(radio, storage, WIFI_FAST_CONNECT_TIMEOUT_MS, WIFI_CONNECT_TIMEOUT_MS, WIFI_REUSE_LEASE,
+                Backoff(WIFI_RETRY_BASE_MS, WIFI_RETRY_CAP_MS, esp_random())) {}
+
+  /**
+   * Start associating in the background, directed to the last access point if one is cached;
+   * poll() drives the attempts and isConnected() reports the result
+   */
+  void begin() {
+    WiFi.mode(WIFI_STA);
+    WiFi.persistent(false);        // The connector keeps its own cache; skip the driver's flash writes
+    WiFi.setAutoReconnect(false);  // Reconnects follow the connector's policy
+    radio.begin();
+    storage.begin();
+    connector.begin(millis());
+    LOG_INFO("Connecting to WiFi %s (%s)...", WIFI_SSID,
+             connector.getMode() == Connector::Mode::FAST ? "fast reconnect" : "scanning");
+  }
+
+  /**
+   * Called with true when the link comes up and false when it drops, from poll()
+   */
+  void setListener(Connector::LinkListener listener) {
+    connector.setListener(listener);
+  }
+
+  /**
+   * Supervise the link: reconnect after drops, fall back from a directed attempt to a scan,
+   * and back off between failed scans; never blocks
+   * @return True on the call that sees the link come up
+   */
+  bool poll() {
+    Connector::Mode before = connector.getMode();
+    bool cameUp = connector.poll(millis());
+    Connector::Mode after = connector.getMode();
+
+    if (cameUp) {
+      LOG_INFO("WiFi connected in %lu ms (%s), IP: %s, channel %d",
+               static_cast<unsigned long>(connector.getStats().lastAssociationMs),
+               before == Connector::Mode::FAST ? "fast reconnect" : "full scan",
+               WiFi.localIP().toString().c_str(), static_cast<int>(WiFi.channel()));
+    } else if (before == Connector::Mode::CONNECTED && after != before) {
+      LOG_WARN("WiFi connection lost, reconnecting (%s)", after == Connector::Mode::FAST ? "fast reconnect" : "scanning");
+    } else if (before == Connector::Mode::FAST && after == Connector::Mode::FULL) {
+      LOG_WARN("WiFi fast reconnect timed out, scanning");
+    } else if (before == Connector::Mode::FULL && after == Connector::Mode::WAITING) {
+      LOG_WARN("WiFi scan timed out, retrying in %lu ms", static_cast<unsigned long>(connector.getWaitMs()));
+    }
+    return cameUp;
+  }
+
+  bool isConnected() const {
+    return connector.isConnected();
+  }
+
+  /// @brief Association attempts, timeouts, time-to-associate histogram and uptime
+  const ConnectionMetrics& getMetrics() const {
+    return connector.getMetrics();
+  }
+
+  const Connector::Stats& getStats() const {
+    return connector.getStats();
+  }
+
+private:
+  EspWifiRadio radio;
+  NvsStorage storage;
+  Connector connector;
 };
 }
 
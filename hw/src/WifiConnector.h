@@ -0,0 +1,243 @@
+#ifndef WIFI_CONNECTOR_H
+#define WIFI_CONNECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "Backoff.h"
+#include "ConnectionMetrics.h"
+
+namespace FindSpot {
+
+/// @brief Access point and lease of the last good association, kept for the next fast reconnect
+struct WifiLink {
+  static const uint8_t VERSION = 1;
+
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t hasLease;  // ip..dns hold the DHCP lease the link had
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+
+  bool operator==(const WifiLink& other) const {
+    return memcmp(this, &other, sizeof(WifiLink)) == 0;
+  }
+};
+
+/**
+ * WiFi association policy: a directed reconnect first, a full scan as fallback.
+ *
+ * After a good association the BSSID and channel (and the lease, if
+ * enabled) are saved, and saved again only when they change. The next attempt, at boot or after the link drops,
+ * goes straight to that access point on that channel, skipping the scan,
+ * and with a reused lease also DHCP. If it does not associate within
+ * `fastTimeoutMs`, the cached link is set aside and full scans follow,
+ * each bounded by `fullTimeoutMs` and spaced by a jittered backoff, until
+ * one succeeds and its link becomes the new cache.
+ *
+ * A drop is noticed either from the status or from the driver's
+ * disconnect events, so even a blip that recovered between two polls
+ * restarts the link cleanly. The listener hears every up/down change, so
+ * the layers above pause and resume instead of failing on their own.
+ *
+ * `Radio` wraps the WiFi driver:
+ *   void beginFull();                                  // scan for the SSID, DHCP
+ *   void beginDirected(const WifiLink& link, bool useLease);
+ *   bool connected();
+ *   uint32_t getDisconnects();                         // Link-loss events seen so far
+ *   void readLink(WifiLink& link);                     // BSSID, channel and lease of the current link
+ *   void disconnect();
+ * `Storage` is the one-blob interface of NvsStorage. Both are supplied by
+ * the caller, so the policy runs on a host against a simulated radio.
+ */
+template <typename Radio, typename Storage>
+class WifiConnector {
+public:
+  enum class Mode : uint8_t {
+    IDLE,
+    FAST,       // Directed to the cached BSSID and channel
+    FULL,       // Scanning for the SSID
+    WAITING,    // Backing off after a failed scan
+    CONNECTED
+  };
+
+  typedef void (*LinkListener)(bool up);
+
+  /// @brief Counters since construction
+  struct Stats {
+    uint32_t fastAttempts;
+    uint32_t fastConnects;
+    uint32_t fullAttempts;
+    uint32_t fullConnects;
+    uint32_t lastAssociationMs;  // From losing the link (or begin()) until it was back
+  };
+
+  WifiConnector(Radio& radio, Storage& storage, uint32_t fastTimeoutMs, uint32_t fullTimeoutMs, bool reuseLease,
+                const Backoff& retryBackoff)
+    : radio(radio), storage(storage), fastTimeoutMs(fastTimeoutMs), fullTimeoutMs(fullTimeoutMs),
+      reuseLease(reuseLease), backoff(retryBackoff) {}
+
+  /// @brief Called with true when the link comes up and false when it goes down
+  void setListener(LinkListener cb) {
+    listener = cb;
+  }
+
+  void begin(uint32_t nowMs) {
+    uint8_t blob[BLOB_SIZE];
+    cacheValid = storage.load(blob, sizeof(blob)) == BLOB_SIZE && blob[0] == WifiLink::VERSION;
+    if (cacheValid) {
+      memcpy(&cached, blob + 1, sizeof(cached));
+      cacheValid = cached.channel >= 1 && cached.channel <= 14;
+    }
+    outageStartMs = nowMs;
+    startAttempt(nowMs);
+  }
+
+  /// @brief Advance the policy; call often
+  /// @return True on the call that sees the link come up
+  bool poll(uint32_t nowMs) {
+    bool up = radio.connected();
+
+    switch (mode) {
+      case Mode::CONNECTED:
+        if (!up || radio.getDisconnects() != disconnects) {
+          metrics.onDisconnected(nowMs);
+          outageStartMs = nowMs;
+          if (up) {
+            radio.disconnect();  // Recovered behind our back; start over from a known state
+          }
+          if (listener) {
+            listener(false);
+          }
+          startAttempt(nowMs);
+        }
+        return false;
+
+      case Mode::WAITING:
+        if (nowMs - waitStartMs >= waitMs) {
+          startAttempt(nowMs);
+        }
+        return false;
+
+      case Mode::FAST:
+      case Mode::FULL:
+        if (up) {
+          onAssociated(nowMs);
+          return true;
+        }
+        if (nowMs - attemptStartMs >= (mode == Mode::FAST ? fastTimeoutMs : fullTimeoutMs)) {
+          metrics.onFailure(ConnectionMetrics::TIMEOUT);
+          radio.disconnect();
+          if (mode == Mode::FAST) {
+            // The access point moved or the lease is gone; scan right away
+            cacheValid = false;
+            startAttempt(nowMs);
+          } else {
+            mode = Mode::WAITING;
+            waitStartMs = nowMs;
+            waitMs = backoff.next();
+          }
+        }
+        return false;
+
+      default:
+        return false;
+    }
+  }
+
+  bool isConnected() const {
+    return mode == Mode::CONNECTED;
+  }
+
+  Mode getMode() const {
+    return mode;
+  }
+
+  /// @brief Delay before the next scan while WAITING
+  uint32_t getWaitMs() const {
+    return waitMs;
+  }
+
+  const Stats& getStats() const {
+    return stats;
+  }
+
+  /// @brief Attempts, timeouts, association-time histogram and uptime
+  const ConnectionMetrics& getMetrics() const {
+    return metrics;
+  }
+
+private:
+  static const size_t BLOB_SIZE = 1 + sizeof(WifiLink);
+
+  Radio& radio;
+  Storage& storage;
+  uint32_t fastTimeoutMs;
+  uint32_t fullTimeoutMs;
+  bool reuseLease;
+  Backoff backoff;
+  LinkListener listener = nullptr;
+  WifiLink cached = {};
+  bool cacheValid = false;
+  Mode mode = Mode::IDLE;
+  uint32_t attemptStartMs = 0;
+  uint32_t outageStartMs = 0;
+  uint32_t waitStartMs = 0;
+  uint32_t waitMs = 0;
+  uint32_t disconnects = 0;
+  Stats stats = {};
+  ConnectionMetrics metrics;
+
+  void startAttempt(uint32_t nowMs) {
+    attemptStartMs = nowMs;
+    metrics.onAttempt(nowMs);
+    if (cacheValid) {
+      mode = Mode::FAST;
+      stats.fastAttempts++;
+      radio.beginDirected(cached, reuseLease && cached.hasLease);
+    } else {
+      mode = Mode::FULL;
+      stats.fullAttempts++;
+      radio.beginFull();
+    }
+  }
+
+  void onAssociated(uint32_t nowMs) {
+    if (mode == Mode::FAST) {
+      stats.fastConnects++;
+    } else {
+      stats.fullConnects++;
+    }
+    stats.lastAssociationMs = nowMs - outageStartMs;
+    metrics.onConnected(nowMs);
+    backoff.reset();
+    disconnects = radio.getDisconnects();
+    mode = Mode::CONNECTED;
+
+    // Rewrite the cache only when the link changed, to spare the flash. An unused
+    // lease is not kept, so a new DHCP address alone does not count as a change.
+    WifiLink link = {};
+    radio.readLink(link);
+    if (!reuseLease) {
+      link.hasLease = 0;
+      link.ip = link.gateway = link.subnet = link.dns = 0;
+    }
+    if (!cacheValid || !(link == cached)) {
+      uint8_t blob[BLOB_SIZE];
+      blob[0] = WifiLink::VERSION;
+      memcpy(blob + 1, &link, sizeof(link));
+      storage.save(blob, sizeof(blob));
+    }
+    cached = link;
+    cacheValid = true;
+
+    if (listener) {
+      listener(true);
+    }
+  }
+};
+}
+
+#endif
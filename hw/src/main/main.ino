@@ -1,13 +1,29 @@
 #include <Arduino.h>
-#include <vector>
+#include <array>
+#include <atomic>
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
+#include <LittleFS.h>
 #include "esp_task_wdt.h"
 #include "../Config.h"
 #include "../WiFiManager.h"
 #include "../DistanceSensor.h"
 #include "../MQTTClient.h"
 #include "../HttpClient.h"
+#include "../ScanScheduler.h"
+#include "../SensorTable.h"
+#include "../OccupancyAggregator.h"
+#include "../FileLog.h"
+#include "../Outbox.h"
+#include "../Backoff.h"
+#include "../CommandDispatcher.h"
+#include "../NvsStorage.h"
+#include "../RuntimeConfig.h"
+#include "../RegistrationCache.h"
+#include "../BootTimeline.h"
+#include "../SpscQueue.h"
+#include "../PinnedTask.h"
+#include "../Log.h"
 #include "time.h"
 
 using namespace FindSpot;
@@ -21,10 +37,70 @@ HttpClient httpClient;
 MQTTClient mqttClient;
 Device esp32device(DEVICE_PREFIX, DEVICE_LOCATION, DEVICE_LATITUDE, DEVICE_LONGITUDE);
 
-std::vector<ISensor*> sensors;
-std::vector<bool> sensorStateVector;
+// One statically allocated sensor per SENSOR_TABLE entry, with the last state handed to the networking task
+std::array<DistanceSensor, SENSOR_COUNT> sensors = makeSensors<DistanceSensor>();
+std::array<bool, SENSOR_COUNT> recordedState = {};
 
-unsigned long lastSensorRead = 0;
+// The sensing task owns the sensors and the scheduler, the networking task everything that talks to
+// the network; transitions go one way and settings changes the other, neither side ever waits
+SpscQueue<SensorUpdate, TRANSITION_QUEUE_CAPACITY> transitions;
+SpscQueue<Settings, 4> settingsUpdates;
+Settings sensingSettings;  // Settings as applied by the sensing task
+uint32_t transitionsDeferred = 0;
+static_assert(TRANSITION_QUEUE_CAPACITY >= SENSOR_COUNT, "Initial states must fit the transition queue");
+
+// Names and pins for the JSON payload, owned by the networking task; a queued SensorUpdate carries the rest
+std::array<DistanceSensor::Label, SENSOR_COUNT> sensorLabels = {};
+
+// Per-sensor transitions waiting to be published; overflow survives reboots on LittleFS
+FileLog outboxLog(OUTBOX_LOG_PATH);
+Outbox<OUTBOX_CAPACITY, FileLog> outbox(outboxLog, OUTBOX_LOG_MAX_BYTES);
+
+// Serialization buffer shared by all sensor publishes, and the format agreed at registration
+uint8_t payloadBuffer[SENSOR_PAYLOAD_SIZE];
+PayloadFormat payloadFormat = PayloadFormat::JSON;
+
+// Device-level occupancy message, used when SENSOR_PUBLISH_MODE includes PUBLISH_AGGREGATED
+OccupancyAggregator<SENSOR_COUNT> aggregator(AGGREGATE_WINDOW_MS);
+static_assert(OccupancyAggregator<SENSOR_COUNT>::MAX_SIZE <= SENSOR_PAYLOAD_SIZE, "SENSOR_PAYLOAD_SIZE too small for the aggregate");
+
+ScanScheduler scanScheduler(SENSOR_GROUP_COUNT, SCAN_SLOT_MS * 1000UL, SENSOR_INTERVAL_MIN_MS * 1000UL);
+
+// Intervals, thresholds and pins, persisted in NVS; Config.h provides the defaults
+typedef RuntimeConfig<NvsStorage> Configuration;
+NvsStorage settingsStorage(CONFIG_NVS_NAMESPACE, CONFIG_NVS_KEY);
+Configuration runtimeConfig(settingsStorage,
+  Settings::make(SENSOR_INTERVAL_MIN_MS, SENSOR_INTERVAL_MAX_MS, DISTANCE_MIN_CM, DISTANCE_MAX_CM, DISTANCE_EXIT_CM),
+  SCAN_SLOT_MS * SENSOR_GROUP_COUNT);
+
+// Registration: the cached one is used at boot, and the backend confirms or replaces it in the background
+enum class Registration : uint8_t {
+  NONE,     // Waiting for WiFi to contact the backend
+  RUNNING,  // registerInBackground task in progress
+  WAITING,  // Backend unreachable, retrying after a backoff delay
+  DONE      // Answer from the backend adopted or confirmed
+};
+NvsStorage registrationStorage(CONFIG_NVS_NAMESPACE, REGISTRATION_NVS_KEY);
+RegistrationCache<NvsStorage> registrationCache(registrationStorage);
+uint32_t registrationToken = 0;
+CachedRegistration activeRegistration = {};
+Registration registrationState = Registration::NONE;
+std::atomic<bool> registrationDone{false};
+RegistrationResponse registrationResult;
+Backoff registerBackoff(REGISTER_RETRY_BASE_MS, REGISTER_RETRY_CAP_MS, esp_random());
+uint32_t registerSinceMs = 0;
+uint32_t registerWaitMs = 0;
+
+// Boot runs as overlapping phases; their timings are reported after the first publish
+BootTimeline bootTimeline;
+bool mqttStarted = false;
+bool bootReported = false;
+uint32_t lastWifiTelemetryMs = 0;
+uint32_t lastOfflineLogMs = 0;
+
+// Inbound commands on device/{id}/cmd/<name>
+CommandDispatcher<COMMAND_JSON_CAPACITY> commands;
+std::atomic<bool> snapshotRequested{false};
 
 // NTP server and timezone settings
 const char* ntpServer = "pool.ntp.org";
@@ -32,248 +108,586 @@ const long  gmtOffset_sec = 7200;      // GMT+2
 const int   daylightOffset_sec = 3600; // Daylight saving
 
 /**
- * MQTT callback for incoming messages (optional - for future features)
+ * Push changed settings into the scheduler and sensors; runs on the sensing task once it is started
  */
-void mqttCallback(char* topic, byte* payload, unsigned int length) {
-  String message;
-  for (unsigned int i = 0; i < length; i++) {
-    message += (char)payload[i];
+void applySettings(const Settings& previous, const Settings& current) {
+  scanScheduler.setPeriodUs(current.sampleMinMs * 1000UL);
+  
+  for (size_t i = 0; i < SENSOR_COUNT; i++) {
+    sensors[i].setSamplingLimits(current.sampleMinMs, current.sampleMaxMs);
+    if (!current.sameThresholds(previous)) {
+      sensors[i].setThresholds(current.minCm, current.enterCm, current.exitCm);
+    }
+    if (!current.samePins(previous, i)) {
+      sensors[i].setPins(current.trigPin[i], current.echoPin[i]);
+    }
   }
   
-  Serial.println("MQTT Message on topic: " + String(topic));
-  Serial.println("Payload: " + message);
+  LOG_INFO("Settings: interval %lu..%lu ms, thresholds min %u, enter %u, exit %u cm",
+           static_cast<unsigned long>(current.sampleMinMs), static_cast<unsigned long>(current.sampleMaxMs),
+           current.minCm, current.enterCm, current.exitCm);
 }
 
-// ==================== Setup ============================ //
-void setup() {
-  Serial.begin(115200);
-  delay(1000);
-  Serial.println("\n\n");
-  Serial.println("╔═══════════════════════════════════════════════╗");
-  Serial.println("║   FindSpot Smart Parking System - ESP32       ║");
-  Serial.println("╚═══════════════════════════════════════════════╝");
+/**
+ * Name each spot after the registered device and take its pins from the settings; runs on the
+ * networking task, which owns both, once the tasks are started
+ */
+void labelSensors() {
+  const Settings& settings = runtimeConfig.get();
+  String deviceName = esp32device.getName();
+  for (size_t i = 0; i < SENSOR_COUNT; i++) {
+    DistanceSensor::Label& label = sensorLabels[i];
+    DistanceSensor::formatName(label.name, sizeof(label.name), SENSOR_TABLE[i].technology, SENSOR_TABLE[i].index,
+                               deviceName.c_str(), esp32device.getId());
+    label.technology = SENSOR_TABLE[i].technology;
+    label.trigPin = settings.trigPin[i];
+    label.echoPin = settings.echoPin[i];
+  }
+}
+
+/**
+ * Hot-reload hook of runtimeConfig: changes come from commands on the networking task,
+ * so they are handed to the sensing task, which owns the sensors
+ */
+void queueSettings(const Settings& previous, const Settings& current) {
+  labelSensors();
+  if (!settingsUpdates.push(current)) {
+    LOG_ERROR("Settings queue full, change saved but applied only after a restart");
+  }
+}
+
+/**
+ * Log the outcome of a settings change
+ * @return False if the change was refused
+ */
+bool reportSettings(const char* origin, Configuration::Result result) {
+  if (result == Configuration::Result::APPLIED || result == Configuration::Result::UNCHANGED) {
+    LOG_INFO("Settings from %s: %s", origin, Configuration::describe(result));
+    return true;
+  }
+  LOG_WARN("Settings from %s rejected: %s", origin, Configuration::describe(result));
+  return false;
+}
+
+/**
+ * cmd/interval {"min_ms": 250, "max_ms": 8000}: adaptive sampling range, min_ms is the scan period
+ */
+bool onIntervalCommand(JsonObjectConst args) {
+  Settings candidate = runtimeConfig.get();
+  candidate.sampleMinMs = args["min_ms"] | candidate.sampleMinMs;
+  candidate.sampleMaxMs = args["max_ms"] | candidate.sampleMaxMs;
+  return reportSettings("cmd/interval", runtimeConfig.set(candidate));
+}
+
+/**
+ * cmd/thresholds {"min_cm": 5, "enter_cm": 50, "exit_cm": 60}: occupancy band, exit_cm >= enter_cm
+ */
+bool onThresholdsCommand(JsonObjectConst args) {
+  Settings candidate = runtimeConfig.get();
+  candidate.minCm = args["min_cm"] | candidate.minCm;
+  candidate.enterCm = args["enter_cm"] | candidate.enterCm;
+  candidate.exitCm = args["exit_cm"] | candidate.exitCm;
+  return reportSettings("cmd/thresholds", runtimeConfig.set(candidate));
+}
+
+/**
+ * cmd/config "enter_cm=45,trig1=14": any settings in the compact key=value form
+ */
+bool onConfigCommand(const uint8_t* payload, size_t length) {
+  return reportSettings("cmd/config", runtimeConfig.apply(reinterpret_cast<const char*>(payload), length));
+}
+
+/**
+ * cmd/snapshot: republish every spot; the sensing task queues their states like transitions
+ */
+bool onSnapshotCommand(JsonObjectConst args) {
+  snapshotRequested.store(true);
+  return true;
+}
+
+/**
+ * MQTT callback for incoming messages; the payload is parsed in place in the receive buffer
+ */
+void mqttCallback(char* topic, byte* payload, unsigned int length) {
+  switch (commands.dispatch(topic, payload, length)) {
+    case CommandDispatcher<COMMAND_JSON_CAPACITY>::Result::HANDLED:
+      LOG_INFO("Command %s done", topic);
+      break;
+    case CommandDispatcher<COMMAND_JSON_CAPACITY>::Result::UNKNOWN:
+      LOG_WARN("Unknown command %s", topic);
+      break;
+    case CommandDispatcher<COMMAND_JSON_CAPACITY>::Result::BAD_PAYLOAD:
+      LOG_WARN("Command %s: payload is not a JSON object", topic);
+      break;
+    case CommandDispatcher<COMMAND_JSON_CAPACITY>::Result::REJECTED:
+      LOG_WARN("Command %s: invalid arguments", topic);
+      break;
+    default:
+      LOG_DEBUG("Ignored message on %s", topic);
+      break;
+  }
+}
+
+/**
+ * Fingerprint of everything a registration depends on; a cached one with another token is ignored
+ */
+uint32_t makeRegistrationToken() {
+  uint32_t token = RegistrationCache<NvsStorage>::fingerprint(esp32device.getMacAddress().c_str());
+  token = RegistrationCache<NvsStorage>::fingerprint(BACKEND_HOST, token);
+  token = RegistrationCache<NvsStorage>::fingerprint(BACKEND_PORT, token);
+  token = RegistrationCache<NvsStorage>::fingerprint(DEVICE_PREFIX, token);
+  return RegistrationCache<NvsStorage>::fingerprint(SENSOR_PAYLOAD_FORMAT, token);
+}
+
+/**
+ * Take over the device ID and broker credentials of a registration, fresh or cached
+ */
+void adoptRegistration(const RegistrationResponse& registration) {
+  esp32device.setId(registration.device_id);
+  payloadFormat = registration.payload_format;
+  registration.toCache(registrationToken, activeRegistration);
+  LOG_INFO("Device registered - ID: %d, payload format: %s",
+           registration.device_id, payloadFormat == PayloadFormat::BINARY ? "binary" : "json");
   
-  // Configure watchdog timer
-  esp_task_wdt_config_t wdt_config = {
-    .timeout_ms = WDT_TIMEOUT * 1000,
-    .idle_core_mask = (1 << portNUM_PROCESSORS) - 1,
-    .trigger_panic = true
-  };
-  esp_task_wdt_init(&wdt_config);
-  esp_task_wdt_add(NULL);
+  mqttClient.setCredentials(
+    registration.mqtt_username,
+    registration.mqtt_password,
+    registration.mqtt_broker,
+    registration.mqtt_port,
+    registration.sensor_topic,
+    registration.device_id
+  );
+  commands.compile(mqttClient.getCommandFilter());
+  labelSensors();
   
-  // Step 1: Connect to WiFi
-  Serial.println("\nConnecting to WiFi...");
-  wifi.connect();
+  // The backend may hand out settings with the registration
+  if (registration.config[0] != '\0') {
+    reportSettings("registration", runtimeConfig.apply(registration.config, strlen(registration.config)));
+  }
+}
+
+void cacheRegistration(const RegistrationResponse& registration) {
+  CachedRegistration entry;
+  if (!registration.toCache(registrationToken, entry) || !registrationCache.save(entry)) {
+    LOG_WARN("Registration not cached, the next boot registers over HTTP");
+  }
+}
+
+/**
+ * Background task: register over HTTP without stalling sampling; checkRegistration() takes the result
+ */
+void registerInBackground(void*) {
+  esp_task_wdt_add(NULL);
+  registrationResult = httpClient.registerDevice(esp32device);
+  esp_task_wdt_delete(NULL);
+  registrationDone.store(true);
+  vTaskDelete(NULL);
+}
+
+void startRegistration() {
+  registrationDone.store(false);
+  registrationState = Registration::RUNNING;
+  if (xTaskCreate(registerInBackground, "register", REGISTER_TASK_STACK, nullptr, 1, nullptr) != pdPASS) {
+    registrationResult.success = false;
+    registrationResult.error_message = "no memory for the task";
+    registrationDone.store(true);
+  }
+}
+
+/**
+ * Register once WiFi is up and retry with jittered backoff; adopt the backend's answer
+ * unless it only confirms the cached registration already in use
+ */
+void checkRegistration() {
+  uint32_t nowMs = millis();
+  bool due = registrationState == Registration::NONE
+    || (registrationState == Registration::WAITING && nowMs - registerSinceMs >= registerWaitMs);
+  if (due && wifi.isConnected()) {
+    startRegistration();
+  }
+  if (registrationState != Registration::RUNNING || !registrationDone.load()) {
+    return;
+  }
   
-  // Check if WiFi connection was successful
-  if (!wifi.isConnected()) {
-    Serial.println("WiFi connection failed!");
-    Serial.println("Restarting in 10 seconds...");
-    delay(10000);
-    ESP.restart();
+  bool usingCached = esp32device.getId() > 0;
+  if (!registrationResult.success) {
+    registrationState = Registration::WAITING;
+    registerSinceMs = nowMs;
+    registerWaitMs = registerBackoff.next();
+    LOG_ERROR("Device registration failed: %s.%s Retrying in %lu ms (attempt %lu)...",
+              registrationResult.error_message.c_str(), usingCached ? " Staying on the cached one." : "",
+              static_cast<unsigned long>(registerWaitMs), static_cast<unsigned long>(registerBackoff.getAttempt()));
     return;
   }
   
-  Serial.println("WiFi Connected");
+  registrationState = Registration::DONE;
+  CachedRegistration fresh;
+  if (usingCached && registrationResult.toCache(registrationToken, fresh) && fresh == activeRegistration) {
+    LOG_INFO("Cached registration confirmed by the backend");
+    return;
+  }
   
-  // Step 2: Synchronize time with NTP server
-  configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
-  struct tm timeinfo;
-  int attempts = 0;
-  while (!getLocalTime(&timeinfo) && attempts < 20) {
-    delay(500);
-    attempts++;
+  cacheRegistration(registrationResult);
+  adoptRegistration(registrationResult);
+  bootTimeline.finish(BootTimeline::REGISTRATION, nowMs);
+  if (usingCached) {
+    LOG_WARN("Registration changed on the backend, reconnecting with the new one");
+    mqttClient.restart();
   }
-  if (getLocalTime(&timeinfo)) {
-    Serial.println("Time synchronized");
+}
+
+/**
+ * The broker refused the credentials, which may be stale ones from the cache: forget them and
+ * register over HTTP again. The backend's answer is then adopted and cached even if it is unchanged
+ */
+void onCredentialsRejected(uint32_t nowMs) {
+  LOG_WARN("MQTT credentials rejected by the broker, dropping the cached registration");
+  if (!registrationCache.clear()) {
+    LOG_WARN("Could not clear the cached registration");
+  }
+  activeRegistration = {};
+  if (registrationState == Registration::RUNNING) {
+    return;  // The answer in flight is adopted as a new registration
   }
+  // Backed off, so a backend handing out the same refused credentials is not hammered
+  registrationState = Registration::WAITING;
+  registerSinceMs = nowMs;
+  registerWaitMs = registerBackoff.next();
+}
+
+/**
+ * WiFi went up or down: MQTT holds its attempts while the link is gone and reconnects as soon
+ * as it is back, and a registration waiting out a failure from the outage is retried at once
+ */
+void onWifiLink(bool up) {
+  if (!up) {
+    mqttClient.onNetworkDown();
+    return;
+  }
+  mqttClient.onNetworkUp();
+  if (registrationState == Registration::WAITING) {
+    registerBackoff.reset();
+    registerWaitMs = 0;
+  }
+}
+
+/**
+ * Start each boot phase as soon as what it depends on is ready; sampling runs throughout
+ */
+void advanceBoot() {
+  uint32_t nowMs = millis();
   
-  // Reset watchdog before HTTP request
-  esp_task_wdt_reset();
+  if (wifi.poll()) {
+    bootTimeline.finish(BootTimeline::WIFI, nowMs);
+    if (!bootTimeline.isStarted(BootTimeline::CLOCK)) {
+      // SNTP syncs in the background; transitions before that carry timestamp 0
+      configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
+      bootTimeline.start(BootTimeline::CLOCK, nowMs);
+    }
+  }
   
-  // Step 3: Register device via HTTP and get MQTT credentials
-  Serial.println("\nRegistering device with backend...");
-  RegistrationResponse regResponse = httpClient.registerDevice(esp32device);
+  if (bootTimeline.isStarted(BootTimeline::CLOCK) && !bootTimeline.isFinished(BootTimeline::CLOCK)
+      && time(nullptr) > CLOCK_VALID_AFTER) {
+    bootTimeline.finish(BootTimeline::CLOCK, nowMs);
+    LOG_INFO("Time synchronized");
+  }
   
-  // Reset watchdog after HTTP request
-  esp_task_wdt_reset();
+  checkRegistration();
   
-  if (!regResponse.success) {
-    Serial.println("Device registration failed: " + regResponse.error_message);
-    Serial.println("Restarting in 10 seconds...");
-    delay(10000);
-    ESP.restart();
-    return;
+  if (!mqttStarted && esp32device.getId() > 0 && wifi.isConnected()) {
+    mqttStarted = true;
+    bootTimeline.start(BootTimeline::MQTT, nowMs);
+    mqttClient.connect();  // A failed start is retried by loop() with backoff
+  }
+  if (mqttClient.isConnected()) {
+    bootTimeline.finish(BootTimeline::MQTT, nowMs);
+  }
+  if (mqttClient.takeCredentialsRejected()) {
+    onCredentialsRejected(nowMs);
+  }
+}
+
+/**
+ * Log the boot timings once and publish them on the telemetry topic
+ */
+void reportBoot() {
+  char json[MQTT_TELEMETRY_SIZE];
+  size_t length = bootTimeline.toJson(json, sizeof(json));
+  LOG_INFO("Boot timing: %s", length > 0 ? json : "(too long)");
+  if (length > 0) {
+    mqttClient.publishReport(json, length);
+  }
+  bootReported = true;
+}
+
+/**
+ * Serialize a recorded transition into payloadBuffer in the agreed payload format
+ * @return Payload length, 0 on failure
+ */
+size_t encodeSensor(const DistanceSensor::Label& label, const SensorUpdate& update) {
+  if (payloadFormat == PayloadFormat::BINARY) {
+    return PayloadCodec::encode(update, payloadBuffer, sizeof(payloadBuffer));
+  }
+  return DistanceSensor::toJson(label, update, reinterpret_cast<char*>(payloadBuffer), sizeof(payloadBuffer));
+}
+
+/**
+ * Hand the current state of sensor `i` to the networking task
+ * @return False if the queue is full; the caller offers it again on a later pass
+ */
+bool recordTransition(size_t i) {
+  if (!transitions.push(sensors[i].getUpdate())) {
+    transitionsDeferred++;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Take the transitions queued by the sensing task into every enabled publish mode
+ */
+void collectTransitions() {
+  SensorUpdate update;
+  while (transitions.pop(update)) {
+    if (SENSOR_PUBLISH_MODE & PUBLISH_AGGREGATED) {
+      aggregator.record(update, millis());
+    }
+    
+    if ((SENSOR_PUBLISH_MODE & PUBLISH_PER_SENSOR) && !outbox.push(update)) {
+      LOG_WARN("Outbox full, dropped transition of sensor %u", static_cast<unsigned>(update.index));
+    }
+  }
+}
+
+/**
+ * Publish queued transitions in order; stops at the first failure so nothing is reordered
+ */
+void drainOutbox() {
+  SensorUpdate update;
+  for (uint8_t sent = 0; sent < OUTBOX_DRAIN_BATCH && outbox.peek(update); sent++) {
+    if (update.index >= SENSOR_COUNT) {
+      outbox.pop();
+      continue;
+    }
+    
+    size_t length = encodeSensor(sensorLabels[update.index], update);
+    if (length == 0) {
+      LOG_ERROR("Sensor %u: no payload, dropping transition", update.index);
+    } else if (!mqttClient.publishSensorData(update.index, payloadBuffer, length)) {
+      return; // Retried on the next pass
+    } else {
+      LOG_INFO("Sensor %u now %s", update.index, update.occupied ? "occupied" : "free");
+      bootTimeline.finish(BootTimeline::FIRST_PUBLISH, millis());
+    }
+    outbox.pop();
+  }
+}
+
+// ==================== Tasks ============================ //
+
+/**
+ * One pass of the sensing task: fire the due crosstalk group and hand every state change to the
+ * networking task; network stalls never hold this up
+ */
+void senseStep() {
+  Settings next;
+  while (settingsUpdates.pop(next)) {
+    applySettings(sensingSettings, next);
+    sensingSettings = next;
   }
   
-  // Set device ID
-  esp32device.setId(regResponse.device_id);
-  Serial.println("Device registered - ID: " + String(regResponse.device_id));
-  
-  // Step 4: Connect to MQTT broker
-  Serial.println("\nConnecting to MQTT broker...");
-  mqttClient.setCredentials(
-    regResponse.mqtt_username,
-    regResponse.mqtt_password,
-    regResponse.mqtt_broker,
-    regResponse.mqtt_port,
-    regResponse.sensor_topic,
-    regResponse.device_id
-  );
-  mqttClient.setCallback(mqttCallback);
+  // Fire the crosstalk group whose slot has come up; echoes are collected below
+  int group = scanScheduler.poll(micros());
+  if (group != ScanScheduler::NO_GROUP) {
+    // Report the achieved scan rate roughly every 5 seconds
+    uint32_t scansPerReport = 5000 / sensingSettings.sampleMinMs;
+    if (group == 0 && scanScheduler.getScanCount() % (scansPerReport ? scansPerReport : 1) == 0) {
+      LOG_INFO("Scan %lu: %.2f Hz, free heap %u, %lu transitions deferred",
+               static_cast<unsigned long>(scanScheduler.getScanCount()), scanScheduler.getScanRateHz(),
+               static_cast<unsigned>(ESP.getFreeHeap()), static_cast<unsigned long>(transitionsDeferred));
+    }
+
+    for (DistanceSensor& sensor : sensors) {
+      if (sensor.getGroup() == group) {
+        sensor.triggerIfDue();
+      }
+    }
+  }
   
-  // Reset watchdog before MQTT connection attempt
-  esp_task_wdt_reset();
+  // Check each sensor for state changes (returns immediately if no new echo).
+  // A change the queue has no room for stays unrecorded and is offered again next pass.
+  for (size_t i = 0; i < SENSOR_COUNT; i++) {
+    bool currentState = sensors[i].checkState();
+    
+    if (currentState != recordedState[i] && recordTransition(i)) {
+      recordedState[i] = currentState;
+    }
+  }
   
-  if (!mqttClient.connect()) {
-    Serial.println("Failed to connect to MQTT broker!");
-    Serial.println("Restarting in 10 seconds...");
-    delay(10000);
-    ESP.restart();
-    return;
+  // Requested by cmd/snapshot; queued like transitions so it survives a dropped link
+  if (snapshotRequested.exchange(false)) {
+    for (size_t i = 0; i < SENSOR_COUNT; i++) {
+      if (!recordTransition(i)) {
+        snapshotRequested.store(true);  // Started over once the queue has room
+        break;
+      }
+    }
   }
+}
+
+/**
+ * One pass of the networking task: connections, queued transitions and every publish
+ */
+void networkStep() {
+  // WiFi, clock, registration and MQTT, each started when its inputs are ready
+  advanceBoot();
   
-  // Wait for MQTT connection to stabilize
-  unsigned long startWait = millis();
-  while (!mqttClient.isConnected() && (millis() - startWait < 10000)) {
+  // Maintain MQTT connection
+  if (mqttStarted) {
     mqttClient.loop();
-    delay(100);
-    esp_task_wdt_reset(); // Reset watchdog during connection wait
   }
   
+  // Sampling continues while offline; transitions wait in the outbox
+  collectTransitions();
+  
+  uint32_t nowMs = millis();
   if (!mqttClient.isConnected()) {
-    Serial.println("MQTT connection timeout!");
-    Serial.println("Restarting in 10 seconds...");
-    delay(10000);
-    ESP.restart();
+    if (!outbox.isEmpty() && nowMs - lastOfflineLogMs >= 5000) {
+      LOG_WARN("MQTT not connected, %u transitions queued in RAM", static_cast<unsigned>(outbox.getRamCount()));
+      lastOfflineLogMs = nowMs;
+    }
     return;
   }
   
-  Serial.println("MQTT Connected");
+  drainOutbox();
+  
+  // One message for every change within the coalescing window
+  if ((SENSOR_PUBLISH_MODE & PUBLISH_AGGREGATED) && aggregator.isDue(millis())) {
+    size_t length = aggregator.encode(payloadBuffer, sizeof(payloadBuffer));
+    if (length > 0 && mqttClient.publishOccupancy(payloadBuffer, length)) {
+      aggregator.markPublished();
+      bootTimeline.finish(BootTimeline::FIRST_PUBLISH, millis());
+    }
+  }
   
-  // Step 5: Initialize sensors
-  Serial.println("\nInitializing sensors...");
-  int sensor_id = 0;
+  if (!bootReported && bootTimeline.isFinished(BootTimeline::FIRST_PUBLISH)) {
+    reportBoot();
+  }
   
-  // Setup ultrasonic sensors (each represents a parking spot)
-  sensors.push_back(new DistanceSensor(esp32device, "ultrasonic", sensor_id++, 22, 23));
-  sensors.push_back(new DistanceSensor(esp32device, "ultrasonic", sensor_id++, 14, 12));
-  sensors.push_back(new DistanceSensor(esp32device, "ultrasonic", sensor_id++, 33, 32));
+  // Association counts and times of the WiFi link, next to the broker link's own telemetry
+  if (millis() - lastWifiTelemetryMs >= MQTT_TELEMETRY_INTERVAL_MS) {
+    char json[MQTT_TELEMETRY_SIZE];
+    size_t length = wifi.getMetrics().toJson("wifi", 0, millis(), json, sizeof(json));
+    if (length > 0) {
+      mqttClient.publishReport(json, length);
+    }
+    lastWifiTelemetryMs = millis();
+  }
+}
 
-  for (auto& sensor : sensors) {
-    sensor->begin();
+PinnedTask senseTask("sense", senseStep, SENSE_TASK_PERIOD_MS);
+PinnedTask networkTask("network", networkStep, NETWORK_TASK_PERIOD_MS);
+
+// ==================== Setup ============================ //
+void setup() {
+  Serial.begin(115200);
+  Log::begin();
+  Serial.println("\n\n");
+  Serial.println("╔═══════════════════════════════════════════════╗");
+  Serial.println("║   FindSpot Smart Parking System - ESP32       ║");
+  Serial.println("╚═══════════════════════════════════════════════╝");
+  
+  // Configure watchdog timer
+  esp_task_wdt_config_t wdt_config = {
+    .timeout_ms = WDT_TIMEOUT * 1000,
+    .idle_core_mask = (1 << portNUM_PROCESSORS) - 1,
+    .trigger_panic = true
+  };
+  esp_task_wdt_init(&wdt_config);
+  esp_task_wdt_add(NULL);
+  
+  // Mount flash for the outbox; without it transitions are only queued in RAM
+  if (!LittleFS.begin(true)) {
+    LOG_WARN("LittleFS mount failed, outbox limited to RAM");
   }
   
-  Serial.println("Initialized " + String(sensors.size()) + " sensors");
+  // Load tuned settings before the sensors start; invalid or missing ones fall back to Config.h
+  settingsStorage.begin();
+  Configuration::Source settingsSource = runtimeConfig.begin();
+  LOG_INFO("Settings loaded from %s", settingsSource == Configuration::Source::STORED ? "NVS"
+           : settingsSource == Configuration::Source::MIGRATED ? "NVS (older version or sensor table, partly)" : "defaults");
+  applySettings(runtimeConfig.getDefaults(), runtimeConfig.get());
+  sensingSettings = runtimeConfig.get();
+  runtimeConfig.setListener(queueSettings);
+  
+  // Step 1: Start WiFi; it associates while the sensors come up, and the networking task takes it from there
+  bootTimeline.start(BootTimeline::WIFI, millis());
+  wifi.setListener(onWifiLink);
+  wifi.begin();
   
-  // Initialize state tracking vector
-  sensorStateVector.resize(sensors.size(), false);
+  // Step 2: Initialize sensors
+  bootTimeline.start(BootTimeline::SENSORS, millis());
+  for (DistanceSensor& sensor : sensors) {
+    sensor.begin();
+  }
+  
+  LOG_INFO("Initialized %u sensors in %u crosstalk groups",
+           static_cast<unsigned>(SENSOR_COUNT), static_cast<unsigned>(SENSOR_GROUP_COUNT));
   
-  // Publish initial sensor states
-  delay(1000);
-  for (size_t i = 0; i < sensors.size(); i++) {
-    if (sensors[i] && mqttClient.isConnected()) {
-      bool initialState = sensors[i]->checkState();
-      sensorStateVector[i] = initialState;
-      
-      String payload = sensors[i]->toJson();
-      if (payload.length() > 0) {
-        mqttClient.publishSensorData(i, payload);
-        delay(200);
+  // Take one measurement per sensor, group by group, so initial states are real readings
+  for (uint8_t group = 0; group < SENSOR_GROUP_COUNT; group++) {
+    for (DistanceSensor& sensor : sensors) {
+      if (sensor.getGroup() == group) {
+        sensor.trigger();
       }
     }
+    delay(SCAN_SLOT_MS);
+  }
+
+  // Record initial sensor states behind anything replayed from flash; they are published once connected
+  for (size_t i = 0; i < SENSOR_COUNT; i++) {
+    recordedState[i] = sensors[i].checkState();
+    recordTransition(i);
   }
+  collectTransitions();
+  bootTimeline.finish(BootTimeline::SENSORS, millis());
+  
+  // Step 3: Reuse the cached registration so MQTT can start as soon as WiFi is up;
+  // checkRegistration() confirms it, or registers from scratch, in the background
+  bootTimeline.start(BootTimeline::REGISTRATION, millis());
+  registrationStorage.begin();
+  registrationToken = makeRegistrationToken();
+  CachedRegistration cached;
+  if (registrationCache.load(registrationToken, cached)) {
+    LOG_INFO("Using cached registration, revalidating in the background");
+    adoptRegistration(RegistrationResponse::fromCache(cached));
+    bootTimeline.finish(BootTimeline::REGISTRATION, millis());
+  }
+  
+  // Step 4: Commands arrive once MQTT connects
+  commands.on("interval", onIntervalCommand);
+  commands.on("thresholds", onThresholdsCommand);
+  commands.onRaw("config", onConfigCommand);
+  commands.on("snapshot", onSnapshotCommand);
+  mqttClient.setCallback(mqttCallback);
+  
+  // Step 5: Sampling and networking each get a core; the setup task bows out in loop()
+  if (!senseTask.start(SENSE_TASK_CORE, SENSE_TASK_STACK, SENSE_TASK_PRIORITY)
+      || !networkTask.start(NETWORK_TASK_CORE, NETWORK_TASK_STACK, NETWORK_TASK_PRIORITY)) {
+    LOG_ERROR("Not enough memory for the tasks, restarting");
+    delay(1000);
+    ESP.restart();
+  }
+  esp_task_wdt_delete(NULL);
   
   Serial.println("\n");
   Serial.println("╔═══════════════════════════════════════════════╗");
-  Serial.println("║          System Ready - Starting Loop         ║");
+  Serial.println("║        System Ready - Tasks Running           ║");
   Serial.println("╚═══════════════════════════════════════════════╝\n");
 }
 
 // ==================== Main Loop ============================ //
 void loop() {
-  // Reset watchdog timer
-  esp_task_wdt_reset();
-  
-  // Maintain MQTT connection
-  mqttClient.loop();
-  
-  // Check if device is registered
-  if (esp32device.getId() <= 0) {
-    Serial.println("X Device not registered, waiting...");
-    delay(1000);
-    return;
-  }
-  
-  unsigned long currentMillis = millis();
-  
-  // Read sensors periodically
-  if (currentMillis - lastSensorRead >= SENSOR_READ_INTERVAL) {
-    lastSensorRead = currentMillis;
-    
-    Serial.println("\nReading sensors...");
-    Serial.println(ESP.getFreeHeap());
-    yield(); // Allow background tasks
-    
-    // Ensure MQTT is connected before reading sensors
-    if (!mqttClient.isConnected()) {
-      Serial.println("X MQTT not connected, skipping sensor read");
-      return;
-    }
-    
-    // Check each sensor for state changes
-    for (size_t i = 0; i < sensors.size(); i++) {
-      // Safety check: ensure sensor pointer is valid
-      if (!sensors[i]) {
-        Serial.print("ERROR: Null sensor at index ");
-        Serial.println(i);
-        continue;
-      }
-      
-      // Safety check: ensure index is within bounds
-      if (i >= sensorStateVector.size()) {
-        Serial.print("ERROR: Index out of bounds ");
-        Serial.println(i);
-        continue;
-      }
-      
-      delay(50);
-      yield();
-      
-      bool currentState = sensors[i]->checkState();
-      
-      // Only publish if state changed
-      if (currentState != sensorStateVector[i]) {
-        Serial.print("    State changed! Publishing...");
-        
-        yield();
-        
-        String payload = "";
-        if (sensors[i]) {
-          payload = sensors[i]->toJson();
-        }
-        
-        if (payload.length() > 0 && mqttClient.isConnected()) {
-          delay(100);
-          yield();
-          
-          if (mqttClient.publishSensorData(i, payload)) {
-            sensorStateVector[i] = currentState;
-            Serial.println("  Published");
-          } else {
-            Serial.println("  Failed");
-          }
-        } else {
-          Serial.println(" X No payload or disconnected");
-        }
-        
-        // Force free the payload string
-        payload = String();
-      }
-      
-      // Yield after each sensor
-      yield();
-    }
-  }
+  // Everything runs in senseTask and networkTask
+  vTaskDelete(NULL);
 }
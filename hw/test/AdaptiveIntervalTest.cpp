@@ -0,0 +1,92 @@
+#include "AdaptiveInterval.h"
+#include "OccupancyFilter.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+// Scans until tick() next asks for a sample
+static uint32_t scansToNextSample(AdaptiveInterval& interval) {
+  uint32_t scans = 1;
+  while (!interval.tick()) {
+    scans++;
+  }
+  return scans;
+}
+
+// Stable samples double the interval up to the ceiling
+static void backsOffWhileStable() {
+  AdaptiveInterval interval(250, 8000);
+  CHECK_EQ(interval.getIntervalMs(), 250);
+  CHECK_EQ(scansToNextSample(interval), 1);
+
+  const uint32_t expectedMs[] = {500, 1000, 2000, 4000, 8000, 8000};
+  for (uint32_t ms : expectedMs) {
+    interval.onSample(false);
+    CHECK_EQ(interval.getIntervalMs(), ms);
+    CHECK_EQ(scansToNextSample(interval), ms / 250);
+  }
+}
+
+// A ceiling that is not a power-of-two multiple is still reached, not overshot
+static void clampsToCeiling() {
+  AdaptiveInterval interval(250, 3000);
+  for (int i = 0; i < 10; i++) {
+    interval.onSample(false);
+  }
+  CHECK_EQ(interval.getIntervalMs(), 3000);
+}
+
+// Any sign of change drops straight back to the floor
+static void transitionReturnsToFloor() {
+  AdaptiveInterval interval(250, 8000);
+  for (int i = 0; i < 5; i++) {
+    interval.onSample(false);
+  }
+  CHECK_EQ(interval.getIntervalMs(), 8000);
+  interval.onSample(true);
+  CHECK_EQ(interval.getIntervalMs(), 250);
+  CHECK_EQ(scansToNextSample(interval), 1);
+}
+
+static void limitsAndReset() {
+  AdaptiveInterval interval(250, 8000);
+  interval.onSample(false);
+  interval.onSample(false);
+  interval.reset();
+  CHECK_EQ(interval.getIntervalMs(), 250);
+
+  // Ceiling below the floor: sample every scan
+  interval.setLimits(500, 100);
+  interval.onSample(false);
+  CHECK_EQ(interval.getIntervalMs(), 500);
+
+  // A zero floor must not divide by zero
+  interval.setLimits(0, 8000);
+  interval.onSample(false);
+  CHECK_EQ(interval.getIntervalMs(), 0);
+  CHECK(interval.tick());
+}
+
+// The filter reports a disagreeing sample before the median moves
+static void filterFlagsTransitions() {
+  OccupancyFilter<5> filter(5, 50, 60, 1000);
+  CHECK(!filter.update(200, 0));
+  filter.update(200, 100);
+  CHECK(!filter.isTransitioning());
+
+  filter.update(30, 200);  // One close sample: the median is still 200
+  CHECK(filter.isTransitioning());
+  CHECK(!filter.isSettling());
+
+  filter.update(200, 300);
+  CHECK(!filter.isTransitioning());
+}
+
+int main() {
+  backsOffWhileStable();
+  clampsToCeiling();
+  transitionReturnsToFloor();
+  limitsAndReset();
+  filterFlagsTransitions();
+  return Check::result();
+}
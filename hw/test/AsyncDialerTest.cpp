@@ -0,0 +1,244 @@
+#include <chrono>
+#include <thread>
+#include "AsyncDialer.h"
+#include "Backoff.h"
+#include "Config.h"
+#include "MqttSession.h"
+#include "SpscQueue.h"
+#include "FakeTransport.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+// Stands in for ip_addr_t
+struct Address {
+  uint32_t ip;
+};
+
+typedef DnsHandoff<Address> Dns;
+
+static const Address FIRST = {0x0A000001};
+static const Address SECOND = {0x0A000002};
+
+// The answer of an aborted lookup does not complete the next one
+static void lateAnswerIsDropped() {
+  Dns dns;
+  Address address = {};
+  Dns::Ticket* first = dns.begin();
+  Dns::Ticket* second = dns.begin();  // First attempt timed out; retried
+  CHECK(first && second && first != second);
+  CHECK(dns.poll(address) == Dns::PENDING);
+
+  Dns::deliver(first, &FIRST);
+  CHECK(dns.poll(address) == Dns::PENDING);
+  Dns::deliver(second, &SECOND);
+  CHECK(dns.poll(address) == Dns::RESOLVED);
+  CHECK_EQ(address.ip, SECOND.ip);
+}
+
+// ... nor fails it, nor overwrites it once it resolved
+static void lateFailureIsDropped() {
+  Dns dns;
+  Address address = {};
+  Dns::Ticket* first = dns.begin();
+  Dns::Ticket* second = dns.begin();
+  Dns::deliver(first, nullptr);
+  CHECK(dns.poll(address) == Dns::PENDING);
+
+  Dns::Ticket* third = dns.begin();
+  Dns::deliver(third, &SECOND);
+  Dns::deliver(second, &FIRST);
+  CHECK(dns.poll(address) == Dns::RESOLVED);
+  CHECK_EQ(address.ip, SECOND.ip);
+
+  // A failure of the current lookup is reported
+  Dns::Ticket* fourth = dns.begin();
+  Dns::deliver(fourth, nullptr);
+  CHECK(dns.poll(address) == Dns::FAILED);
+  CHECK_EQ(dns.getGeneration(), 4);
+}
+
+// A ticket is reused only once its answer came; lwIP always answers eventually
+static void ticketsRunOut() {
+  Dns dns;
+  Dns::Ticket* out[4];
+  for (Dns::Ticket*& ticket : out) {
+    ticket = dns.begin();
+    CHECK(ticket != nullptr);
+  }
+  CHECK(dns.begin() == nullptr);
+  CHECK_EQ(dns.getGeneration(), 4);
+
+  Dns::deliver(out[1], &FIRST);
+  Dns::Ticket* again = dns.begin();
+  CHECK(again == out[1]);
+  Address address = {};
+  CHECK(dns.poll(address) == Dns::PENDING);
+  Dns::deliver(again, &SECOND);
+  CHECK(dns.poll(address) == Dns::RESOLVED);
+  CHECK_EQ(address.ip, SECOND.ip);
+}
+
+// A resolver thread answering every lookup late while the poller keeps retrying:
+// whatever resolves carries the current generation's address
+static void threadedInterleaving() {
+  static Dns dns;
+  static SpscQueue<Dns::Ticket*, 8> lookups;
+  std::atomic<bool> done{false};
+
+  std::thread resolver([&]() {
+    Dns::Ticket* ticket;
+    while (!done.load() || !lookups.isEmpty()) {
+      if (!lookups.pop(ticket)) {
+        std::this_thread::yield();
+        continue;
+      }
+      Address answer = {ticket->generation};
+      Dns::deliver(ticket, ticket->generation % 5 == 0 ? nullptr : &answer);
+    }
+  });
+
+  uint32_t resolved = 0;
+  uint32_t failed = 0;
+  uint32_t wrong = 0;
+  for (int attempt = 0; attempt < 20000; attempt++) {
+    Dns::Ticket* ticket = dns.begin();
+    if (!ticket) {
+      std::this_thread::yield();
+      continue;
+    }
+    uint32_t generation = dns.getGeneration();
+    lookups.push(ticket);
+    // Give up after a varying number of polls, as a timeout would
+    for (int i = 0; i < (attempt % 4) * 100; i++) {
+      Address address = {};
+      Dns::State state = dns.poll(address);
+      if (state == Dns::RESOLVED) {
+        resolved++;
+        wrong += address.ip != generation;
+        break;
+      }
+      if (state == Dns::FAILED) {
+        failed++;
+        wrong += generation % 5 != 0;
+        break;
+      }
+      std::this_thread::yield();
+    }
+  }
+  done.store(true);
+  resolver.join();
+
+  CHECK_EQ(wrong, 0);
+  CHECK(resolved > 0);
+  printf("interleaved: %lu resolved, %lu failed, the rest superseded\n",
+         static_cast<unsigned long>(resolved), static_cast<unsigned long>(failed));
+}
+
+// Connect attempts against a broker whose name never resolves, then one that accepts
+// TCP but never answers CONNECT, the way MQTTClient drives them from the networking
+// step. Sensing runs every simulated millisecond; the networking step must return at
+// once every time, and attempts must be spaced by the phase timeout and the backoff.
+namespace Cadence {
+
+typedef MqttSession<FakeTransport, MQTT_INFLIGHT_WINDOW, MQTT_PACKET_SIZE> Session;
+
+enum class Phase { WAITING, RESOLVING, AWAIT_CONNACK };
+
+struct Client {
+  Dns dns;
+  FakeTransport transport;
+  Session session{transport, MQTT_RETRY_MS, MQTT_CONNECT_TIMEOUT_MS};
+  Backoff backoff{MQTT_RECONNECT_BASE_MS, MQTT_RECONNECT_CAP_MS, 7};
+  bool resolves = false;  // The DNS answer comes 20 ms after the lookup
+  Dns::Ticket* lookup = nullptr;
+  uint32_t lookupAtMs = 0;
+  Phase phase = Phase::WAITING;
+  uint32_t phaseStartMs = 0;
+  uint32_t waitMs = 0;
+  uint32_t attempts = 0;
+  uint32_t failures = 0;
+
+  void fail(uint32_t nowMs) {
+    failures++;
+    phase = Phase::WAITING;
+    phaseStartMs = nowMs;
+    waitMs = backoff.next();
+  }
+
+  void step(uint32_t nowMs) {
+    if (lookup && resolves && nowMs - lookupAtMs >= 20) {
+      Address answer = FIRST;
+      Dns::deliver(lookup, &answer);
+      lookup = nullptr;
+    }
+
+    Address address;
+    switch (phase) {
+      case Phase::WAITING:
+        if (nowMs - phaseStartMs >= waitMs) {
+          attempts++;
+          lookup = dns.begin();
+          lookupAtMs = nowMs;
+          phase = Phase::RESOLVING;
+          phaseStartMs = nowMs;
+        }
+        break;
+
+      case Phase::RESOLVING:
+        if (dns.poll(address) == Dns::RESOLVED) {
+          transport.open = true;
+          session.beginSession("client", "user", "pass", MQTT_KEEPALIVE_S, nullptr, nowMs);
+          phase = Phase::AWAIT_CONNACK;
+        } else if (nowMs - phaseStartMs > MQTT_CONNECT_TIMEOUT_MS) {
+          fail(nowMs);  // The lookup stays out; its ticket is not reused until it answers
+        }
+        break;
+
+      case Phase::AWAIT_CONNACK:
+        session.loop(nowMs);
+        if (session.getState() == Session::State::DISCONNECTED) {
+          fail(nowMs);
+        }
+        break;
+    }
+  }
+};
+}
+
+static void unresponsiveBrokerKeepsCadence() {
+  Cadence::Client client;
+  uint32_t sensePasses = 0;
+  uint32_t slowestStepUs = 0;
+  const uint32_t RUN_MS = 120000;
+
+  for (uint32_t nowMs = 0; nowMs < RUN_MS; nowMs++) {
+    sensePasses++;
+    client.resolves = nowMs >= RUN_MS / 2;
+
+    auto start = std::chrono::steady_clock::now();
+    client.step(nowMs);
+    uint32_t tookUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    slowestStepUs = tookUs > slowestStepUs ? tookUs : slowestStepUs;
+  }
+
+  CHECK_EQ(sensePasses, RUN_MS);
+  CHECK(slowestStepUs < 5000);  // Far below one sensing period would be a blocking wait
+  CHECK(client.attempts >= 2);
+  CHECK(client.failures + 1 >= client.attempts);
+  // Each failed attempt costs the phase timeout plus at least the backoff base
+  CHECK(client.attempts <= RUN_MS / (MQTT_CONNECT_TIMEOUT_MS + MQTT_RECONNECT_BASE_MS) + 1);
+  CHECK(client.session.getState() != Cadence::Session::State::CONNECTED);
+  printf("unresponsive broker: %lu attempts in %lu s, slowest networking step %lu us\n",
+         static_cast<unsigned long>(client.attempts), static_cast<unsigned long>(RUN_MS / 1000),
+         static_cast<unsigned long>(slowestStepUs));
+}
+
+int main() {
+  lateAnswerIsDropped();
+  lateFailureIsDropped();
+  ticketsRunOut();
+  threadedInterleaving();
+  unresponsiveBrokerKeepsCadence();
+  return Check::result();
+}
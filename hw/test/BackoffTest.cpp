@@ -0,0 +1,129 @@
+#include "Backoff.h"
+#include "Config.h"
+#include "ConnectionMetrics.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+// Every delay stays in [base, min(cap, 3 * previous)]
+static void delaysStayInBounds() {
+  for (uint32_t seed = 0; seed < 200; seed++) {
+    Backoff backoff(2000, 60000, seed);
+    uint32_t previous = 2000;
+    for (int attempt = 1; attempt <= 50; attempt++) {
+      uint32_t delay = backoff.next();
+      uint32_t upper = previous * 3 < 60000 ? previous * 3 : 60000;
+      if (delay < 2000 || delay > upper) {
+        CHECK_EQ(delay, upper);
+        return;
+      }
+      CHECK_EQ(backoff.getAttempt(), attempt);
+      previous = delay;
+    }
+  }
+}
+
+// Within 32 attempts nearly every device backs off to half the cap, and differently seeded ones drift apart
+static void growsAndSpreads() {
+  uint32_t reachedHalfCap = 0;
+  uint32_t distinctFirst = 0;
+  uint32_t lastFirst = 0;
+  for (uint32_t seed = 1; seed <= 100; seed++) {
+    Backoff backoff(2000, 60000, seed * 2654435761UL);
+    uint32_t first = backoff.next();
+    distinctFirst += first != lastFirst;
+    lastFirst = first;
+    uint32_t longest = first;
+    for (int attempt = 0; attempt < 31; attempt++) {
+      uint32_t delay = backoff.next();
+      longest = delay > longest ? delay : longest;
+    }
+    reachedHalfCap += longest >= 30000;
+  }
+  CHECK(reachedHalfCap >= 95);
+  CHECK(distinctFirst >= 90);
+}
+
+static void resetAndEdgeCases() {
+  Backoff backoff(1000, 30000, 42);
+  for (int i = 0; i < 10; i++) {
+    backoff.next();
+  }
+  backoff.reset();
+  CHECK_EQ(backoff.getAttempt(), 0);
+  CHECK(backoff.next() <= 3000);
+
+  // Same seed, same sequence: host runs are reproducible
+  Backoff a(1000, 30000, 7);
+  Backoff b(1000, 30000, 7);
+  for (int i = 0; i < 10; i++) {
+    CHECK_EQ(a.next(), b.next());
+  }
+
+  // No room for jitter: always the base
+  Backoff fixed(5000, 5000, 3);
+  for (int i = 0; i < 5; i++) {
+    CHECK_EQ(fixed.next(), 5000);
+  }
+}
+
+static void metricsCountByCause() {
+  ConnectionMetrics metrics;
+  metrics.onAttempt(0);
+  metrics.onFailure(ConnectionMetrics::DNS);
+  metrics.onAttempt(100);
+  metrics.onRefused(5);
+  metrics.onAttempt(200);
+  metrics.onRefused(9);  // Unknown code: counted as a generic refusal
+  metrics.onAttempt(1000);
+  metrics.onConnected(1300);  // 300 ms: the 500 bucket
+  CHECK_EQ(metrics.getAttempts(), 4);
+  CHECK_EQ(metrics.getFailures(), 3);
+
+  char json[MQTT_TELEMETRY_SIZE];
+  CHECK(metrics.toJson("mqtt", 0, 2000, json, sizeof(json)) > 0);
+  CHECK(strstr(json, "\"fail_dns\":1") != nullptr);
+  CHECK(strstr(json, "\"fail_rc1\":1") != nullptr);
+  CHECK(strstr(json, "\"fail_rc5\":1") != nullptr);
+  CHECK(strstr(json, "\"connect_250\":0,\"connect_500\":1") != nullptr);
+  // Up from 1300 to 2000 of 2000 ms
+  CHECK(strstr(json, "\"uptime_permille\":350") != nullptr);
+
+  metrics.onDisconnected(2500);
+  CHECK_EQ(metrics.uptimePermille(0, 5000), 240);
+}
+
+// Every counter at its maximum still fits the telemetry buffer
+static void worstCaseFitsTelemetry() {
+  ConnectionMetrics metrics;
+  for (uint32_t i = 0; i < 3; i++) {
+    metrics.onAttempt(0);
+    metrics.onConnected(UINT32_MAX);  // Open-ended bucket
+  }
+  char json[MQTT_TELEMETRY_SIZE];
+  size_t length = metrics.toJson("wifi", 0, 1, json, sizeof(json));
+  CHECK(length > 0);
+
+  // The serializer refuses rather than truncates, so a 10-digit value everywhere must fit too
+  char wide[2 * MQTT_TELEMETRY_SIZE];
+  JsonWriter writer(wide, sizeof(wide));
+  writer.beginObject().field("link", "wifi");
+  const char* keys[] = {"attempts", "connects", "fail_dns", "fail_tcp", "fail_timeout", "fail_rc1", "fail_rc2",
+                        "fail_rc3", "fail_rc4", "fail_rc5", "connect_250", "connect_500", "connect_1000",
+                        "connect_2000", "connect_5000", "connect_10000", "connect_inf"};
+  for (const char* key : keys) {
+    writer.field(key, static_cast<unsigned long>(UINT32_MAX));
+  }
+  writer.field("uptime_permille", 1000).endObject();
+  CHECK(writer.ok());
+  CHECK(writer.length() < MQTT_TELEMETRY_SIZE);
+}
+
+int main() {
+  delaysStayInBounds();
+  growsAndSpreads();
+  resetAndEdgeCases();
+  metricsCountByCause();
+  worstCaseFitsTelemetry();
+  return Check::result();
+}
@@ -0,0 +1,95 @@
+#include <string.h>
+#include "BootTimeline.h"
+#include "Config.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+// The first start and the first finish stick; a finish alone starts the phase too
+static void firstMarkWins() {
+  BootTimeline timeline;
+  CHECK(!timeline.isStarted(BootTimeline::WIFI));
+  CHECK_EQ(timeline.getDurationMs(BootTimeline::WIFI), 0);
+
+  timeline.start(BootTimeline::WIFI, 100);
+  timeline.start(BootTimeline::WIFI, 900);  // A reconnect later on
+  CHECK(timeline.isStarted(BootTimeline::WIFI));
+  CHECK(!timeline.isFinished(BootTimeline::WIFI));
+  CHECK_EQ(timeline.getDurationMs(BootTimeline::WIFI), 0);
+
+  timeline.finish(BootTimeline::WIFI, 1600);
+  timeline.finish(BootTimeline::WIFI, 5000);
+  CHECK(timeline.isFinished(BootTimeline::WIFI));
+  CHECK_EQ(timeline.getDurationMs(BootTimeline::WIFI), 1500);
+
+  timeline.finish(BootTimeline::REGISTRATION, 40);  // From the cache, no request
+  CHECK(timeline.isStarted(BootTimeline::REGISTRATION));
+  CHECK_EQ(timeline.getDurationMs(BootTimeline::REGISTRATION), 0);
+  CHECK(!timeline.isStarted(BootTimeline::MQTT));
+}
+
+// A boot as setup() and loop() mark it: overlapping phases, reported in phase order
+static void reportsOverlappingBoot() {
+  BootTimeline timeline;
+  timeline.start(BootTimeline::WIFI, 12);
+  timeline.start(BootTimeline::SENSORS, 15);
+  timeline.finish(BootTimeline::SENSORS, 180);
+  timeline.start(BootTimeline::REGISTRATION, 181);
+  timeline.finish(BootTimeline::WIFI, 950);
+  timeline.start(BootTimeline::CLOCK, 950);
+  timeline.finish(BootTimeline::REGISTRATION, 1310);
+  timeline.start(BootTimeline::MQTT, 1310);
+  timeline.finish(BootTimeline::MQTT, 1420);
+  timeline.finish(BootTimeline::FIRST_PUBLISH, 1425);
+
+  char json[MQTT_TELEMETRY_SIZE];
+  size_t length = timeline.toJson(json, sizeof(json));
+  CHECK_EQ(length, strlen(json));
+  // The clock has not synced yet, so it is left out
+  CHECK_STR(json, "{\"report\":\"boot\",\"sensors_ms\":165,\"sensors_at_ms\":180,\"wifi_ms\":938,\"wifi_at_ms\":950,"
+                  "\"registration_ms\":1129,\"registration_at_ms\":1310,\"mqtt_ms\":110,\"mqtt_at_ms\":1420,"
+                  "\"first_publish_ms\":0,\"first_publish_at_ms\":1425}");
+
+  BootTimeline empty;
+  CHECK(empty.toJson(json, sizeof(json)) > 0);
+  CHECK_STR(json, "{\"report\":\"boot\"}");
+}
+
+// millis() wrapping during a phase still gives its true length
+static void durationAcrossWrap() {
+  BootTimeline timeline;
+  timeline.start(BootTimeline::MQTT, UINT32_MAX - 99);
+  timeline.finish(BootTimeline::MQTT, 200);
+  CHECK_EQ(timeline.getDurationMs(BootTimeline::MQTT), 300);
+}
+
+// Every phase with 10-digit times fits the report buffer; a short buffer yields nothing
+static void worstCaseFitsReport() {
+  BootTimeline timeline;
+  for (uint8_t i = 0; i < BootTimeline::PHASE_COUNT; i++) {
+    timeline.start(static_cast<BootTimeline::Phase>(i), 0);
+    timeline.finish(static_cast<BootTimeline::Phase>(i), UINT32_MAX);
+  }
+  char json[MQTT_TELEMETRY_SIZE];
+  size_t length = timeline.toJson(json, sizeof(json));
+  CHECK(length > 0);
+  CHECK(length < sizeof(json));
+
+  CHECK_EQ(timeline.toJson(json, length), 0);  // No room for the terminator
+  CHECK_EQ(timeline.toJson(json, length + 1), length);
+}
+
+static void namesPhases() {
+  CHECK_STR(BootTimeline::name(BootTimeline::SENSORS), "sensors");
+  CHECK_STR(BootTimeline::name(BootTimeline::FIRST_PUBLISH), "first_publish");
+  CHECK_STR(BootTimeline::name(BootTimeline::PHASE_COUNT), "unknown");
+}
+
+int main() {
+  firstMarkWins();
+  reportsOverlappingBoot();
+  durationAcrossWrap();
+  worstCaseFitsReport();
+  namesPhases();
+  return Check::result();
+}
@@ -0,0 +1,67 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Minimal assertions for the host tests.
+ *
+ * A failed check prints where it failed and the test carries on, so one run
+ * reports every broken case. main() ends with `return Check::result();`,
+ * which ctest sees as a failure if any check failed.
+ */
+namespace Check {
+
+inline int& failures() {
+  static int count = 0;
+  return count;
+}
+
+inline void fail(const char* file, int line, const char* expression) {
+  printf("%s:%d: CHECK failed: %s\n", file, line, expression);
+  failures()++;
+}
+
+inline void failEqual(const char* file, int line, const char* actual, const char* expected,
+                      long long actualValue, long long expectedValue) {
+  printf("%s:%d: CHECK_EQ failed: %s == %s (%lld vs %lld)\n", file, line, actual, expected, actualValue, expectedValue);
+  failures()++;
+}
+
+inline void failText(const char* file, int line, const char* actual, const char* actualValue, const char* expectedValue) {
+  printf("%s:%d: CHECK_STR failed: %s is \"%s\", expected \"%s\"\n", file, line, actual, actualValue, expectedValue);
+  failures()++;
+}
+
+/// @return Process exit code: 0 if every check passed
+inline int result() {
+  if (failures() > 0) {
+    printf("%d check(s) failed\n", failures());
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
+}
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) ::Check::fail(__FILE__, __LINE__, #condition); \
+  } while (0)
+
+// Integer comparison; both sides are printed on failure
+#define CHECK_EQ(actual, expected) \
+  do { \
+    long long actual_ = static_cast<long long>(actual); \
+    long long expected_ = static_cast<long long>(expected); \
+    if (actual_ != expected_) ::Check::failEqual(__FILE__, __LINE__, #actual, #expected, actual_, expected_); \
+  } while (0)
+
+#define CHECK_STR(actual, expected) \
+  do { \
+    const char* actual_ = (actual); \
+    if (strcmp(actual_, (expected)) != 0) ::Check::failText(__FILE__, __LINE__, #actual, actual_, (expected)); \
+  } while (0)
+
+#endif
@@ -0,0 +1,62 @@
+#include "DistanceConversion.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+// Longest echo the capture reports before it times out (ECHO_TIMEOUT_US)
+static const uint32_t MAX_PULSE_US = 30000;
+
+// The fixed 340 m/s scale reproduces the old floating-point centimetres exactly
+static void matchesFloatPath() {
+  for (uint32_t pulseUs = 1; pulseUs <= MAX_PULSE_US; pulseUs++) {
+    long floatCm = pulseUs * 0.034 / 2;
+    long fixedCm = DistanceConversion::pulseToMm(pulseUs, DistanceConversion::FIXED_SPEED_SCALE) / 10;
+    if (floatCm != fixedCm) {
+      CHECK_EQ(fixedCm, floatCm);
+      return;
+    }
+  }
+}
+
+// ... and the exact millimetres, 0.17 mm per microsecond
+static void fixedScaleIsExact() {
+  for (uint32_t pulseUs = 0; pulseUs <= MAX_PULSE_US; pulseUs++) {
+    uint32_t mm = DistanceConversion::pulseToMm(pulseUs, DistanceConversion::FIXED_SPEED_SCALE);
+    if (mm != pulseUs * 17 / 100) {
+      CHECK_EQ(mm, pulseUs * 17 / 100);
+      return;
+    }
+  }
+}
+
+// Compensated scales are rounded up: never short, at most 1 mm long
+static void compensatedScaleWithinOneMm() {
+  for (int32_t deciCelsius = -400; deciCelsius <= 500; deciCelsius += 5) {
+    int32_t speedDmps = DistanceConversion::speedOfSoundDmps(deciCelsius);
+    uint32_t scale = DistanceConversion::scaleForTemperature(deciCelsius);
+    for (uint32_t pulseUs = 1; pulseUs <= MAX_PULSE_US; pulseUs++) {
+      uint64_t exact = static_cast<uint64_t>(pulseUs) * speedDmps / 20000;
+      uint32_t mm = DistanceConversion::pulseToMm(pulseUs, scale);
+      if (mm < exact || mm > exact + 1) {
+        CHECK_EQ(mm, exact);
+        return;
+      }
+    }
+  }
+}
+
+static void speedOfSound() {
+  CHECK_EQ(DistanceConversion::speedOfSoundDmps(0), 3313);
+  CHECK_EQ(DistanceConversion::speedOfSoundDmps(200), 3434);
+  CHECK_EQ(DistanceConversion::speedOfSoundDmps(-200), 3192);
+  // 2 m at 20 C: 11647 us round trip
+  CHECK_EQ(DistanceConversion::pulseToMm(11647, DistanceConversion::scaleForTemperature(200)), 1999);
+}
+
+int main() {
+  matchesFloatPath();
+  fixedScaleIsExact();
+  compensatedScaleWithinOneMm();
+  speedOfSound();
+  return Check::result();
+}
@@ -0,0 +1,134 @@
+#include "EchoCapture.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+// Echo of 1160 us: 20 cm at 340 m/s
+static void riseThenFall() {
+  EchoCapture capture;
+  uint32_t pulseUs = 12345;
+  CHECK(capture.isIdle());
+  CHECK(!capture.poll(0, pulseUs));
+
+  CHECK(capture.arm(1000));
+  CHECK(!capture.isIdle());
+  CHECK(!capture.poll(1100, pulseUs));
+  capture.onEdge(true, 1400);
+  CHECK(!capture.poll(1500, pulseUs));
+  capture.onEdge(false, 2560);
+
+  CHECK(capture.poll(2600, pulseUs));
+  CHECK_EQ(pulseUs, 1160);
+  CHECK(capture.isIdle());
+  CHECK(!capture.poll(2700, pulseUs));  // Reported once
+}
+
+// Edges of the wrong level, or with nothing armed, are ignored
+static void ignoresStrayEdges() {
+  EchoCapture capture;
+  uint32_t pulseUs = 0;
+  capture.onEdge(true, 100);
+  capture.onEdge(false, 200);
+  CHECK(capture.isIdle());
+  CHECK(!capture.poll(300, pulseUs));
+
+  CHECK(capture.arm(1000));
+  capture.onEdge(false, 1100);  // Line still settling low
+  capture.onEdge(true, 1200);
+  capture.onEdge(true, 1300);   // Bounce: the first rise counts
+  capture.onEdge(false, 1700);
+  capture.onEdge(false, 1800);
+  CHECK(capture.poll(1900, pulseUs));
+  CHECK_EQ(pulseUs, 500);
+}
+
+// No echo, or one that never falls: reported as 0 once the timeout passes
+static void timesOut() {
+  EchoCapture capture;
+  uint32_t pulseUs = 12345;
+  CHECK(capture.arm(1000));
+  CHECK(!capture.poll(1000 + ECHO_TIMEOUT_US, pulseUs));
+  CHECK(capture.poll(1001 + ECHO_TIMEOUT_US, pulseUs));
+  CHECK_EQ(pulseUs, 0);
+  CHECK(capture.isIdle());
+
+  CHECK(capture.arm(50000));
+  capture.onEdge(true, 50200);
+  CHECK(!capture.poll(50000 + ECHO_TIMEOUT_US, pulseUs));
+  CHECK(capture.poll(50001 + ECHO_TIMEOUT_US, pulseUs));
+  CHECK_EQ(pulseUs, 0);
+
+  // A late fall of the abandoned echo does not complete anything
+  capture.onEdge(false, 90000);
+  CHECK(!capture.poll(90100, pulseUs));
+}
+
+// The micros() counter wraps every ~71 minutes; widths and timeouts survive it
+static void acrossTimerWrap() {
+  EchoCapture capture;
+  uint32_t pulseUs = 0;
+  CHECK(capture.arm(UINT32_MAX - 500));
+  capture.onEdge(true, UINT32_MAX - 200);
+  capture.onEdge(false, 800);
+  CHECK(capture.poll(900, pulseUs));
+  CHECK_EQ(pulseUs, 1001);
+
+  CHECK(capture.arm(UINT32_MAX - 500));
+  CHECK(!capture.poll(1000, pulseUs));
+  CHECK(capture.poll(ECHO_TIMEOUT_US, pulseUs));
+  CHECK_EQ(pulseUs, 0);
+}
+
+// Arming again mid-measurement is refused and leaves that measurement's timing alone
+static void armWhileBusy() {
+  EchoCapture capture;
+  uint32_t pulseUs = 12345;
+  CHECK(capture.arm(1000));
+  CHECK(!capture.arm(20000));
+  CHECK(!capture.poll(1000 + ECHO_TIMEOUT_US, pulseUs));
+  CHECK(capture.poll(1001 + ECHO_TIMEOUT_US, pulseUs));  // Timed from 1000, not 20000
+  CHECK_EQ(pulseUs, 0);
+
+  CHECK(capture.arm(100000));
+  capture.onEdge(true, 100300);
+  CHECK(!capture.arm(110000));
+  CHECK(!capture.poll(100000 + ECHO_TIMEOUT_US, pulseUs));
+  CHECK(capture.poll(100001 + ECHO_TIMEOUT_US, pulseUs));
+  CHECK_EQ(pulseUs, 0);
+
+  // A finished but uncollected width is not lost to a new arm() either
+  CHECK(capture.arm(200000));
+  capture.onEdge(true, 200300);
+  capture.onEdge(false, 201300);
+  CHECK(!capture.arm(201400));
+  CHECK(capture.poll(201500, pulseUs));
+  CHECK_EQ(pulseUs, 1000);
+}
+
+// reset() abandons a measurement; the next arm() starts fresh
+static void resetAbandons() {
+  EchoCapture capture;
+  uint32_t pulseUs = 0;
+  CHECK(capture.arm(1000));
+  capture.onEdge(true, 1200);
+  capture.reset();
+  CHECK(capture.isIdle());
+  capture.onEdge(false, 1500);
+  CHECK(!capture.poll(1600, pulseUs));
+
+  CHECK(capture.arm(2000));
+  capture.onEdge(true, 2100);
+  capture.onEdge(false, 2400);
+  CHECK(capture.poll(2500, pulseUs));
+  CHECK_EQ(pulseUs, 300);
+}
+
+int main() {
+  riseThenFall();
+  ignoresStrayEdges();
+  timesOut();
+  acrossTimerWrap();
+  armWhileBusy();
+  resetAbandons();
+  return Check::result();
+}
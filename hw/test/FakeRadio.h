@@ -0,0 +1,79 @@
+#ifndef FAKE_RADIO_H
+#define FAKE_RADIO_H
+
+#include <stdint.h>
+#include <string.h>
+#include "WifiConnector.h"
+
+/**
+ * Stand-in for the WiFi driver, the Radio of WifiConnector, with one
+ * access point. A scan finds it wherever it is; a directed attempt
+ * associates only if it names the right BSSID and channel. Neither
+ * succeeds while the access point is out of range. Time is `nowMs`,
+ * advanced by the test.
+ */
+struct FakeRadio {
+  static constexpr uint32_t SCAN_MS = 2500;     // Scan, associate and DHCP
+  static constexpr uint32_t DIRECTED_MS = 150;  // Straight to a known access point
+
+  uint32_t nowMs = 0;
+  bool inRange = true;
+  uint8_t bssid[6] = {0x24, 0x0a, 0xc4, 0x01, 0x02, 0x03};
+  uint8_t channel = 6;
+  uint32_t ip = 0x0A00002A;
+
+  uint32_t upAtMs = UINT32_MAX;
+  bool up = false;
+  uint32_t disconnectEvents = 0;
+  int fullBegins = 0;
+  int directedBegins = 0;
+  bool lastUsedLease = false;
+
+  void beginFull() {
+    fullBegins++;
+    up = false;
+    upAtMs = inRange ? nowMs + SCAN_MS : UINT32_MAX;
+  }
+
+  void beginDirected(const FindSpot::WifiLink& link, bool useLease) {
+    directedBegins++;
+    lastUsedLease = useLease;
+    up = false;
+    bool found = inRange && link.channel == channel && memcmp(link.bssid, bssid, sizeof(bssid)) == 0;
+    upAtMs = found ? nowMs + DIRECTED_MS : UINT32_MAX;
+  }
+
+  bool connected() {
+    if (!up && nowMs >= upAtMs) {
+      up = true;
+    }
+    return up;
+  }
+
+  uint32_t getDisconnects() {
+    return disconnectEvents;
+  }
+
+  void readLink(FindSpot::WifiLink& link) {
+    memcpy(link.bssid, bssid, sizeof(bssid));
+    link.channel = channel;
+    link.hasLease = 1;
+    link.ip = ip;
+    link.gateway = 0x0A000001;
+    link.subnet = 0xFFFFFF00;
+    link.dns = 0x0A000001;
+  }
+
+  void disconnect() {
+    up = false;
+    upAtMs = UINT32_MAX;
+  }
+
+  /// @brief The access point drops the link
+  void dropLink() {
+    disconnect();
+    disconnectEvents++;
+  }
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef FAKE_TRANSPORT_H
+#define FAKE_TRANSPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "MqttPacket.h"
+
+/**
+ * In-memory stand-in for WiFiClient, the Transport of MqttSession.
+ *
+ * Bytes queued with receive() are what the broker sends; sent() decodes
+ * everything the session wrote since the last call into packets.
+ */
+class FakeTransport {
+public:
+  struct Packet {
+    uint8_t type;
+    uint8_t flags;
+    std::vector<uint8_t> body;
+  };
+
+  bool open = true;
+  bool failWrites = false;
+  size_t writes = 0;  // Accepted write() calls, one TCP segment each with Nagle off
+
+  int available() {
+    return static_cast<int>(inbound.size() - readPos);
+  }
+
+  int read(uint8_t* buf, size_t size) {
+    size_t n = 0;
+    while (n < size && readPos < inbound.size()) {
+      buf[n++] = inbound[readPos++];
+    }
+    return static_cast<int>(n);
+  }
+
+  size_t write(const uint8_t* buf, size_t size) {
+    if (!open || failWrites) {
+      return 0;
+    }
+    written.insert(written.end(), buf, buf + size);
+    writes++;
+    return size;
+  }
+
+  uint8_t connected() {
+    return open;
+  }
+
+  void stop() {
+    open = false;
+  }
+
+  void receive(const std::vector<uint8_t>& bytes) {
+    inbound.insert(inbound.end(), bytes.begin(), bytes.end());
+  }
+
+  std::vector<Packet> sent() {
+    std::vector<Packet> packets;
+    FindSpot::MqttPacket::Reader<1024> reader;
+    for (uint8_t byte : written) {
+      if (reader.feed(byte)) {
+        packets.push_back({reader.type(), reader.flags(),
+                           std::vector<uint8_t>(reader.body(), reader.body() + reader.length())});
+      }
+    }
+    written.clear();
+    return packets;
+  }
+
+private:
+  std::vector<uint8_t> inbound;
+  size_t readPos = 0;
+  std::vector<uint8_t> written;
+};
+
+// Broker packets
+inline std::vector<uint8_t> connack(uint8_t code) {
+  return {FindSpot::MqttPacket::CONNACK << 4, 2, 0, code};
+}
+
+inline std::vector<uint8_t> puback(uint16_t packetId) {
+  return {FindSpot::MqttPacket::PUBACK << 4, 2, static_cast<uint8_t>(packetId >> 8), static_cast<uint8_t>(packetId)};
+}
+
+/// @brief Packet identifier of a sent QoS 1 PUBLISH
+inline uint16_t publishId(const FakeTransport::Packet& packet) {
+  size_t topicLength = FindSpot::MqttPacket::getU16(packet.body.data());
+  return FindSpot::MqttPacket::getU16(packet.body.data() + 2 + topicLength);
+}
+
+#endif
@@ -0,0 +1,168 @@
+#include "HttpBodyReader.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+// Stream over a fixed string; the end of the string is the connection closing
+struct StringSource {
+  const char* data;
+  size_t length;
+  size_t position = 0;
+
+  explicit StringSource(const char* text) : data(text), length(strlen(text)) {}
+
+  size_t readBytes(char* buf, size_t count) {
+    size_t n = 0;
+    while (n < count && position < length) {
+      buf[n++] = data[position++];
+    }
+    return n;
+  }
+};
+
+typedef HttpBodyReader<StringSource> Reader;
+
+// Whole body as text, read the way ArduinoJson does: byte by byte
+static const char* body(Reader& reader) {
+  static char text[128];
+  size_t n = 0;
+  int c;
+  while (n < sizeof(text) - 1 && (c = reader.read()) >= 0) {
+    text[n++] = static_cast<char>(c);
+  }
+  text[n] = '\0';
+  return text;
+}
+
+static void decodesChunks() {
+  StringSource source("4\r\nWiki\r\n5\r\npedia\r\n0\r\n\r\n");
+  Reader reader(source, true, -1);
+  CHECK_STR(body(reader), "Wikipedia");
+  CHECK(!reader.failed());
+  CHECK_EQ(reader.getConsumed(), 9);
+  CHECK_EQ(reader.read(), -1);  // Stays at the end
+}
+
+// Upper- and lower-case hex; a one-byte chunk
+static void hexSizes() {
+  StringSource source("A\r\n0123456789\r\nf\r\nabcdefghijklmno\r\n1\r\n!\r\n0\r\n\r\n");
+  Reader reader(source, true, -1);
+  CHECK_STR(body(reader), "0123456789abcdefghijklmno!");
+  CHECK(!reader.failed());
+}
+
+static void ignoresExtensionsAndTrailers() {
+  StringSource source("4;name=value\r\nWiki\r\n5 ; x\r\npedia\r\n0;last\r\nExpires: never\r\n\r\n");
+  Reader reader(source, true, -1);
+  CHECK_STR(body(reader), "Wikipedia");
+  CHECK(!reader.failed());
+}
+
+// Some servers end the lines with a bare LF
+static void toleratesBareLf() {
+  StringSource source("4\nWiki\n5\npedia\n0\n\n");
+  Reader reader(source, true, -1);
+  CHECK_STR(body(reader), "Wikipedia");
+  CHECK(!reader.failed());
+}
+
+// readBytes() fills across chunk boundaries and stops short at the end
+static void readBytesSpansChunks() {
+  StringSource source("2\r\nab\r\n3\r\ncde\r\n0\r\n\r\n");
+  Reader reader(source, true, -1);
+  char buf[8] = {};
+  CHECK_EQ(reader.readBytes(buf, 4), 4);
+  CHECK(memcmp(buf, "abcd", 4) == 0);
+  CHECK_EQ(reader.readBytes(buf, 8), 1);
+  CHECK_EQ(buf[0], 'e');
+  CHECK_EQ(reader.readBytes(buf, 8), 0);
+  CHECK(!reader.failed());
+}
+
+// Bad framing ends the body and is reported, not passed on as data
+static void rejectsMalformedFraming() {
+  const char* malformed[] = {
+    "\r\nWiki\r\n0\r\n\r\n",          // No size
+    "g\r\nWiki\r\n0\r\n\r\n",         // Not hex
+    "-4\r\nWiki\r\n0\r\n\r\n",
+    "4\r\nWikiX\r\n0\r\n\r\n",        // Chunk longer than its size
+    "4\r\nWiki\rX0\r\n\r\n",          // CR without LF
+    "10000000\r\n",                   // Larger than MAX_CHUNK
+    "4\r\nWi",                        // Cut off inside a chunk
+    "4\r\nWiki\r\n",                  // Cut off before the last chunk
+    "",
+  };
+  for (const char* text : malformed) {
+    StringSource source(text);
+    Reader reader(source, true, -1);
+    body(reader);
+    if (!reader.failed()) {
+      printf("accepted \"%s\"\n", text);
+      CHECK(false);
+    }
+    CHECK_EQ(reader.read(), -1);
+  }
+
+  // What arrived before the error is still delivered
+  StringSource source("4\r\nWiki\r\nzz\r\n");
+  Reader reader(source, true, -1);
+  CHECK_STR(body(reader), "Wiki");
+  CHECK(reader.failed());
+}
+
+// The largest allowed size parses; the body is then simply cut short
+static void largestChunkSize() {
+  StringSource source("FFFFFFF\r\nabc");
+  Reader reader(source, true, -1);
+  CHECK_STR(body(reader), "abc");
+  CHECK(reader.failed());
+}
+
+static void contentLength() {
+  StringSource source("hello world");
+  Reader reader(source, false, 5);
+  CHECK_STR(body(reader), "hello");
+  CHECK(!reader.failed());
+  CHECK_EQ(reader.getConsumed(), 5);
+  CHECK_EQ(source.position, 5);  // Nothing beyond the body is read
+
+  StringSource empty("ignored");
+  Reader none(empty, false, 0);
+  CHECK_EQ(none.read(), -1);
+  CHECK(!none.failed());
+
+  // Chunk-size lines are body bytes when the response is not chunked
+  StringSource raw("4\r\nWiki");
+  Reader identity(raw, false, 7);
+  CHECK_STR(body(identity), "4\r\nWiki");
+}
+
+static void shortContentLengthFails() {
+  StringSource source("hello");
+  Reader reader(source, false, 20);
+  CHECK_STR(body(reader), "hello");
+  CHECK(reader.failed());
+}
+
+// Without a length the body runs until the connection closes
+static void untilClose() {
+  StringSource source("hello world");
+  Reader reader(source, false, -1);
+  CHECK_STR(body(reader), "hello world");
+  CHECK(!reader.failed());
+  CHECK_EQ(reader.read(), -1);
+}
+
+int main() {
+  decodesChunks();
+  hexSizes();
+  ignoresExtensionsAndTrailers();
+  toleratesBareLf();
+  readBytesSpansChunks();
+  rejectsMalformedFraming();
+  largestChunkSize();
+  contentLength();
+  shortContentLengthFails();
+  untilClose();
+  return Check::result();
+}
@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <vector>
+#include "MqttPacket.h"
+#include "MqttSession.h"
+#include "TopicFilter.h"
+#include "RuntimeConfig.h"
+#include "Check.h"
+#include "FakeTransport.h"
+#include "MemoryStorage.h"
+
+using namespace FindSpot;
+
+/**
+ * Everything a broker or a backend can send reaches the firmware through
+ * a few parsers. These feed them seeded random input: garbage, valid
+ * messages cut short at every byte, messages with flipped bits and
+ * lengths that claim more than is there. Each input sits in a buffer of
+ * exactly its own size, so a read past the end shows up under
+ * -fsanitize=address; without it, the checks still catch results that
+ * point outside the input or settings that went invalid.
+ */
+
+/// @brief xorshift32, so every run replays the same inputs
+struct Random {
+  uint32_t state;
+
+  explicit Random(uint32_t seed) : state(seed) {}
+
+  uint32_t next() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  uint32_t below(uint32_t n) {
+    return next() % n;
+  }
+
+  uint8_t byte() {
+    return static_cast<uint8_t>(next());
+  }
+};
+
+/// @brief One of: random bytes, a truncated copy of `valid`, or `valid` with a few bytes changed
+static std::vector<uint8_t> mutate(Random& random, const std::vector<uint8_t>& valid, size_t maxGarbage) {
+  std::vector<uint8_t> input;
+  switch (random.below(3)) {
+    case 0:
+      input.resize(random.below(maxGarbage + 1));
+      for (uint8_t& b : input) {
+        b = random.byte();
+      }
+      break;
+    case 1:
+      input.assign(valid.begin(), valid.begin() + random.below(valid.size() + 1));
+      break;
+    default:
+      input = valid;
+      for (uint32_t n = 1 + random.below(4); n > 0 && !input.empty(); n--) {
+        input[random.below(input.size())] = random.byte();
+      }
+      break;
+  }
+  return input;
+}
+
+static std::vector<uint8_t> publishPacket(const char* topic, const char* payload, uint8_t qos) {
+  uint8_t packet[256];
+  size_t n = MqttPacket::publish(packet, sizeof(packet), topic, reinterpret_cast<const uint8_t*>(payload),
+                                 strlen(payload), qos, false, 0x0102);
+  return std::vector<uint8_t>(packet, packet + n);
+}
+
+// Any PUBLISH body either fails to parse or yields a topic and payload inside it
+static void parsePublishBodies() {
+  Random random(1);
+  std::vector<uint8_t> valid = publishPacket("device/7/cmd/interval", "{\"min_ms\":500}", 1);
+  valid.erase(valid.begin(), valid.begin() + 2);  // Body only
+
+  uint32_t parsed = 0;
+  for (int i = 0; i < 200000; i++) {
+    std::vector<uint8_t> input = mutate(random, valid, 64);
+    std::vector<uint8_t> body(input);  // Parsed in place, so keep the original
+    MqttPacket::Publish message;
+    uint8_t flags = random.below(16);
+    if (!MqttPacket::parsePublish(flags, body.data(), body.size(), message)) {
+      continue;
+    }
+    parsed++;
+    const uint8_t* begin = body.data();
+    const uint8_t* end = begin + body.size();
+    size_t topicLength = strlen(message.topic);
+    CHECK(reinterpret_cast<uint8_t*>(message.topic) == begin);
+    CHECK(topicLength + 2 <= body.size());
+    CHECK(message.payload >= begin && message.payload <= end);
+    CHECK_EQ(message.length, end - message.payload);
+    CHECK(message.qos == ((flags >> 1) & 0x03));
+  }
+  CHECK(parsed > 0);
+}
+
+// A byte stream of any shape never makes the reader write past its buffer or report more than it holds
+static void readerResynchronizes() {
+  Random random(2);
+  MqttPacket::Reader<64> reader;
+  std::vector<uint8_t> valid = publishPacket("a/b", "payload", 0);
+  uint32_t packets = 0;
+
+  for (int i = 0; i < 100000; i++) {
+    std::vector<uint8_t> chunk = mutate(random, valid, 300);
+    for (uint8_t b : chunk) {
+      if (reader.feed(b)) {
+        packets++;
+        CHECK(reader.length() <= 64);
+      }
+    }
+  }
+  CHECK(packets > 0);
+
+  // After garbage, a valid packet still comes through once the stream is back in step
+  reader.reset();
+  uint32_t seen = 0;
+  for (uint8_t b : valid) {
+    seen += reader.feed(b);
+  }
+  CHECK_EQ(seen, 1);
+  CHECK_EQ(reader.length(), valid.size() - 2);
+}
+
+static TopicFilter commandFilter;
+static uint32_t delivered = 0;
+static uint32_t routed = 0;
+static uint32_t payloadSum = 0;
+
+static void onMessage(char* topic, uint8_t* payload, unsigned int length) {
+  delivered++;
+  const char* tail;
+  if (commandFilter.match(topic, &tail)) {
+    routed++;
+    CHECK(tail >= topic && tail <= topic + strlen(topic));
+  }
+  // Touch every payload byte; a bad length would read out of bounds
+  for (unsigned int i = 0; i < length; i++) {
+    payloadSum += payload[i];
+  }
+}
+
+// The session path a broker message takes: reassembly, PUBLISH parsing, topic routing. Most
+// packets are framed correctly around a damaged body; raw garbage loses the framing for good,
+// so the connection is then closed and made again, as a broker would.
+static void sessionSurvivesGarbage() {
+  Random random(3);
+  CHECK(commandFilter.compile("device/7/cmd/#"));
+  FakeTransport transport;
+  MqttSession<FakeTransport, 4, 128> session(transport, 5000, 5000);
+  session.setCallback(onMessage);
+  std::vector<uint8_t> valid = publishPacket("device/7/cmd/snapshot", "{}", 1);
+  valid.erase(valid.begin(), valid.begin() + 2);
+  uint32_t connects = 0;
+
+  for (uint32_t nowMs = 0; nowMs < 200000; nowMs += 10) {
+    if (session.getState() == MqttSession<FakeTransport, 4, 128>::State::DISCONNECTED) {
+      transport = FakeTransport();
+      session.beginSession("client", "user", "pass", 60, nullptr, nowMs);
+      transport.receive(connack(0));
+      connects++;
+    }
+    bool raw = random.below(10) == 0;
+    std::vector<uint8_t> body = mutate(random, valid, 200);
+    if (!raw) {
+      uint8_t type = random.below(4) ? static_cast<uint8_t>(MqttPacket::PUBLISH) : random.below(16);
+      uint8_t header[5];
+      size_t n = MqttPacket::writeHeader(header, (type << 4) | random.below(16), body.size());
+      body.insert(body.begin(), header, header + n);
+    }
+    transport.receive(body);
+    session.loop(nowMs);
+    transport.sent();
+    if (raw) {
+      transport.stop();
+      session.loop(nowMs);
+    }
+  }
+  CHECK(connects > 0);
+  CHECK(delivered > 0);
+  CHECK(routed > 0);
+}
+
+typedef RuntimeConfig<MemoryStorage> Config;
+
+static const Settings DEFAULTS = Settings::make(250, 8000, 5, 50, 60);
+
+/// @brief Random text built mostly from the pieces the parser looks for
+static std::vector<uint8_t> configText(Random& random) {
+  static const char* const PIECES[] = {
+    "min_ms", "max_ms", "min_cm", "enter_cm", "exit_cm", "trig0", "echo0", "trig1", "echo", "trig99",
+    "=", "=", ",", "&", ";", " ", "\n", "0", "1", "5", "9", "45", "60", "250", "4294967295", "4294967296",
+    "-", "x", "==", "",
+  };
+  std::vector<uint8_t> text;
+  for (uint32_t n = random.below(12); n > 0; n--) {
+    if (random.below(10) == 0) {
+      text.push_back(random.byte());
+      continue;
+    }
+    const char* piece = PIECES[random.below(sizeof(PIECES) / sizeof(PIECES[0]))];
+    text.insert(text.end(), piece, piece + strlen(piece));
+  }
+  return text;
+}
+
+// Whatever the text, the live settings stay valid and change only when the update applied
+static void applyKeepsSettingsValid() {
+  Random random(4);
+  MemoryStorage storage;
+  Config config(storage, DEFAULTS, 250);
+  config.begin();
+  const char* validText = "min_ms=500,max_ms=9000,min_cm=6,enter_cm=45,exit_cm=55";
+  std::vector<uint8_t> valid(validText, validText + strlen(validText));
+  uint32_t applied = 0;
+
+  for (int i = 0; i < 100000; i++) {
+    std::vector<uint8_t> text = random.below(2) ? configText(random) : mutate(random, valid, 80);
+    Settings before = config.get();
+    int savesBefore = storage.saves;
+    Config::Result result = config.apply(reinterpret_cast<const char*>(text.data()), text.size());
+    CHECK(config.isValid(config.get()));
+    if (result == Config::Result::APPLIED) {
+      applied++;
+      CHECK_EQ(storage.saves, savesBefore + 1);
+    } else {
+      CHECK(config.get() == before);
+      CHECK_EQ(storage.saves, savesBefore);
+    }
+  }
+  CHECK(applied > 0);
+}
+
+// A stored blob of any content loads as valid settings
+static void beginKeepsSettingsValid() {
+  Random random(5);
+  MemoryStorage good;
+  Config writer(good, DEFAULTS, 250);
+  writer.begin();
+  writer.apply("enter_cm=40", 11);
+  std::vector<uint8_t> valid(good.data, good.data + good.length);
+
+  for (int i = 0; i < 50000; i++) {
+    std::vector<uint8_t> blob = mutate(random, valid, 400);
+    MemoryStorage storage;
+    if (blob.size() > sizeof(storage.data)) {
+      continue;
+    }
+    std::copy(blob.begin(), blob.end(), storage.data);
+    storage.length = blob.size();
+    Config config(storage, DEFAULTS, 250);
+    Config::Source source = config.begin();
+    CHECK(config.isValid(config.get()));
+    if (source == Config::Source::DEFAULTS) {
+      CHECK(config.get() == DEFAULTS);
+    }
+  }
+}
+
+int main() {
+  parsePublishBodies();
+  readerResynchronizes();
+  sessionSurvivesGarbage();
+  applyKeepsSettingsValid();
+  beginKeepsSettingsValid();
+  return Check::result();
+}
@@ -0,0 +1,163 @@
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string.h>
+#include "JsonWriter.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+// Every heap allocation in the process goes through here
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+  allocations++;
+  void* p = malloc(size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+// The fields DistanceSensor::toJson writes for one transition
+static size_t writeSensorPayload(char* buffer, size_t capacity, int index, bool occupied, long distanceCm) {
+  JsonWriter json(buffer, capacity);
+  json.beginObject()
+    .field("name", "ultrasonic_3_esp32_dev_1")
+    .field("index", index)
+    .field("type", "distance")
+    .field("technology", "ultrasonic")
+    .field("trigger_pin", 5)
+    .field("echo_pin", 18)
+    .field("is_occupied", occupied)
+    .field("current_distance", distanceCm)
+    .field("last_updated", "2024-05-01T12:00:00Z")
+    .endObject();
+  return json.length();
+}
+
+static void writesObject() {
+  char buffer[64];
+  JsonWriter json(buffer, sizeof(buffer));
+  json.beginObject().field("index", 3).field("is_occupied", true).field("name", "a").endObject();
+  CHECK(json.ok());
+  CHECK_STR(buffer, "{\"index\":3,\"is_occupied\":true,\"name\":\"a\"}");
+  CHECK_EQ(json.length(), strlen(buffer));
+
+  JsonWriter empty(buffer, sizeof(buffer));
+  empty.beginObject().endObject();
+  CHECK_STR(buffer, "{}");
+}
+
+// Quotes, backslashes and control characters come out escaped; other bytes pass through
+static void escapesStrings() {
+  char buffer[128];
+  JsonWriter json(buffer, sizeof(buffer));
+  json.beginObject().field("k\"ey", "a\"b\\c\nd\te\x01\x1f").field("utf8", "\xc3\xa9").field("null", nullptr).endObject();
+  CHECK(json.ok());
+  CHECK_STR(buffer, "{\"k\\\"ey\":\"a\\\"b\\\\c\\u000ad\\u0009e\\u0001\\u001f\",\"utf8\":\"\xc3\xa9\",\"null\":\"\"}");
+}
+
+static void formatsNumbers() {
+  char buffer[256];
+  JsonWriter json(buffer, sizeof(buffer));
+  json.beginObject()
+    .field("zero", 0)
+    .field("negative", -1)
+    .field("int_min", INT_MIN)
+    .field("long_min", LONG_MIN)
+    .field("long_max", LONG_MAX)
+    .field("u32_max", static_cast<unsigned long>(UINT32_MAX))
+    .field("ulong_max", ULONG_MAX)
+    .field("false", false)
+    .endObject();
+  CHECK(json.ok());
+
+  char expected[256];
+  snprintf(expected, sizeof(expected),
+           "{\"zero\":0,\"negative\":-1,\"int_min\":%d,\"long_min\":%ld,\"long_max\":%ld,"
+           "\"u32_max\":4294967295,\"ulong_max\":%lu,\"false\":false}",
+           INT_MIN, LONG_MIN, LONG_MAX, ULONG_MAX);
+  CHECK_STR(buffer, expected);
+}
+
+// Output that does not fit is refused, at every possible cut, and never written past the buffer
+static void refusesOverflow() {
+  char full[256];
+  size_t needed = writeSensorPayload(full, sizeof(full), 3, true, 42);
+  CHECK(needed > 0);
+
+  for (size_t capacity = 0; capacity <= needed + 1; capacity++) {
+    char buffer[260];
+    memset(buffer, '#', sizeof(buffer));
+    size_t length = writeSensorPayload(buffer, capacity, 3, true, 42);
+    if (capacity > needed) {
+      CHECK_EQ(length, needed);
+      CHECK_STR(buffer, full);
+    } else {
+      CHECK_EQ(length, 0);
+    }
+    CHECK(buffer[capacity] == '#');
+    if (capacity > 0) {
+      CHECK(memchr(buffer, '\0', capacity) != nullptr);  // Always terminated
+    }
+  }
+
+  JsonWriter none(nullptr, 0);
+  none.beginObject().field("index", 1).endObject();
+  CHECK(!none.ok());
+  CHECK_EQ(none.length(), 0);
+}
+
+// Building and overflowing payloads touches the heap not once
+static void allocatesNothing() {
+  char buffer[256];
+  char small[16];
+  size_t before = allocations;
+  for (int i = 0; i < 1000; i++) {
+    writeSensorPayload(buffer, sizeof(buffer), i % 64, i & 1, i - 1);
+    writeSensorPayload(small, sizeof(small), i % 64, i & 1, i - 1);
+  }
+  CHECK_EQ(allocations - before, 0);
+
+  // The counter itself works
+  std::string* s = new std::string("sure to allocate something");
+  CHECK(allocations > before);
+  CHECK(s->size() > 0);
+  delete s;
+}
+
+// Payloads per second on this host, for comparing against earlier serializers
+static void throughput() {
+  const int PAYLOADS = 200000;
+  char buffer[256];
+  size_t bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < PAYLOADS; i++) {
+    bytes += writeSensorPayload(buffer, sizeof(buffer), i % 64, i & 1, i % 400);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  CHECK(bytes > 0);
+  printf("throughput: %.0f payloads/s, %lu bytes each\n", PAYLOADS / seconds,
+         static_cast<unsigned long>(bytes / PAYLOADS));
+}
+
+int main() {
+  writesObject();
+  escapesStrings();
+  formatsNumbers();
+  refusesOverflow();
+  allocatesNothing();
+  throughput();
+  return Check::result();
+}
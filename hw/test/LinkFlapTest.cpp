@@ -0,0 +1,277 @@
+#include <vector>
+#include "WifiConnector.h"
+#include "ReconnectSchedule.h"
+#include "MqttSession.h"
+#include "Config.h"
+#include "Check.h"
+#include "FakeRadio.h"
+#include "FakeTransport.h"
+#include "MemoryStorage.h"
+
+using namespace FindSpot;
+
+typedef WifiConnector<FakeRadio, MemoryStorage> Connector;
+typedef MqttSession<FakeTransport, MQTT_INFLIGHT_WINDOW, MQTT_PACKET_SIZE> Session;
+
+static const uint32_t STEP_MS = 10;        // One pass of the networking task
+static const uint32_t BROKER_RTT_MS = 40;  // Every broker reply comes this long after the request
+
+/**
+ * A device's network stack as main.ino wires it: the WifiConnector
+ * supervises the link, and the MQTT connection is driven like
+ * MQTTClient::advanceConnection() with a ReconnectSchedule. With `wired`,
+ * the link listener pauses and resumes MQTT (onWifiLink); without it MQTT
+ * only finds out from its own failures, as before runtime supervision.
+ *
+ * The broker answers CONNECT, PUBLISH and PINGREQ after a round trip.
+ * When the link is down the TCP connection is gone and nothing reaches it.
+ */
+class Device {
+public:
+  enum class Conn : uint8_t { IDLE, HANDSHAKE, CONNECTED };
+
+  FakeRadio radio;
+  MemoryStorage storage;
+  Connector wifi{radio, storage, WIFI_FAST_CONNECT_TIMEOUT_MS, WIFI_CONNECT_TIMEOUT_MS, false,
+                 Backoff(WIFI_RETRY_BASE_MS, WIFI_RETRY_CAP_MS, 3)};
+  FakeTransport transport;
+  Session session{transport, MQTT_RETRY_MS, MQTT_CONNECT_TIMEOUT_MS};
+  ReconnectSchedule schedule{Backoff(MQTT_RECONNECT_BASE_MS, MQTT_RECONNECT_CAP_MS, 7), MQTT_RECONNECT_STABLE_MS};
+  Conn conn = Conn::IDLE;
+  uint32_t connectedSinceMs = 0;
+
+  uint32_t attempts = 0;
+  uint32_t attemptsWhileDown = 0;
+  uint32_t publishesDelivered = 0;
+  uint32_t wifiUpAtMs = 0;
+  std::vector<uint32_t> mqttDelaysMs;  // From each return of the link until MQTT was connected again
+
+  explicit Device(bool wired) : wired(wired) {
+    current = this;
+    wifi.setListener(onWifiLink);
+  }
+
+  void begin() {
+    wifi.begin(radio.nowMs);
+  }
+
+  void step(uint32_t nowMs) {
+    radio.nowMs = nowMs;
+    wifi.poll(nowMs);
+    if (!radio.up) {
+      transport.open = false;  // The socket dies with the link
+      replies.clear();
+    }
+    broker(nowMs);
+    advanceConnection(nowMs);
+  }
+
+private:
+  struct Reply {
+    uint32_t atMs;
+    std::vector<uint8_t> bytes;
+  };
+
+  static Device* current;
+  bool wired;
+  bool mqttStarted = false;  // Registration, and with it the first connect, waits for the first link
+  bool awaitingMqtt = false;
+  std::vector<Reply> replies;
+
+  // What main.ino's onWifiLink() does with MQTTClient::onNetworkDown()/onNetworkUp()
+  static void onWifiLink(bool up) {
+    Device& self = *current;
+    if (up) {
+      self.wifiUpAtMs = self.radio.nowMs;
+      self.awaitingMqtt = true;
+      self.mqttStarted = true;
+    }
+    if (!self.wired) {
+      return;
+    }
+    if (up) {
+      self.schedule.onNetworkUp(self.radio.nowMs);
+    } else {
+      self.session.abort();
+      self.conn = Conn::IDLE;
+      self.schedule.onNetworkDown();
+    }
+  }
+
+  void broker(uint32_t nowMs) {
+    if (!transport.open) {
+      return;
+    }
+    for (const FakeTransport::Packet& packet : transport.sent()) {
+      if (packet.type == MqttPacket::CONNECT) {
+        replies.push_back({nowMs + BROKER_RTT_MS, connack(0)});
+      } else if (packet.type == MqttPacket::PUBLISH) {
+        publishesDelivered++;
+        replies.push_back({nowMs + BROKER_RTT_MS, puback(publishId(packet))});
+      } else if (packet.type == MqttPacket::PINGREQ) {
+        replies.push_back({nowMs + BROKER_RTT_MS, {MqttPacket::PINGRESP << 4, 0}});
+      }
+    }
+    while (!replies.empty() && nowMs >= replies.front().atMs) {
+      transport.receive(replies.front().bytes);
+      replies.erase(replies.begin());
+    }
+  }
+
+  void advanceConnection(uint32_t nowMs) {
+    switch (conn) {
+      case Conn::IDLE:
+        if (mqttStarted && schedule.isDue(nowMs)) {
+          attempts++;
+          if (!radio.up) {
+            attemptsWhileDown++;
+            schedule.onFailure(nowMs);  // DNS fails without a link
+            break;
+          }
+          transport = FakeTransport();
+          replies.clear();
+          if (!session.beginSession("client", "user", "pass", MQTT_KEEPALIVE_S, nullptr, nowMs)) {
+            schedule.onFailure(nowMs);
+            break;
+          }
+          conn = Conn::HANDSHAKE;
+        }
+        break;
+
+      case Conn::HANDSHAKE:
+        session.loop(nowMs);
+        if (session.connected()) {
+          conn = Conn::CONNECTED;
+          connectedSinceMs = nowMs;
+          if (awaitingMqtt) {
+            mqttDelaysMs.push_back(nowMs - wifiUpAtMs);
+            awaitingMqtt = false;
+          }
+        } else if (session.getState() == Session::State::DISCONNECTED) {
+          schedule.onFailure(nowMs);
+          conn = Conn::IDLE;
+        }
+        break;
+
+      case Conn::CONNECTED:
+        session.loop(nowMs);
+        if (!session.connected()) {
+          schedule.onLost(nowMs, nowMs - connectedSinceMs);
+          conn = Conn::IDLE;
+        }
+        break;
+    }
+  }
+};
+
+Device* Device::current = nullptr;
+
+struct Outage {
+  uint32_t startMs;
+  uint32_t durationMs;
+};
+
+// A blip, a short outage and an access point rebooting, twice over
+static const Outage OUTAGES[] = {
+  {10000, 2000}, {60000, 45000}, {150000, 180000}, {400000, 2000}, {420000, 45000}, {500000, 180000},
+};
+static const uint32_t RUN_MS = 800000;
+
+/// @brief Run the outage schedule; a QoS 1 message is published just before the first outage
+static void run(Device& device) {
+  device.begin();
+  bool published = false;
+  for (uint32_t nowMs = 0; nowMs < RUN_MS; nowMs += STEP_MS) {
+    for (const Outage& outage : OUTAGES) {
+      if (nowMs == outage.startMs) {
+        device.radio.inRange = false;
+        device.radio.dropLink();
+      } else if (nowMs == outage.startMs + outage.durationMs) {
+        device.radio.inRange = true;
+      }
+    }
+    if (!published && nowMs == OUTAGES[0].startMs - STEP_MS) {
+      // Its PUBACK is still on the way when the link drops
+      const uint8_t payload[] = "{\"is_occupied\":true}";
+      published = device.session.publish("spot", payload, sizeof(payload) - 1, 1, true, nowMs);
+    }
+    device.step(nowMs);
+  }
+  CHECK(published);
+}
+
+static uint32_t total(const std::vector<uint32_t>& delays) {
+  uint32_t sum = 0;
+  for (uint32_t delay : delays) {
+    sum += delay;
+  }
+  return sum;
+}
+
+static uint32_t longest(const std::vector<uint32_t>& delays) {
+  uint32_t max = 0;
+  for (uint32_t delay : delays) {
+    max = delay > max ? delay : max;
+  }
+  return max;
+}
+
+// With the listener wired, MQTT waits out the outage and is back one round trip after the link
+static void reconnectsRightAfterLink() {
+  Device device(true);
+  run(device);
+
+  CHECK_EQ(device.mqttDelaysMs.size(), 1 + sizeof(OUTAGES) / sizeof(OUTAGES[0]));  // Boot, then every outage
+  CHECK(longest(device.mqttDelaysMs) <= BROKER_RTT_MS + 2 * STEP_MS);
+  CHECK_EQ(device.attemptsWhileDown, 0);
+  CHECK_EQ(device.attempts, device.mqttDelaysMs.size());
+  CHECK_EQ(device.schedule.getFailures(), 0);
+  CHECK(device.conn == Device::Conn::CONNECTED);
+
+  // The message in flight when the link dropped was resent and acknowledged
+  CHECK_EQ(device.session.getInflight(), 0);
+  CHECK_EQ(device.publishesDelivered, 2);
+}
+
+// Without it, attempts fail through the outage and the grown backoff delays the reconnect
+static void unwiredWaitsOutBackoff() {
+  Device wired(true);
+  run(wired);
+  Device unwired(false);
+  run(unwired);
+
+  CHECK(unwired.attemptsWhileDown > 0);
+  CHECK(total(unwired.mqttDelaysMs) > 10 * total(wired.mqttDelaysMs));
+  CHECK(longest(unwired.mqttDelaysMs) > MQTT_RECONNECT_BASE_MS);
+  printf("link back to MQTT connected: longest %lu ms wired, %lu ms unwired; %lu attempts during outages unwired\n",
+         static_cast<unsigned long>(longest(wired.mqttDelaysMs)), static_cast<unsigned long>(longest(unwired.mqttDelaysMs)),
+         static_cast<unsigned long>(unwired.attemptsWhileDown));
+}
+
+// A flap shorter than a poll still takes MQTT down and back up through the listener
+static void blipBetweenPolls() {
+  Device device(true);
+  uint32_t nowMs = 0;
+  device.begin();
+  for (; nowMs < 5000; nowMs += STEP_MS) {
+    device.step(nowMs);
+  }
+  CHECK(device.conn == Device::Conn::CONNECTED);
+
+  device.radio.disconnectEvents++;  // Dropped and re-associated by the driver between two passes
+  device.step(nowMs);
+  CHECK(device.conn != Device::Conn::CONNECTED);
+  for (nowMs += STEP_MS; nowMs < 10000; nowMs += STEP_MS) {
+    device.step(nowMs);
+  }
+  CHECK(device.conn == Device::Conn::CONNECTED);
+  CHECK_EQ(device.mqttDelaysMs.size(), 2);
+  CHECK(longest(device.mqttDelaysMs) <= BROKER_RTT_MS + 2 * STEP_MS);
+}
+
+int main() {
+  reconnectsRightAfterLink();
+  unwiredWaitsOutBackoff();
+  blipBetweenPolls();
+  return Check::result();
+}
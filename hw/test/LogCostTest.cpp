@@ -0,0 +1,109 @@
+// Built once per LOG_LEVEL and LOG_RING_BUFFER setting (see CMakeLists.txt)
+#include <chrono>
+#include "Log.h"
+#include "OccupancyFilter.h"
+#include "SensorInterface.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+static const int SPOTS = 16;
+static const int PASSES = 20000;
+static const uint32_t UART_BAUD = 115200;  // 10 bits on the wire per byte
+
+static size_t sinkLines = 0;
+static size_t sinkBytes = 0;
+
+static void countingSink(const char*, size_t length) {
+  sinkLines++;
+  sinkBytes += length + 1;  // With the newline
+}
+
+struct Spot {
+  OccupancyFilter<5> filter{5, 50, 60, 500};
+  char name[SENSOR_NAME_LEN];
+};
+
+// Calls made at each level, whether or not the build keeps them: [NONE..DEBUG]
+static size_t sites[LOG_LEVEL_DEBUG + 1];
+
+/**
+ * One pass of the sensing and networking loop with the firmware's logging:
+ * a DEBUG reading per spot, INFO and DEBUG per published transition, and
+ * an occasional WARN and ERROR. Each spot sees a car arrive and leave
+ * every 800 passes.
+ */
+static void loopPass(Spot* spots, int pass) {
+  for (int i = 0; i < SPOTS; i++) {
+    Spot& spot = spots[i];
+    long cm = ((pass + i * 50) % 800) < 400 ? 250 - (pass + i) % 7 : 40 + (pass + i) % 5;
+    bool was = spot.filter.isOccupied();
+    bool occupied = spot.filter.update(cm, pass * 250);
+    sites[LOG_LEVEL_DEBUG]++;
+    LOG_DEBUG("%s: %ld cm, median %u cm", spot.name, cm, static_cast<unsigned>(spot.filter.getMedian()));
+    if (occupied != was) {
+      sites[LOG_LEVEL_INFO]++;
+      LOG_INFO("%s %s at %ld cm", spot.name, occupied ? "occupied" : "free", cm);
+      sites[LOG_LEVEL_DEBUG]++;
+      LOG_DEBUG("Published %u bytes to device/1/sensors/%d", 9u, i);
+    }
+  }
+  if (pass % 500 == 0) {
+    sites[LOG_LEVEL_WARN]++;
+    LOG_WARN("MQTT not connected, %u transitions queued in RAM", static_cast<unsigned>(pass % 17));
+  }
+  if (pass % 5000 == 0) {
+    sites[LOG_LEVEL_ERROR]++;
+    LOG_ERROR("Publish to device/1/occupancy deferred, %u messages in flight", 4u);
+  }
+}
+
+static const char* levelName() {
+  static const char* const NAMES[] = {"NONE", "ERROR", "WARN", "INFO", "DEBUG"};
+  return NAMES[LOG_LEVEL];
+}
+
+// Lines and bytes follow the level exactly; the loop time is measured with output to a
+// counting sink, and the wire time a blocking 115200 baud Serial would add is derived
+static void loopCostAtLevel() {
+  Log::setSink(countingSink);
+  Spot spots[SPOTS];
+  for (int i = 0; i < SPOTS; i++) {
+    SensorBase<Spot>::formatName(spots[i].name, sizeof(spots[i].name), "ultrasonic", i, "esp32_dev", 1);
+    spots[i].filter.update(250, 0);  // Seeded at boot, so the first pass is not a burst of transitions
+  }
+
+  double loopNs = 0;
+  for (int pass = 0; pass < PASSES; pass++) {
+    auto start = std::chrono::steady_clock::now();
+    loopPass(spots, pass);
+    loopNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+#if LOG_RING_BUFFER
+    Log::ring().drain(countingSink);  // The low-priority task, outside the loop
+#endif
+  }
+
+  size_t expected = 0;
+  for (int level = LOG_LEVEL_ERROR; level <= LOG_LEVEL; level++) {
+    expected += sites[level];
+  }
+  CHECK(sites[LOG_LEVEL_DEBUG] > 0 && sites[LOG_LEVEL_INFO] > 0 && sites[LOG_LEVEL_WARN] > 0);
+  CHECK_EQ(sinkLines, expected);
+#if LOG_RING_BUFFER
+  CHECK_EQ(Log::ring().getDropped(), 0);
+#endif
+#if LOG_LEVEL == LOG_LEVEL_NONE
+  CHECK_EQ(sinkBytes, 0);
+#endif
+
+  double bytesPerPass = static_cast<double>(sinkBytes) / PASSES;
+  double wireUs = bytesPerPass * 10 * 1e6 / UART_BAUD;
+  printf("level %s, %s: %.2f us per pass in the loop, %.2f bytes per pass = %.0f us on the UART%s\n",
+         levelName(), LOG_RING_BUFFER ? "ring" : "inline", loopNs / PASSES / 1000, bytesPerPass, wireUs,
+         LOG_RING_BUFFER ? " in the drain task" : ", blocking the loop");
+}
+
+int main() {
+  loopCostAtLevel();
+  return Check::result();
+}
@@ -0,0 +1,117 @@
+// Small ring and WARN level, as a build would set them in Config.h
+#define LOG_LEVEL LOG_LEVEL_WARN
+#define LOG_RING_BUFFER 1
+#define LOG_RING_LINES 4
+#define LOG_LINE_LEN 24
+
+#include <string>
+#include <thread>
+#include <vector>
+#include "Log.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+static std::vector<std::string> lines;
+
+static void capture(const char* line, size_t length) {
+  lines.push_back(std::string(line, length));
+}
+
+static int evaluated = 0;
+
+static int sideEffect() {
+  return ++evaluated;
+}
+
+// Levels above LOG_LEVEL compile to nothing, arguments included
+static void disabledLevelsCostNothing() {
+  LOG_INFO("%d", sideEffect());
+  LOG_DEBUG("%d", sideEffect());
+  CHECK_EQ(evaluated, 0);
+  LOG_WARN("%d", sideEffect());
+  CHECK_EQ(evaluated, 1);
+  lines.clear();
+  Log::ring().drain(capture);
+  CHECK_EQ(lines.size(), 1);
+  CHECK_STR(lines.empty() ? "" : lines[0].c_str(), "W 1");
+}
+
+static void drainsInOrder() {
+  lines.clear();
+  LOG_ERROR("first %d", 1);
+  LOG_WARN("second");
+  CHECK_EQ(Log::ring().drain(capture), 2);
+  CHECK_EQ(lines.size(), 2);
+  if (lines.size() == 2) {
+    CHECK_STR(lines[0].c_str(), "E first 1");
+    CHECK_STR(lines[1].c_str(), "W second");
+  }
+  CHECK_EQ(Log::ring().drain(capture), 0);
+}
+
+// A lapped reader keeps the newest lines and counts the rest
+static void dropsOldestWhenFull() {
+  lines.clear();
+  uint32_t droppedBefore = Log::ring().getDropped();
+  for (int i = 0; i < LOG_RING_LINES + 2; i++) {
+    LOG_WARN("line %d", i);
+  }
+  Log::ring().drain(capture);
+  CHECK_EQ(lines.size(), LOG_RING_LINES);
+  CHECK_STR(lines.empty() ? "" : lines[0].c_str(), "W line 2");
+  CHECK_EQ(Log::ring().getDropped() - droppedBefore, 2);
+}
+
+static void truncatesLongLines() {
+  lines.clear();
+  LOG_ERROR("%s", "a message far longer than one ring slot");
+  Log::ring().drain(capture);
+  CHECK_EQ(lines.size(), 1);
+  CHECK_EQ(lines.empty() ? 0 : lines[0].size(), LOG_LINE_LEN - 1);
+}
+
+// Writers on several threads never block and never hand out a torn line
+static void concurrentWriters() {
+  const int WRITERS = 4;
+  const int PER_WRITER = 20000;
+  lines.clear();
+  uint32_t droppedBefore = Log::ring().getDropped();
+
+  std::vector<std::thread> writers;
+  for (int w = 0; w < WRITERS; w++) {
+    writers.emplace_back([w] {
+      for (int i = 0; i < PER_WRITER; i++) {
+        LOG_WARN("w%d %05d", w, i);
+      }
+    });
+  }
+  size_t drained = 0;
+  for (int i = 0; i < 2000; i++) {
+    drained += Log::ring().drain(capture);
+  }
+  for (std::thread& writer : writers) {
+    writer.join();
+  }
+  drained += Log::ring().drain(capture);
+
+  CHECK_EQ(drained + (Log::ring().getDropped() - droppedBefore), WRITERS * PER_WRITER);
+  int torn = 0;
+  for (const std::string& line : lines) {
+    int w, i;
+    char rest;
+    if (sscanf(line.c_str(), "W w%d %5d%c", &w, &i, &rest) != 2 || line.size() != 10) {
+      torn++;
+    }
+  }
+  CHECK_EQ(torn, 0);
+}
+
+int main() {
+  disabledLevelsCostNothing();
+  drainsInOrder();
+  dropsOldestWhenFull();
+  truncatesLongLines();
+  concurrentWriters();
+  return Check::result();
+}
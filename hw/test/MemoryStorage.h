@@ -0,0 +1,39 @@
+#ifndef MEMORY_STORAGE_H
+#define MEMORY_STORAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * In-memory stand-in for NvsStorage: one blob, with a count of writes.
+ *
+ * save() can be made to fail, and the stored bytes can be edited directly
+ * to simulate a record left by another firmware or a corrupted one.
+ */
+struct MemoryStorage {
+  uint8_t data[512];
+  size_t length = 0;
+  bool failSave = false;
+  int saves = 0;
+
+  size_t load(uint8_t* out, size_t capacity) {
+    if (length > capacity) {
+      return 0;
+    }
+    memcpy(out, data, length);
+    return length;
+  }
+
+  bool save(const uint8_t* blob, size_t size) {
+    if (failSave || size > sizeof(data)) {
+      return false;
+    }
+    memcpy(data, blob, size);
+    length = size;
+    saves++;
+    return true;
+  }
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include <vector>
+#include "MqttPacket.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+// Remaining length uses 1..4 bytes of 7 bits each
+static void remainingLength() {
+  const size_t lengths[] = {0, 127, 128, 16383, 16384, 2097151, 2097152};
+  const size_t sizes[] = {1, 1, 2, 2, 3, 3, 4};
+  for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+    uint8_t header[5];
+    CHECK_EQ(MqttPacket::remainingLengthSize(lengths[i]), sizes[i]);
+    CHECK_EQ(MqttPacket::writeHeader(header, 0x30, lengths[i]), 1 + sizes[i]);
+  }
+  uint8_t header[5];
+  MqttPacket::writeHeader(header, 0x30, 321);
+  CHECK_EQ(header[1], 0xC1);  // 321 = 65 + 2 * 128
+  CHECK_EQ(header[2], 0x02);
+}
+
+static void publishBytes() {
+  const uint8_t payload[] = {0xAB, 0xCD};
+  uint8_t packet[32];
+  size_t n = MqttPacket::publish(packet, sizeof(packet), "a/b", payload, sizeof(payload), 1, false, 0x1234);
+  const uint8_t expected[] = {0x32, 9, 0, 3, 'a', '/', 'b', 0x12, 0x34, 0xAB, 0xCD};
+  CHECK_EQ(n, sizeof(expected));
+  CHECK(memcmp(packet, expected, sizeof(expected)) == 0);
+
+  // QoS 0 carries no packet identifier
+  n = MqttPacket::publish(packet, sizeof(packet), "a/b", payload, sizeof(payload), 0, false, 0x1234);
+  CHECK_EQ(n, sizeof(expected) - 2);
+  CHECK_EQ(packet[0], 0x30);
+
+  // Exactly full fits, one byte short does not
+  CHECK_EQ(MqttPacket::publish(packet, sizeof(expected), "a/b", payload, sizeof(payload), 1, false, 1), sizeof(expected));
+  CHECK_EQ(MqttPacket::publish(packet, sizeof(expected) - 1, "a/b", payload, sizeof(payload), 1, false, 1), 0);
+}
+
+static void subscribeBytes() {
+  uint8_t packet[32];
+  size_t n = MqttPacket::subscribe(packet, sizeof(packet), 7, "d/#", 1);
+  const uint8_t expected[] = {0x82, 8, 0, 7, 0, 3, 'd', '/', '#', 1};
+  CHECK_EQ(n, sizeof(expected));
+  CHECK(memcmp(packet, expected, sizeof(expected)) == 0);
+}
+
+// Feed bytes in; collect (type, length) of every completed packet
+template <size_t SIZE>
+static std::vector<size_t> feedAll(MqttPacket::Reader<SIZE>& reader, const std::vector<uint8_t>& bytes) {
+  std::vector<size_t> lengths;
+  for (uint8_t byte : bytes) {
+    if (reader.feed(byte)) {
+      lengths.push_back(reader.length());
+    }
+  }
+  return lengths;
+}
+
+// One byte at a time, whatever the chunking of the stream
+static void readerReassembles() {
+  MqttPacket::Reader<300> reader;
+  std::vector<uint8_t> stream;
+  uint8_t packet[320];
+  std::vector<uint8_t> payload(250, 0x5A);
+  size_t n = MqttPacket::publish(packet, sizeof(packet), "topic", payload.data(), payload.size(), 1, false, 9);
+  stream.insert(stream.end(), packet, packet + n);
+  stream.insert(stream.end(), {0xD0, 0x00});  // PINGRESP, empty body
+  stream.insert(stream.end(), {0x40, 0x02, 0x00, 0x09});  // PUBACK 9
+
+  std::vector<size_t> lengths = feedAll(reader, stream);
+  CHECK_EQ(lengths.size(), 3);
+  if (lengths.size() == 3) {
+    CHECK_EQ(lengths[0], n - 3);  // Two-byte remaining length
+    CHECK_EQ(lengths[1], 0);
+    CHECK_EQ(lengths[2], 2);
+  }
+  CHECK_EQ(reader.type(), MqttPacket::PUBACK);
+  CHECK_EQ(MqttPacket::getU16(reader.body()), 9);
+}
+
+// A packet larger than the buffer is skipped whole and counted; the next one parses
+static void readerSkipsOversize() {
+  MqttPacket::Reader<16> reader;
+  std::vector<uint8_t> stream = {0x30, 20};
+  stream.insert(stream.end(), 20, 0xEE);
+  stream.insert(stream.end(), {0x40, 0x02, 0x00, 0x05});
+  std::vector<size_t> lengths = feedAll(reader, stream);
+  CHECK_EQ(lengths.size(), 1);
+  CHECK_EQ(reader.getDropped(), 1);
+  CHECK_EQ(reader.type(), MqttPacket::PUBACK);
+}
+
+// Five length bytes are malformed; the reader resynchronizes instead of overflowing
+static void readerRejectsLongLength() {
+  MqttPacket::Reader<16> reader;
+  std::vector<uint8_t> stream = {0x30, 0xFF, 0xFF, 0xFF, 0xFF};
+  stream.insert(stream.end(), {0xD0, 0x00});
+  std::vector<size_t> lengths = feedAll(reader, stream);
+  CHECK_EQ(lengths.size(), 1);
+  CHECK_EQ(reader.type(), MqttPacket::PINGRESP);
+}
+
+static void parsesPublishInPlace() {
+  uint8_t body[] = {0, 5, 'd', '/', 'c', 'm', 'd', 0x00, 0x2A, '{', '}'};
+  MqttPacket::Publish message;
+  CHECK(MqttPacket::parsePublish(0x02, body, sizeof(body), message));
+  CHECK_STR(message.topic, "d/cmd");
+  CHECK_EQ(message.qos, 1);
+  CHECK_EQ(message.packetId, 42);
+  CHECK_EQ(message.length, 2);
+  CHECK(memcmp(message.payload, "{}", 2) == 0);
+
+  uint8_t truncated[] = {0, 9, 'd', '/'};
+  CHECK(!MqttPacket::parsePublish(0x00, truncated, sizeof(truncated), message));
+}
+
+// Last Will on the status topic: flags and payload order as in MQTT 3.1.1 section 3.1
+static void connectWithWill() {
+  const uint8_t offline[] = {'o', 'f', 'f'};
+  MqttPacket::Will will = {"d/1/status", offline, sizeof(offline), 1, true};
+  uint8_t packet[96];
+  size_t n = MqttPacket::connect(packet, sizeof(packet), "dev1", "user", "pw", 60, &will);
+
+  const uint8_t expected[] = {
+    0x10, 43,
+    0, 4, 'M', 'Q', 'T', 'T', MqttPacket::PROTOCOL_LEVEL,
+    0xEE,  // User name, password, will retain, will QoS 1, will flag, clean session
+    0, 60,
+    0, 4, 'd', 'e', 'v', '1',
+    0, 10, 'd', '/', '1', '/', 's', 't', 'a', 't', 'u', 's',
+    0, 3, 'o', 'f', 'f',
+    0, 4, 'u', 's', 'e', 'r',
+    0, 2, 'p', 'w'
+  };
+  CHECK_EQ(n, sizeof(expected));
+  CHECK(memcmp(packet, expected, sizeof(expected)) == 0);
+
+  // Without a will or credentials only clean session is set
+  n = MqttPacket::connect(packet, sizeof(packet), "dev1", "", "", 60, nullptr);
+  CHECK_EQ(n, 18);
+  CHECK_EQ(packet[9], 0x02);
+
+  CHECK_EQ(MqttPacket::connect(packet, sizeof(expected) - 1, "dev1", "user", "pw", 60, &will), 0);
+}
+
+// Retained spot states: the flag is sent, survives a DUP resend, and is reported on receipt
+static void retainFlag() {
+  const uint8_t payload[] = {1};
+  uint8_t packet[32];
+  size_t n = MqttPacket::publish(packet, sizeof(packet), "s", payload, 1, 1, true, 5);
+  CHECK_EQ(packet[0], 0x33);
+  MqttPacket::setDup(packet);
+  CHECK_EQ(packet[0], 0x3B);
+
+  MqttPacket::Publish message;
+  CHECK(MqttPacket::parsePublish(packet[0] & 0x0F, packet + 2, n - 2, message));
+  CHECK(message.retain);
+  CHECK_EQ(message.qos, 1);
+}
+
+int main() {
+  remainingLength();
+  publishBytes();
+  subscribeBytes();
+  readerReassembles();
+  readerSkipsOversize();
+  readerRejectsLongLength();
+  parsesPublishInPlace();
+  connectWithWill();
+  retainFlag();
+  return Check::result();
+}
@@ -0,0 +1,229 @@
+#include "MqttSession.h"
+#include "FakeTransport.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+typedef MqttSession<FakeTransport, 2, 128> Session;
+
+static const uint32_t RETRY_MS = 1000;
+static const uint32_t CONNACK_TIMEOUT_MS = 5000;
+static const uint8_t PAYLOAD[] = {'o', 'n'};
+
+// CONNECT, CONNACK, and the session is up
+static void establish(Session& session, FakeTransport& transport, uint32_t nowMs) {
+  transport.open = true;
+  CHECK(session.beginSession("client", "user", "pass", 0, nullptr, nowMs));
+  transport.receive(connack(0));
+  session.loop(nowMs);
+  CHECK(session.connected());
+}
+
+static void windowLimitsInflight() {
+  FakeTransport transport;
+  Session session(transport, RETRY_MS, CONNACK_TIMEOUT_MS);
+  CHECK(!session.publish("t", PAYLOAD, sizeof(PAYLOAD), 1, false, 0));  // Not connected
+  establish(session, transport, 0);
+  transport.sent();
+
+  CHECK(session.publish("t", PAYLOAD, sizeof(PAYLOAD), 1, false, 10));
+  CHECK(session.publish("t", PAYLOAD, sizeof(PAYLOAD), 1, false, 20));
+  CHECK(!session.publish("t", PAYLOAD, sizeof(PAYLOAD), 1, false, 30));  // Window full, fails fast
+  CHECK(session.publish("t", PAYLOAD, sizeof(PAYLOAD), 0, false, 40));   // QoS 0 takes no slot
+  CHECK_EQ(session.getInflight(), 2);
+
+  std::vector<FakeTransport::Packet> sent = transport.sent();
+  CHECK_EQ(sent.size(), 3);
+  if (sent.size() == 3) {
+    CHECK_EQ(sent[0].flags, 0x02);  // QoS 1, no DUP
+    CHECK_EQ(publishId(sent[0]), 1);
+    CHECK_EQ(publishId(sent[1]), 2);
+    CHECK_EQ(sent[2].flags, 0x00);
+  }
+
+  // A PUBACK frees its slot for the next publish
+  transport.receive(puback(1));
+  session.loop(50);
+  CHECK_EQ(session.getInflight(), 1);
+  CHECK_EQ(session.getStats().acknowledged, 1);
+  CHECK(session.publish("t", PAYLOAD, sizeof(PAYLOAD), 1, false, 60));
+  CHECK_EQ(session.getStats().published, 3);
+}
+
+// Unacknowledged publishes go out again with DUP once retryMs has passed, oldest first
+static void retransmitsAfterTimeout() {
+  FakeTransport transport;
+  Session session(transport, RETRY_MS, CONNACK_TIMEOUT_MS);
+  establish(session, transport, 0);
+  session.publish("t", PAYLOAD, sizeof(PAYLOAD), 1, false, 100);
+  session.publish("t", PAYLOAD, sizeof(PAYLOAD), 1, false, 200);
+  transport.sent();
+
+  session.loop(100 + RETRY_MS - 1);
+  CHECK_EQ(transport.sent().size(), 0);
+
+  session.loop(200 + RETRY_MS);
+  std::vector<FakeTransport::Packet> sent = transport.sent();
+  CHECK_EQ(sent.size(), 2);
+  if (sent.size() == 2) {
+    CHECK_EQ(sent[0].flags, MqttPacket::FLAG_DUP | 0x02);
+    CHECK_EQ(publishId(sent[0]), 1);
+    CHECK_EQ(publishId(sent[1]), 2);
+  }
+  CHECK_EQ(session.getStats().retransmits, 2);
+
+  // Acknowledged in time: no further resend
+  transport.receive(puback(1));
+  transport.receive(puback(2));
+  session.loop(200 + 2 * RETRY_MS);
+  CHECK_EQ(transport.sent().size(), 0);
+  CHECK_EQ(session.getInflight(), 0);
+}
+
+// Slots survive a dropped link and are resent right after the next CONNACK
+static void resendsAfterReconnect() {
+  FakeTransport transport;
+  Session session(transport, RETRY_MS, CONNACK_TIMEOUT_MS);
+  establish(session, transport, 0);
+  session.publish("a", PAYLOAD, sizeof(PAYLOAD), 1, false, 10);
+  transport.failWrites = true;  // Written into a dying socket
+  CHECK(session.publish("b", PAYLOAD, sizeof(PAYLOAD), 1, false, 20));
+  transport.failWrites = false;
+  transport.sent();
+
+  transport.open = false;
+  session.loop(30);
+  CHECK(!session.connected());
+  CHECK_EQ(session.getInflight(), 2);
+
+  establish(session, transport, 40);
+  std::vector<FakeTransport::Packet> sent = transport.sent();
+  CHECK_EQ(sent.size(), 3);  // CONNECT, then both publishes in order
+  if (sent.size() == 3) {
+    CHECK_EQ(sent[0].type, MqttPacket::CONNECT);
+    CHECK_EQ(sent[1].type, MqttPacket::PUBLISH);
+    CHECK_EQ(publishId(sent[1]), 1);
+    CHECK_EQ(publishId(sent[2]), 2);
+    CHECK(sent[2].flags & MqttPacket::FLAG_DUP);
+  }
+}
+
+// A PUBACK for an unknown ID changes nothing
+static void ignoresStrayAcks() {
+  FakeTransport transport;
+  Session session(transport, RETRY_MS, CONNACK_TIMEOUT_MS);
+  establish(session, transport, 0);
+  session.publish("t", PAYLOAD, sizeof(PAYLOAD), 1, false, 0);
+  transport.receive(puback(77));
+  session.loop(10);
+  CHECK_EQ(session.getInflight(), 1);
+  CHECK_EQ(session.getStats().acknowledged, 0);
+}
+
+// No CONNACK within the timeout: dropped, and the code says so
+static void connackTimeout() {
+  FakeTransport transport;
+  Session session(transport, RETRY_MS, CONNACK_TIMEOUT_MS);
+  CHECK(session.beginSession("client", "", "", 0, nullptr, 0));
+  CHECK(session.getState() == Session::State::AWAIT_CONNACK);
+  session.loop(CONNACK_TIMEOUT_MS);
+  CHECK(session.getState() == Session::State::AWAIT_CONNACK);
+  session.loop(CONNACK_TIMEOUT_MS + 1);
+  CHECK(session.getState() == Session::State::DISCONNECTED);
+  CHECK_EQ(session.getConnackCode(), -1);
+  CHECK(!transport.open);
+}
+
+// A refusal ends the attempt and keeps the broker's return code
+static void connackRefused() {
+  FakeTransport transport;
+  Session session(transport, RETRY_MS, CONNACK_TIMEOUT_MS);
+  session.beginSession("client", "user", "wrong", 0, nullptr, 0);
+  transport.receive(connack(5));
+  session.loop(10);
+  CHECK(session.getState() == Session::State::DISCONNECTED);
+  CHECK_EQ(session.getConnackCode(), 5);
+}
+
+// A CONNACK split across reads still completes the handshake
+static void connackInPieces() {
+  FakeTransport transport;
+  Session session(transport, RETRY_MS, CONNACK_TIMEOUT_MS);
+  session.beginSession("client", "", "", 0, nullptr, 0);
+  transport.receive({MqttPacket::CONNACK << 4, 2});
+  session.loop(10);
+  CHECK(!session.connected());
+  transport.receive({0, 0});
+  session.loop(20);
+  CHECK(session.connected());
+  CHECK_EQ(session.getConnackCode(), 0);
+}
+
+// PINGREQ once idle for the keep-alive; a broker silent for 1.5 periods is given up on
+static void keepAlive() {
+  FakeTransport transport;
+  Session session(transport, RETRY_MS, CONNACK_TIMEOUT_MS);
+  session.beginSession("client", "", "", 10, nullptr, 0);
+  transport.receive(connack(0));
+  session.loop(0);
+  transport.sent();
+
+  session.loop(9999);
+  CHECK_EQ(transport.sent().size(), 0);
+  session.loop(10000);
+  std::vector<FakeTransport::Packet> sent = transport.sent();
+  CHECK_EQ(sent.size(), 1);
+  CHECK(!sent.empty() && sent[0].type == MqttPacket::PINGREQ);
+
+  transport.receive({MqttPacket::PINGRESP << 4, 0});
+  session.loop(10100);
+  session.loop(10100 + 15000);
+  CHECK(session.connected());
+  session.loop(10100 + 15001);
+  CHECK(!session.connected());
+}
+
+// An inbound QoS 1 message is acknowledged and handed to the callback
+static int delivered = 0;
+
+static void onMessage(char* topic, uint8_t* payload, unsigned int length) {
+  delivered++;
+  CHECK_STR(topic, "device/1/cmd/snapshot");
+  CHECK_EQ(length, 2);
+  CHECK(memcmp(payload, "{}", 2) == 0);
+}
+
+static void deliversInbound() {
+  FakeTransport transport;
+  Session session(transport, RETRY_MS, CONNACK_TIMEOUT_MS);
+  session.setCallback(onMessage);
+  establish(session, transport, 0);
+  transport.sent();
+
+  uint8_t packet[64];
+  const uint8_t payload[] = {'{', '}'};
+  size_t n = MqttPacket::publish(packet, sizeof(packet), "device/1/cmd/snapshot", payload, 2, 1, false, 300);
+  transport.receive(std::vector<uint8_t>(packet, packet + n));
+  session.loop(10);
+  CHECK_EQ(delivered, 1);
+
+  std::vector<FakeTransport::Packet> sent = transport.sent();
+  CHECK_EQ(sent.size(), 1);
+  if (sent.size() == 1) {
+    CHECK_EQ(sent[0].type, MqttPacket::PUBACK);
+    CHECK_EQ(MqttPacket::getU16(sent[0].body.data()), 300);
+  }
+}
+
+int main() {
+  windowLimitsInflight();
+  retransmitsAfterTimeout();
+  resendsAfterReconnect();
+  ignoresStrayAcks();
+  connackTimeout();
+  connackRefused();
+  connackInPieces();
+  keepAlive();
+  deliversInbound();
+  return Check::result();
+}
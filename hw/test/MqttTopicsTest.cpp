@@ -0,0 +1,52 @@
+#include <limits.h>
+#include "MqttTopics.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+static void buildsEveryTopic() {
+  MqttTopics<3> topics;
+  CHECK(topics.build("esp32_dev", 42));
+  CHECK_STR(topics.clientId, "esp32_dev42");
+  CHECK_STR(topics.sensors[0], "device/42/sensors/0");
+  CHECK_STR(topics.sensors[2], "device/42/sensors/2");
+  CHECK_STR(topics.occupancy, "device/42/occupancy");
+  CHECK_STR(topics.telemetry, "device/42/telemetry");
+  CHECK_STR(topics.status, "device/42/status");
+  CHECK_STR(topics.commandFilter, "device/42/cmd/#");
+}
+
+// Re-registration under another ID replaces every name
+static void rebuildsForNewId() {
+  MqttTopics<1> topics;
+  topics.build("esp32_dev", 123456);
+  CHECK(topics.build("esp32_dev", 7));
+  CHECK_STR(topics.clientId, "esp32_dev7");
+  CHECK_STR(topics.sensors[0], "device/7/sensors/0");
+  CHECK_STR(topics.status, "device/7/status");
+}
+
+// MQTT_TOPIC_LEN holds the longest topic of any int device ID and 64 spots
+static void fitsWorstCaseIds() {
+  MqttTopics<64> topics;
+  CHECK(topics.build("esp32_dev", INT_MIN));
+  CHECK_STR(topics.sensors[63], "device/-2147483648/sensors/63");
+  CHECK(topics.build("esp32_dev", INT_MAX));
+  CHECK_STR(topics.telemetry, "device/2147483647/telemetry");
+}
+
+// A prefix that leaves no room for the ID is reported, and the buffer stays terminated
+static void reportsTruncation() {
+  MqttTopics<1> topics;
+  CHECK(!topics.build("a_very_long_device_prefix_for_tests", 1));
+  CHECK_EQ(strlen(topics.clientId), MQTT_CLIENT_ID_LEN - 1);
+  CHECK_STR(topics.sensors[0], "device/1/sensors/0");
+}
+
+int main() {
+  buildsEveryTopic();
+  rebuildsForNewId();
+  fitsWorstCaseIds();
+  reportsTruncation();
+  return Check::result();
+}
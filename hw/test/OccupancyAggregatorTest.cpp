@@ -0,0 +1,191 @@
+#include <vector>
+#include "OccupancyAggregator.h"
+#include "MqttSession.h"
+#include "Config.h"
+#include "Check.h"
+#include "FakeTransport.h"
+
+using namespace FindSpot;
+
+static void aggregateRoundTrips() {
+  const SpotDelta deltas[] = {{0, 120}, {9, PayloadCodec::NO_DISTANCE}, {63, 35}};
+  uint64_t bitmap = (1ULL << 0) | (1ULL << 40) | (1ULL << 63);
+  uint8_t buffer[PayloadCodec::aggregateSize(64, 64)];
+  size_t length = PayloadCodec::encodeAggregate(bitmap, 64, deltas, 3, 1700000000, buffer, sizeof(buffer));
+  CHECK_EQ(length, PayloadCodec::aggregateSize(64, 3));
+
+  uint64_t decodedBitmap;
+  uint8_t spots;
+  uint32_t timestamp;
+  SpotDelta decoded[8];
+  uint8_t count;
+  CHECK(PayloadCodec::decodeAggregate(buffer, length, decodedBitmap, spots, timestamp, decoded, 8, count));
+  CHECK(decodedBitmap == bitmap);
+  CHECK_EQ(spots, 64);
+  CHECK_EQ(timestamp, 1700000000);
+  CHECK_EQ(count, 3);
+  for (uint8_t i = 0; i < 3 && i < count; i++) {
+    CHECK_EQ(decoded[i].index, deltas[i].index);
+    CHECK_EQ(decoded[i].distanceCm, deltas[i].distanceCm);
+  }
+
+  // Truncated, or more deltas than the caller has room for
+  CHECK(!PayloadCodec::decodeAggregate(buffer, length - 1, decodedBitmap, spots, timestamp, decoded, 8, count));
+  CHECK(!PayloadCodec::decodeAggregate(buffer, length, decodedBitmap, spots, timestamp, decoded, 2, count));
+}
+
+static void rejectsOutOfRange() {
+  uint8_t buffer[PayloadCodec::aggregateSize(64, 64)];
+  const SpotDelta deltas[2] = {{0, 1}, {1, 2}};
+  CHECK_EQ(PayloadCodec::encodeAggregate(0, 65, deltas, 0, 0, buffer, sizeof(buffer)), 0);
+  CHECK_EQ(PayloadCodec::encodeAggregate(0, 1, deltas, 2, 0, buffer, sizeof(buffer)), 0);
+  CHECK_EQ(PayloadCodec::encodeAggregate(0, 8, deltas, 2, 0, buffer, PayloadCodec::aggregateSize(8, 2) - 1), 0);
+}
+
+// Changes within one window land in one message with the latest state and timestamp
+static void coalescesWithinWindow() {
+  OccupancyAggregator<10> aggregator(500);
+  uint8_t buffer[OccupancyAggregator<10>::MAX_SIZE];
+  CHECK(!aggregator.isDue(0));
+  CHECK_EQ(aggregator.encode(buffer, sizeof(buffer)), 0);
+
+  aggregator.record({2, true, 40, 100}, 1000);
+  aggregator.record({7, true, 55, 102}, 1200);
+  aggregator.record({2, false, 300, 101}, 1400);
+  aggregator.record({12, true, 10, 999}, 1450);  // Out of range, ignored
+  CHECK(!aggregator.isDue(1499));
+  CHECK(aggregator.isDue(1500));
+
+  size_t length = aggregator.encode(buffer, sizeof(buffer));
+  CHECK_EQ(length, PayloadCodec::aggregateSize(10, 2));
+  uint64_t bitmap;
+  uint8_t spots;
+  uint32_t timestamp;
+  SpotDelta deltas[10];
+  uint8_t count;
+  CHECK(PayloadCodec::decodeAggregate(buffer, length, bitmap, spots, timestamp, deltas, 10, count));
+  CHECK(bitmap == (1ULL << 7));
+  CHECK_EQ(spots, 10);
+  CHECK_EQ(timestamp, 102);
+  CHECK_EQ(count, 2);
+  CHECK_EQ(deltas[0].index, 2);
+  CHECK_EQ(deltas[0].distanceCm, 300);
+  CHECK_EQ(deltas[1].index, 7);
+
+  // The next window starts with the next change and carries only that spot
+  aggregator.markPublished();
+  CHECK(!aggregator.isDue(5000));
+  aggregator.record({7, false, 250, 200}, 6000);
+  CHECK(!aggregator.isDue(6499));
+  CHECK(aggregator.isDue(6500));
+  length = aggregator.encode(buffer, sizeof(buffer));
+  CHECK(PayloadCodec::decodeAggregate(buffer, length, bitmap, spots, timestamp, deltas, 10, count));
+  CHECK(bitmap == 0);
+  CHECK_EQ(count, 1);
+}
+
+typedef MqttSession<FakeTransport, MQTT_INFLIGHT_WINDOW, MQTT_PACKET_SIZE> Session;
+
+static const uint8_t LOT_SPOTS = 32;
+static const uint32_t BROKER_RTT_MS = 40;
+
+/// @brief What reached the broker in one burst
+struct Traffic {
+  size_t publishes;
+  size_t bytes;
+  size_t writes;
+  uint32_t lastAckMs;  // When the broker had acknowledged everything
+};
+
+/**
+ * An event ends and every spot of the lot frees up within 400 ms. The
+ * session runs over an in-memory transport; the broker side acknowledges
+ * each PUBLISH one round trip later and counts what arrived.
+ */
+static Traffic publishBurst(bool aggregated) {
+  FakeTransport transport;
+  Session session(transport, MQTT_RETRY_MS, MQTT_CONNECT_TIMEOUT_MS);
+  session.beginSession("client", "user", "pass", MQTT_KEEPALIVE_S, nullptr, 0);
+  transport.receive(connack(0));
+  session.loop(0);
+  transport.sent();
+  transport.writes = 0;
+
+  OccupancyAggregator<LOT_SPOTS> aggregator(AGGREGATE_WINDOW_MS);
+  std::vector<SensorUpdate> outbox;
+  std::vector<std::pair<uint32_t, uint16_t>> acks;
+  Traffic traffic = {};
+
+  for (uint32_t nowMs = 1; nowMs < 10000; nowMs++) {
+    if (nowMs % 12 == 0 && nowMs / 12 <= LOT_SPOTS) {
+      SensorUpdate update = {static_cast<uint8_t>(nowMs / 12 - 1), false, 250, 1700000000};
+      if (aggregated) {
+        aggregator.record(update, nowMs);
+      } else {
+        outbox.push_back(update);
+      }
+    }
+
+    // networkStep(): drain the outbox in order, then the aggregate when its window closes
+    while (!outbox.empty()) {
+      char topic[32];
+      snprintf(topic, sizeof(topic), "device/7/sensors/%u", static_cast<unsigned>(outbox.front().index));
+      uint8_t payload[PayloadCodec::SENSOR_UPDATE_SIZE];
+      size_t length = PayloadCodec::encode(outbox.front(), payload, sizeof(payload));
+      if (!session.publish(topic, payload, length, MQTT_PUBLISH_QOS, true, nowMs)) {
+        break;  // Window full; the rest waits for PUBACKs
+      }
+      outbox.erase(outbox.begin());
+    }
+    if (aggregator.isDue(nowMs)) {
+      uint8_t payload[OccupancyAggregator<LOT_SPOTS>::MAX_SIZE];
+      size_t length = aggregator.encode(payload, sizeof(payload));
+      if (session.publish("device/7/occupancy", payload, length, MQTT_PUBLISH_QOS, true, nowMs)) {
+        aggregator.markPublished();
+      }
+    }
+
+    for (const FakeTransport::Packet& packet : transport.sent()) {
+      if (packet.type == MqttPacket::PUBLISH) {
+        traffic.publishes++;
+        traffic.bytes += 2 + packet.body.size();
+        acks.push_back({nowMs + BROKER_RTT_MS, publishId(packet)});
+      }
+    }
+    while (!acks.empty() && nowMs >= acks.front().first) {
+      transport.receive(puback(acks.front().second));
+      acks.erase(acks.begin());
+      traffic.lastAckMs = nowMs;
+    }
+    session.loop(nowMs);
+  }
+  traffic.writes = transport.writes;
+  CHECK_EQ(session.getInflight(), 0);
+  return traffic;
+}
+
+// The aggregate carries a lot-wide burst in one PUBLISH where per-sensor topics need one per spot
+static void burstPacketCount() {
+  Traffic perSensor = publishBurst(false);
+  Traffic aggregated = publishBurst(true);
+
+  CHECK_EQ(perSensor.publishes, LOT_SPOTS);
+  CHECK(perSensor.writes >= LOT_SPOTS);
+  CHECK_EQ(aggregated.publishes, 1);
+  CHECK(aggregated.writes <= 2);  // The PUBLISH, and at most a PINGREQ
+  CHECK(aggregated.bytes < perSensor.bytes);
+  CHECK(aggregated.lastAckMs <= LOT_SPOTS * 12 + AGGREGATE_WINDOW_MS + BROKER_RTT_MS);
+  printf("burst of %u spots: per-sensor %lu PUBLISH, %lu bytes, %lu writes; aggregated %lu PUBLISH, %lu bytes, %lu writes\n",
+         static_cast<unsigned>(LOT_SPOTS), static_cast<unsigned long>(perSensor.publishes),
+         static_cast<unsigned long>(perSensor.bytes), static_cast<unsigned long>(perSensor.writes),
+         static_cast<unsigned long>(aggregated.publishes), static_cast<unsigned long>(aggregated.bytes),
+         static_cast<unsigned long>(aggregated.writes));
+}
+
+int main() {
+  aggregateRoundTrips();
+  rejectsOutOfRange();
+  coalescesWithinWindow();
+  burstPacketCount();
+  return Check::result();
+}
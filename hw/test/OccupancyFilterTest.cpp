@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <vector>
+#include "OccupancyFilter.h"
+#include "Config.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+typedef OccupancyFilter<OCCUPANCY_FILTER_WINDOW> Filter;
+
+static const uint32_t SAMPLE_MS = SENSOR_INTERVAL_MIN_MS;
+static const long LOST = -1;  // No echo
+
+/**
+ * Traces shaped like the output of a ceiling-mounted HC-SR04 over a spot,
+ * one sample per scan: a steady level with a few centimetres of jitter,
+ * plus the glitches seen in practice (lost echoes, single short
+ * reflections, people walking through). Built from segments with a fixed
+ * seed, so every run replays the same samples.
+ */
+struct Segment {
+  uint32_t durationMs;
+  long levelCm;
+  long jitterCm;
+};
+
+struct Glitch {
+  uint32_t atMs;
+  long valueCm;
+};
+
+static std::vector<long> makeTrace(std::initializer_list<Segment> segments, std::initializer_list<Glitch> glitches = {}) {
+  std::vector<long> samples;
+  uint32_t state = 12345;
+  for (const Segment& segment : segments) {
+    for (uint32_t t = 0; t < segment.durationMs; t += SAMPLE_MS) {
+      state = state * 1103515245 + 12345;
+      long jitter = segment.jitterCm ? static_cast<long>((state >> 16) % (2 * segment.jitterCm + 1)) - segment.jitterCm : 0;
+      samples.push_back(segment.levelCm + jitter);
+    }
+  }
+  for (const Glitch& glitch : glitches) {
+    size_t i = glitch.atMs / SAMPLE_MS;
+    if (i < samples.size()) {
+      samples[i] = glitch.valueCm;
+    }
+  }
+  return samples;
+}
+
+struct Replay {
+  std::vector<uint32_t> changesAtMs;  // Committed state changes
+  uint32_t rawChanges;                // What a single-sample threshold at enterCm would have published
+  bool finalState;
+};
+
+static Replay replay(const std::vector<long>& samples, Filter filter = Filter(DISTANCE_MIN_CM, DISTANCE_MAX_CM,
+                                                                              DISTANCE_EXIT_CM, OCCUPANCY_DWELL_MS)) {
+  Replay result = {};
+  bool state = false;
+  bool raw = false;
+  for (size_t i = 0; i < samples.size(); i++) {
+    uint32_t nowMs = i * SAMPLE_MS;
+    bool next = filter.update(samples[i], nowMs);
+    bool nextRaw = samples[i] >= DISTANCE_MIN_CM && samples[i] <= DISTANCE_MAX_CM;
+    if (i > 0 && next != state) {
+      result.changesAtMs.push_back(nowMs);
+    }
+    if (i > 0 && nextRaw != raw) {
+      result.rawChanges++;
+    }
+    state = next;
+    raw = nextRaw;
+  }
+  result.finalState = state;
+  return result;
+}
+
+// The sorted window always yields the true median of the last N samples
+static void medianMatchesSort() {
+  Filter filter(5, 50, 60, 0);
+  std::vector<uint16_t> history;
+  uint32_t state = 1;
+  for (int i = 0; i < 5000; i++) {
+    state = state * 1103515245 + 12345;
+    long sample = static_cast<long>((state >> 16) % 300) - 20;  // Includes lost and too-close readings
+    filter.update(sample, i);
+    history.push_back(sample < 5 ? Filter::NO_ECHO : sample);
+    if (history.size() == 1) {
+      history.assign(OCCUPANCY_FILTER_WINDOW, history[0]);  // The first sample seeds the window
+    }
+
+    std::vector<uint16_t> window(history.end() - OCCUPANCY_FILTER_WINDOW, history.end());
+    std::sort(window.begin(), window.end());
+    if (filter.getMedian() != window[OCCUPANCY_FILTER_WINDOW / 2]) {
+      CHECK_EQ(filter.getMedian(), window[OCCUPANCY_FILTER_WINDOW / 2]);
+      return;
+    }
+  }
+}
+
+// Empty floor with jitter, lost echoes and single short reflections: never occupied
+static void noisyEmptySpotStaysFree() {
+  std::vector<long> trace = makeTrace({{60000, 250, 4}},
+                                      {{3000, LOST}, {7250, 30}, {12000, LOST}, {12250, LOST}, {20000, 45},
+                                       {33000, 2}, {41000, 48}, {41500, 44}});
+  Replay result = replay(trace);
+  CHECK_EQ(result.changesAtMs.size(), 0);
+  CHECK(!result.finalState);
+  CHECK(result.rawChanges >= 8);
+}
+
+// A car pulls in at 10 s: one change, after the median turns and the dwell passes
+static void arrivalCommitsOnce() {
+  std::vector<long> trace = makeTrace({{10000, 250, 4}, {2000, 80, 20}, {30000, 38, 3}},
+                                      {{20000, LOST}, {25000, 250}});
+  Replay result = replay(trace);
+  CHECK_EQ(result.changesAtMs.size(), 1);
+  CHECK(result.finalState);
+  if (result.changesAtMs.size() == 1) {
+    // Below enterCm from 12 s on; the median follows within half a window, then the dwell
+    uint32_t earliest = 12000 + OCCUPANCY_DWELL_MS;
+    uint32_t latest = earliest + (OCCUPANCY_FILTER_WINDOW / 2 + 1) * SAMPLE_MS;
+    CHECK(result.changesAtMs[0] >= earliest);
+    CHECK(result.changesAtMs[0] <= latest);
+  }
+}
+
+// A high vehicle parked right at the threshold: hysteresis holds it occupied
+static void thresholdFlutterHeldByHysteresis() {
+  std::vector<long> trace = makeTrace({{5000, 250, 4}, {40000, 50, 6}});
+  Replay result = replay(trace);
+  CHECK_EQ(result.changesAtMs.size(), 1);
+  CHECK(result.finalState);
+  CHECK(result.rawChanges >= 20);
+}
+
+// Someone walks under the sensor for a second: the median may turn, the dwell keeps it
+static void passerByIgnored() {
+  std::vector<long> trace = makeTrace({{10000, 250, 4}, {1250, 40, 10}, {10000, 250, 4}});
+  Replay result = replay(trace);
+  CHECK_EQ(result.changesAtMs.size(), 0);
+  CHECK(!result.finalState);
+}
+
+// Leaving: one change back, with lost echoes while the car pulls out
+static void departureCommitsOnce() {
+  std::vector<long> trace = makeTrace({{20000, 40, 3}, {1500, 120, 60}, {20000, 250, 4}},
+                                      {{20250, LOST}, {20750, LOST}, {30000, 35}});
+  Replay result = replay(trace);
+  CHECK_EQ(result.changesAtMs.size(), 1);  // The first sample seeds it occupied
+  CHECK(!result.finalState);
+  if (result.changesAtMs.size() == 1) {
+    CHECK(result.changesAtMs[0] >= 20000 + OCCUPANCY_DWELL_MS);
+    CHECK(result.changesAtMs[0] <= 21500 + OCCUPANCY_DWELL_MS + (OCCUPANCY_FILTER_WINDOW / 2 + 1) * SAMPLE_MS);
+  }
+}
+
+// Dwell: the candidate must hold without a break; a break restarts it
+static void dwellRestartsOnBreak() {
+  Filter filter(5, 50, 60, 1000);
+  CHECK(!filter.update(200, 0));
+  uint32_t t = 0;
+  for (int i = 0; i < 3; i++) {
+    filter.update(30, t += 250);
+  }
+  CHECK(filter.isSettling());
+  for (int i = 0; i < 3; i++) {
+    filter.update(200, t += 250);  // Median back above: candidate dropped
+  }
+  CHECK(!filter.isSettling());
+  CHECK(!filter.isOccupied());
+
+  for (int i = 0; i < 3; i++) {
+    filter.update(30, t += 250);
+  }
+  uint32_t since = t;
+  while (!filter.update(30, t += 250)) {
+    CHECK(t - since < 1000 + 250);
+  }
+  CHECK(t - since >= 1000);
+}
+
+// The first sample sets the state without dwell; the window starts full of it
+static void firstSampleSeeds() {
+  Filter occupied(5, 50, 60, 2000);
+  CHECK(occupied.update(30, 0));
+  CHECK_EQ(occupied.getMedian(), 30);
+
+  Filter lost(5, 50, 60, 2000);
+  CHECK(!lost.update(LOST, 0));
+  CHECK_EQ(lost.getMedian(), Filter::NO_ECHO);
+}
+
+// New thresholds apply from the next sample; the dwell still applies
+static void retuneThresholds() {
+  Filter filter(5, 50, 60, 500);
+  uint32_t t = 0;
+  for (int i = 0; i < 5; i++) {
+    filter.update(80, t += 250);
+  }
+  CHECK(!filter.isOccupied());
+  filter.setThresholds(5, 90, 100);
+  filter.update(80, t += 250);
+  CHECK(filter.isSettling());
+  filter.update(80, t += 250);
+  filter.update(80, t += 250);
+  CHECK(filter.isOccupied());
+}
+
+int main() {
+  medianMatchesSort();
+  noisyEmptySpotStaysFree();
+  arrivalCommitsOnce();
+  thresholdFlutterHeldByHysteresis();
+  passerByIgnored();
+  departureCommitsOnce();
+  dwellRestartsOnBreak();
+  firstSampleSeeds();
+  retuneThresholds();
+  return Check::result();
+}
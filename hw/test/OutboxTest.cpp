@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include "FileLog.h"
+#include "Outbox.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+// Created in the working directory, which ctest sets to the build directory
+static const char* LOG_PATH = "OutboxTest.log";
+
+typedef Outbox<4, FileLog> SmallOutbox;
+
+static SensorUpdate transition(uint8_t index, uint32_t timestamp) {
+  return {index, timestamp % 2 == 1, static_cast<uint16_t>(100 + index), timestamp};
+}
+
+// Pop everything, checking each entry against the expected timestamps in order
+static void expectDrain(SmallOutbox& outbox, const uint32_t* timestamps, size_t count) {
+  SensorUpdate update;
+  for (size_t i = 0; i < count; i++) {
+    if (!outbox.peek(update)) {
+      CHECK_EQ(i, count);
+      return;
+    }
+    CHECK_EQ(update.timestamp, timestamps[i]);
+    outbox.pop();
+  }
+  CHECK(!outbox.peek(update));
+  CHECK(outbox.isEmpty());
+}
+
+// The on-flash record format, written directly to stage torn and corrupt logs
+static void appendRecord(FileLog& log, const SensorUpdate& update, size_t keep = SmallOutbox::RECORD_SIZE) {
+  uint8_t record[SmallOutbox::RECORD_SIZE];
+  record[0] = SmallOutbox::MAGIC;
+  PayloadCodec::encode(update, record + 1, PayloadCodec::SENSOR_UPDATE_SIZE);
+  record[SmallOutbox::RECORD_SIZE - 1] = SmallOutbox::crc8(record + 1, PayloadCodec::SENSOR_UPDATE_SIZE);
+  log.append(record, keep);
+}
+
+static void ramFifo() {
+  remove(LOG_PATH);
+  FileLog log(LOG_PATH);
+  SmallOutbox outbox(log, 1024);
+  for (uint32_t t = 1; t <= 3; t++) {
+    CHECK(outbox.push(transition(0, t)));
+  }
+  CHECK_EQ(outbox.getRamCount(), 3);
+  CHECK_EQ(log.size(), 0);
+  const uint32_t expected[] = {1, 2, 3};
+  expectDrain(outbox, expected, 3);
+}
+
+// Past the RAM ring, transitions go to flash; order is kept across both
+static void spillsToFlashInOrder() {
+  remove(LOG_PATH);
+  FileLog log(LOG_PATH);
+  SmallOutbox outbox(log, 1024);
+  for (uint32_t t = 1; t <= 10; t++) {
+    CHECK(outbox.push(transition(t % 3, t)));
+  }
+  CHECK_EQ(outbox.getRamCount(), 4);
+  CHECK_EQ(log.size(), 6 * SmallOutbox::RECORD_SIZE);
+
+  // Room in RAM again, but older entries are still on flash: a new one queues behind them
+  SensorUpdate update;
+  outbox.peek(update);
+  outbox.pop();
+  CHECK(outbox.push(transition(1, 11)));
+  CHECK_EQ(log.size(), 7 * SmallOutbox::RECORD_SIZE);
+
+  const uint32_t expected[] = {2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+  expectDrain(outbox, expected, 10);
+  CHECK_EQ(log.size(), 0);  // Cleared once every record was handed out
+}
+
+// Torn and corrupt records are skipped and the reader picks up the next valid one
+static void resynchronizesAfterDamage() {
+  remove(LOG_PATH);
+  FileLog log(LOG_PATH);
+  appendRecord(log, transition(0, 1));
+  appendRecord(log, transition(1, 2), 5);  // Torn by a power loss
+  appendRecord(log, transition(2, 3));
+  const uint8_t noise[] = {0xA5, 0x00, SmallOutbox::MAGIC, 0x13, 0x37};
+  log.append(noise, sizeof(noise));
+  appendRecord(log, transition(3, 4));
+
+  // Flipped payload bit: the CRC no longer matches
+  uint8_t record[SmallOutbox::RECORD_SIZE];
+  record[0] = SmallOutbox::MAGIC;
+  PayloadCodec::encode(transition(4, 5), record + 1, PayloadCodec::SENSOR_UPDATE_SIZE);
+  record[SmallOutbox::RECORD_SIZE - 1] = SmallOutbox::crc8(record + 1, PayloadCodec::SENSOR_UPDATE_SIZE);
+  record[3] ^= 0x10;
+  log.append(record, sizeof(record));
+
+  appendRecord(log, transition(5, 6));
+  appendRecord(log, transition(6, 7));
+  appendRecord(log, transition(7, 8), 9);  // Torn tail
+
+  // A fresh outbox after the reboot replays the log
+  SmallOutbox outbox(log, 1024);
+  const uint32_t expected[] = {1, 3, 4, 6, 7};
+  expectDrain(outbox, expected, 5);
+  CHECK_EQ(log.size(), 0);
+}
+
+// A log holding nothing but a torn record is dropped
+static void clearsTornTail() {
+  remove(LOG_PATH);
+  FileLog log(LOG_PATH);
+  appendRecord(log, transition(0, 1), 7);
+  SmallOutbox outbox(log, 1024);
+  CHECK(!outbox.isEmpty());  // Not read yet
+  SensorUpdate update;
+  CHECK(!outbox.peek(update));
+  CHECK(outbox.isEmpty());
+  CHECK_EQ(log.size(), 0);
+}
+
+// Beyond the flash budget transitions are dropped and counted
+static void respectsBudget() {
+  remove(LOG_PATH);
+  FileLog log(LOG_PATH);
+  SmallOutbox outbox(log, 2 * SmallOutbox::RECORD_SIZE);
+  for (uint32_t t = 1; t <= 8; t++) {
+    bool accepted = outbox.push(transition(0, t));
+    CHECK_EQ(accepted, t <= 6);
+  }
+  CHECK_EQ(outbox.getDropped(), 2);
+  const uint32_t expected[] = {1, 2, 3, 4, 5, 6};
+  expectDrain(outbox, expected, 6);
+}
+
+static void crcMatchesReference() {
+  // CRC-8, polynomial 0x07, initial value 0: check value of "123456789"
+  const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+  CHECK_EQ(SmallOutbox::crc8(check, sizeof(check)), 0xF4);
+}
+
+int main() {
+  ramFifo();
+  spillsToFlashInOrder();
+  resynchronizesAfterDamage();
+  clearsTornTail();
+  respectsBudget();
+  crcMatchesReference();
+  remove(LOG_PATH);
+  return Check::result();
+}
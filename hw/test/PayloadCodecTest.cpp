@@ -0,0 +1,56 @@
+#include <string.h>
+#include "PayloadCodec.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+static bool sameUpdate(const SensorUpdate& a, const SensorUpdate& b) {
+  return a.index == b.index && a.occupied == b.occupied && a.distanceCm == b.distanceCm && a.timestamp == b.timestamp;
+}
+
+static void roundTrips() {
+  const SensorUpdate cases[] = {
+    {0, false, 0, 0},
+    {3, true, 42, 1700000000},
+    {255, true, PayloadCodec::NO_DISTANCE, 0xFFFFFFFF},
+    {17, false, 400, 1},
+  };
+  for (const SensorUpdate& update : cases) {
+    uint8_t buffer[PayloadCodec::SENSOR_UPDATE_SIZE];
+    CHECK_EQ(PayloadCodec::encode(update, buffer, sizeof(buffer)), PayloadCodec::SENSOR_UPDATE_SIZE);
+    SensorUpdate decoded = {};
+    CHECK(PayloadCodec::decode(buffer, sizeof(buffer), decoded));
+    CHECK(sameUpdate(decoded, update));
+  }
+}
+
+// The documented little-endian layout, byte for byte
+static void layout() {
+  SensorUpdate update = {5, true, 0x1234, 0xA1B2C3D4};
+  uint8_t buffer[PayloadCodec::SENSOR_UPDATE_SIZE];
+  PayloadCodec::encode(update, buffer, sizeof(buffer));
+  const uint8_t expected[] = {PayloadCodec::VERSION, 5, PayloadCodec::FLAG_OCCUPIED, 0x34, 0x12, 0xD4, 0xC3, 0xB2, 0xA1};
+  CHECK(memcmp(buffer, expected, sizeof(expected)) == 0);
+  CHECK(buffer[0] != '{');  // Never mistaken for a JSON payload
+}
+
+static void rejectsBadInput() {
+  SensorUpdate update = {1, true, 100, 1000};
+  uint8_t buffer[PayloadCodec::SENSOR_UPDATE_SIZE];
+  CHECK_EQ(PayloadCodec::encode(update, buffer, sizeof(buffer) - 1), 0);
+
+  PayloadCodec::encode(update, buffer, sizeof(buffer));
+  SensorUpdate decoded;
+  CHECK(!PayloadCodec::decode(buffer, sizeof(buffer) - 1, decoded));
+  buffer[0] = PayloadCodec::VERSION + 1;
+  CHECK(!PayloadCodec::decode(buffer, sizeof(buffer), decoded));
+  const uint8_t json[] = "{\"index\":1,\"is_occupied\":true}";
+  CHECK(!PayloadCodec::decode(json, sizeof(json) - 1, decoded));
+}
+
+int main() {
+  roundTrips();
+  layout();
+  rejectsBadInput();
+  return Check::result();
+}
@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "MqttSession.h"
+#include "Config.h"
+#include "Check.h"
+#include "FakeTransport.h"
+
+using namespace FindSpot;
+
+typedef MqttSession<FakeTransport, MQTT_INFLIGHT_WINDOW, MQTT_PACKET_SIZE> Session;
+
+static const uint32_t STEP_MS = 10;        // One pass of the networking task
+static const uint32_t BROKER_RTT_MS = 40;  // A PUBACK comes this long after its PUBLISH
+static const uint32_t MESSAGES = 1000;
+
+/// @brief Result of publishing MESSAGES transitions through a lossy broker
+struct Run {
+  uint32_t elapsedMs = 0;
+  uint32_t delivered = 0;   // Distinct messages the broker received
+  uint32_t duplicates = 0;  // Copies of a message it already had
+  uint32_t retransmits = 0;
+  size_t maxInflight = 0;
+  bool earlyResend = false;  // A DUP came back before MQTT_RETRY_MS
+  bool stayedConnected = true;
+
+  double perSecond() const {
+    return elapsedMs ? delivered * 1000.0 / elapsedMs : 0;
+  }
+};
+
+/**
+ * In-process broker stand-in: it reads what the session wrote, loses each
+ * PUBLISH and each PUBACK with probability `lossPercent`, and otherwise
+ * acknowledges after a round trip. The loss is seeded, so every run
+ * replays the same drops; the connection itself never fails, as on a TCP
+ * link where a stalled segment holds up the acknowledgement.
+ */
+class LossyBroker {
+public:
+  LossyBroker(FakeTransport& transport, uint32_t lossPercent, uint32_t seed)
+    : transport(transport), lossPercent(lossPercent), state(seed) {}
+
+  void step(uint32_t nowMs, Run& run) {
+    for (FakeTransport::Packet& packet : transport.sent()) {
+      if (packet.type != MqttPacket::PUBLISH) {
+        continue;
+      }
+      uint16_t id = publishId(packet);
+      if (packet.flags & MqttPacket::FLAG_DUP) {
+        std::map<uint16_t, uint32_t>::iterator last = lastSentMs.find(id);
+        run.earlyResend |= last == lastSentMs.end() || nowMs - last->second < MQTT_RETRY_MS;
+      }
+      lastSentMs[id] = nowMs;
+      if (lost()) {
+        continue;
+      }
+      MqttPacket::Publish message;
+      if (!MqttPacket::parsePublish(packet.flags, packet.body.data(), packet.body.size(), message)) {
+        continue;
+      }
+      uint32_t sequence = strtoul(std::string(reinterpret_cast<const char*>(message.payload), message.length).c_str(), nullptr, 10);
+      if (received.insert(sequence).second) {
+        run.delivered++;
+      } else {
+        run.duplicates++;
+      }
+      if (!lost()) {
+        acks.push_back({nowMs + BROKER_RTT_MS, id});
+      }
+    }
+    while (!acks.empty() && nowMs >= acks.front().atMs) {
+      transport.receive(puback(acks.front().packetId));
+      acks.erase(acks.begin());
+    }
+  }
+
+private:
+  struct Ack {
+    uint32_t atMs;
+    uint16_t packetId;
+  };
+
+  FakeTransport& transport;
+  uint32_t lossPercent;
+  uint32_t state;
+  std::set<uint32_t> received;
+  std::map<uint16_t, uint32_t> lastSentMs;
+  std::vector<Ack> acks;
+
+  /// @brief xorshift32, so every run replays the same losses
+  bool lost() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state % 100 < lossPercent;
+  }
+};
+
+/// @brief Publish MESSAGES transitions as fast as the window allows, one pass every STEP_MS
+static Run publishAll(uint32_t lossPercent) {
+  FakeTransport transport;
+  Session session(transport, MQTT_RETRY_MS, MQTT_CONNECT_TIMEOUT_MS);
+  LossyBroker broker(transport, lossPercent, 0x2545f491);
+  Run run;
+
+  CHECK(session.beginSession("client", "user", "pass", 0, nullptr, 0));
+  transport.receive(connack(0));
+  uint32_t next = 0;
+  uint32_t nowMs = 0;
+  for (; run.delivered < MESSAGES && nowMs < 3600000; nowMs += STEP_MS) {
+    broker.step(nowMs, run);
+    session.loop(nowMs);
+    run.stayedConnected &= session.connected();
+    while (next < MESSAGES) {
+      char payload[12];
+      int n = snprintf(payload, sizeof(payload), "%lu", static_cast<unsigned long>(next));
+      if (!session.publish("device/1/sensors/spot", reinterpret_cast<const uint8_t*>(payload), n, 1, false, nowMs)) {
+        break;  // Window full; the loop goes on and tries again next pass
+      }
+      next++;
+    }
+    if (session.getInflight() > run.maxInflight) {
+      run.maxInflight = session.getInflight();
+    }
+  }
+  run.elapsedMs = nowMs;
+  run.retransmits = session.getStats().retransmits;
+  return run;
+}
+
+static void check(const Run& run) {
+  CHECK_EQ(run.delivered, MESSAGES);
+  CHECK(run.stayedConnected);
+  CHECK_EQ(run.maxInflight, MQTT_INFLIGHT_WINDOW);
+  CHECK(!run.earlyResend);
+}
+
+// Without loss every message is acknowledged on the first try and the window keeps the link busy
+static void losslessDelivery() {
+  Run run = publishAll(0);
+  check(run);
+  CHECK_EQ(run.retransmits, 0);
+  CHECK_EQ(run.duplicates, 0);
+  // Each slot turns over once per round trip plus a pass on either side
+  CHECK(run.perSecond() >= MQTT_INFLIGHT_WINDOW * 1000.0 / (BROKER_RTT_MS + 2 * STEP_MS));
+}
+
+// Lost publishes and acknowledgements are made good by the retransmit timer, and a lost
+// PUBACK shows up at the broker as a duplicate, as QoS 1 allows
+static void lossyDelivery() {
+  Run clean = publishAll(0);
+  double previous = clean.perSecond();
+  printf("QoS 1, window %d, %lu ms RTT, retry after %lu ms:\n", MQTT_INFLIGHT_WINDOW,
+         static_cast<unsigned long>(BROKER_RTT_MS), static_cast<unsigned long>(MQTT_RETRY_MS));
+  printf("  %2d%% loss: %7.1f delivered/s, %4lu retransmits, %4lu duplicates\n", 0, previous, 0UL, 0UL);
+
+  for (uint32_t lossPercent : {5u, 20u}) {
+    Run run = publishAll(lossPercent);
+    check(run);
+    CHECK(run.retransmits > 0);
+    CHECK(run.duplicates > 0);
+    CHECK(run.duplicates <= run.retransmits);
+    CHECK(run.perSecond() < previous);
+    previous = run.perSecond();
+    printf("  %2lu%% loss: %7.1f delivered/s, %4lu retransmits, %4lu duplicates\n",
+           static_cast<unsigned long>(lossPercent), run.perSecond(), static_cast<unsigned long>(run.retransmits),
+           static_cast<unsigned long>(run.duplicates));
+  }
+}
+
+int main() {
+  losslessDelivery();
+  lossyDelivery();
+  return Check::result();
+}
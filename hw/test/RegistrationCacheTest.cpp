@@ -0,0 +1,176 @@
+#include <stddef.h>
+#include "RegistrationCache.h"
+#include "Check.h"
+#include "MemoryStorage.h"
+
+using namespace FindSpot;
+
+typedef RegistrationCache<MemoryStorage> Cache;
+
+static const size_t BLOB_SIZE = 1 + sizeof(CachedRegistration);
+
+// Built the way main.ino's makeRegistrationToken() chains the inputs
+static uint32_t tokenFor(const char* mac, const char* host, const char* port) {
+  uint32_t token = Cache::fingerprint(mac);
+  token = Cache::fingerprint(host, token);
+  token = Cache::fingerprint(port, token);
+  token = Cache::fingerprint("esp32", token);
+  return Cache::fingerprint("json", token);
+}
+
+static CachedRegistration makeEntry(uint32_t token) {
+  CachedRegistration entry = {};
+  entry.token = token;
+  entry.deviceId = 17;
+  entry.mqttPort = 1883;
+  entry.payloadFormat = 1;
+  CachedRegistration::copyField(entry.mqttUsername, "device_17");
+  CachedRegistration::copyField(entry.mqttPassword, "s3cret");
+  CachedRegistration::copyField(entry.mqttBroker, "broker.local");
+  CachedRegistration::copyField(entry.sensorTopic, "device/17/sensors");
+  return entry;
+}
+
+/// @brief Overwrite `size` bytes of the stored entry at `offset`
+static void corrupt(MemoryStorage& storage, size_t offset, const void* bytes, size_t size) {
+  memcpy(storage.data + 1 + offset, bytes, size);
+}
+
+// FNV-1a over each input and its terminator (FNV test vectors "" + NUL and "a" + NUL)
+static void fingerprintVectors() {
+  CHECK_EQ(Cache::fingerprint(""), 0x050c5d1fUL);
+  CHECK_EQ(Cache::fingerprint("a"), 0x2b24d044UL);
+  CHECK(Cache::fingerprint("b") != Cache::fingerprint("a"));
+}
+
+// Moving a character from one input to the next changes the token
+static void fingerprintSeparatesInputs() {
+  const char* mac = "24:0A:C4:01:02:03";
+  CHECK(tokenFor(mac, "10.0.0.1", "80") != tokenFor(mac, "10.0.0.18", "0"));
+  CHECK(tokenFor(mac, "backend", "5000") != tokenFor(mac, "backend5", "000"));
+  CHECK(Cache::fingerprint("", Cache::fingerprint("ab")) != Cache::fingerprint("b", Cache::fingerprint("a")));
+}
+
+static void roundTrip() {
+  MemoryStorage storage;
+  Cache cache(storage);
+  uint32_t token = tokenFor("24:0A:C4:01:02:03", "backend", "5000");
+  CachedRegistration entry = makeEntry(token);
+  CHECK(cache.save(entry));
+  CHECK_EQ(storage.length, BLOB_SIZE);
+  CHECK_EQ(storage.data[0], CachedRegistration::VERSION);
+
+  CachedRegistration loaded = {};
+  CHECK(cache.load(token, loaded));
+  CHECK(loaded == entry);
+  CHECK_STR(loaded.mqttBroker, "broker.local");
+  CHECK_EQ(loaded.mqttPort, 1883);
+}
+
+// Another board, backend or payload format: the entry is there but not used
+static void tokenMismatchIgnored() {
+  MemoryStorage storage;
+  Cache cache(storage);
+  uint32_t token = tokenFor("24:0A:C4:01:02:03", "backend", "5000");
+  cache.save(makeEntry(token));
+
+  CachedRegistration loaded = makeEntry(0);
+  CHECK(!cache.load(tokenFor("24:0A:C4:01:02:04", "backend", "5000"), loaded));
+  CHECK(!cache.load(tokenFor("24:0A:C4:01:02:03", "backend2", "5000"), loaded));
+  CHECK(!cache.load(tokenFor("24:0A:C4:01:02:03", "backend", "5001"), loaded));
+  CHECK_EQ(loaded.token, 0);  // Left untouched
+  CHECK(cache.load(token, loaded));
+}
+
+// clear() leaves nothing loadable, and a save afterwards works again
+static void clearInvalidates() {
+  MemoryStorage storage;
+  Cache cache(storage);
+  uint32_t token = tokenFor("24:0A:C4:01:02:03", "backend", "5000");
+  cache.save(makeEntry(token));
+  CHECK(cache.clear());
+  CachedRegistration loaded;
+  CHECK(!cache.load(token, loaded));
+
+  cache.save(makeEntry(token));
+  CHECK(cache.load(token, loaded));
+
+  storage.failSave = true;
+  CHECK(!cache.clear());
+  CHECK(!cache.save(makeEntry(token)));
+}
+
+// Records from other firmware, cut short or damaged are never used
+static void corruptedRecordsRejected() {
+  uint32_t token = tokenFor("24:0A:C4:01:02:03", "backend", "5000");
+  MemoryStorage good;
+  Cache(good).save(makeEntry(token));
+  CachedRegistration loaded;
+
+  MemoryStorage empty;
+  CHECK(!Cache(empty).load(token, loaded));
+
+  MemoryStorage otherVersion = good;
+  otherVersion.data[0] = CachedRegistration::VERSION + 1;
+  CHECK(!Cache(otherVersion).load(token, loaded));
+
+  MemoryStorage truncated = good;
+  truncated.length = BLOB_SIZE - 1;
+  CHECK(!Cache(truncated).load(token, loaded));
+
+  MemoryStorage oversized = good;
+  oversized.length = BLOB_SIZE + 1;
+  CHECK(!Cache(oversized).load(token, loaded));
+
+  MemoryStorage unterminated = good;
+  char filled[REGISTRATION_FIELD_LEN];
+  memset(filled, 'x', sizeof(filled));
+  corrupt(unterminated, offsetof(CachedRegistration, sensorTopic), filled, sizeof(filled));
+  CHECK(!Cache(unterminated).load(token, loaded));
+
+  MemoryStorage noDevice = good;
+  int32_t deviceId = 0;
+  corrupt(noDevice, offsetof(CachedRegistration, deviceId), &deviceId, sizeof(deviceId));
+  CHECK(!Cache(noDevice).load(token, loaded));
+  deviceId = -5;
+  corrupt(noDevice, offsetof(CachedRegistration, deviceId), &deviceId, sizeof(deviceId));
+  CHECK(!Cache(noDevice).load(token, loaded));
+
+  MemoryStorage noPort = good;
+  uint16_t port = 0;
+  corrupt(noPort, offsetof(CachedRegistration, mqttPort), &port, sizeof(port));
+  CHECK(!Cache(noPort).load(token, loaded));
+
+  // A flipped bit in the token reads as another setup
+  MemoryStorage flipped = good;
+  flipped.data[1 + offsetof(CachedRegistration, token)] ^= 0x01;
+  CHECK(!Cache(flipped).load(token, loaded));
+
+  CHECK(Cache(good).load(token, loaded));
+}
+
+static void fieldsMustFit() {
+  CachedRegistration entry = {};
+  char longest[REGISTRATION_FIELD_LEN];
+  memset(longest, 'x', sizeof(longest) - 1);
+  longest[sizeof(longest) - 1] = '\0';
+  CHECK(CachedRegistration::copyField(entry.mqttBroker, longest));
+  CHECK_EQ(strlen(entry.mqttBroker), REGISTRATION_FIELD_LEN - 1);
+
+  char tooLong[REGISTRATION_FIELD_LEN + 1];
+  memset(tooLong, 'y', sizeof(tooLong) - 1);
+  tooLong[sizeof(tooLong) - 1] = '\0';
+  CHECK(!CachedRegistration::copyField(entry.mqttBroker, tooLong));
+  CHECK_STR(entry.mqttBroker, longest);  // Unchanged
+}
+
+int main() {
+  fingerprintVectors();
+  fingerprintSeparatesInputs();
+  roundTrip();
+  tokenMismatchIgnored();
+  clearInvalidates();
+  corruptedRecordsRejected();
+  fieldsMustFit();
+  return Check::result();
+}
@@ -0,0 +1,360 @@
+#include "RuntimeConfig.h"
+#include "Check.h"
+#include "MemoryStorage.h"
+
+using namespace FindSpot;
+
+typedef RuntimeConfig<MemoryStorage> Config;
+
+static const uint32_t MIN_PERIOD_MS = 250;
+static const Settings DEFAULTS = Settings::make(250, 8000, 5, 50, 60);
+
+static int listenerCalls = 0;
+static Settings lastPrevious;
+static Settings lastCurrent;
+
+static void recordChange(const Settings& previous, const Settings& current) {
+  listenerCalls++;
+  lastPrevious = previous;
+  lastCurrent = current;
+}
+
+static Config::Result applyText(Config& config, const char* text) {
+  return config.apply(text, strlen(text));
+}
+
+// make() takes the pins from SENSOR_TABLE, and the defaults are valid
+static void defaultsFromTable() {
+  MemoryStorage storage;
+  Config config(storage, DEFAULTS, MIN_PERIOD_MS);
+  for (size_t i = 0; i < SENSOR_COUNT; i++) {
+    CHECK_EQ(DEFAULTS.trigPin[i], SENSOR_TABLE[i].trigPin);
+    CHECK_EQ(DEFAULTS.echoPin[i], SENSOR_TABLE[i].echoPin);
+  }
+  CHECK(config.isValid(DEFAULTS));
+  CHECK(config.begin() == Config::Source::DEFAULTS);
+  CHECK(config.get() == DEFAULTS);
+}
+
+static void rejectsOutOfRange() {
+  MemoryStorage storage;
+  Config config(storage, DEFAULTS, MIN_PERIOD_MS);
+
+  Settings s = DEFAULTS;
+  s.sampleMinMs = MIN_PERIOD_MS - 1;  // Faster than one scan of all groups
+  CHECK(!config.isValid(s));
+
+  s = DEFAULTS;
+  s.sampleMaxMs = s.sampleMinMs - 1;
+  CHECK(!config.isValid(s));
+
+  s = DEFAULTS;
+  s.minCm = 0;
+  CHECK(!config.isValid(s));
+
+  s = DEFAULTS;
+  s.enterCm = s.minCm;
+  CHECK(!config.isValid(s));
+
+  s = DEFAULTS;
+  s.exitCm = s.enterCm - 1;
+  CHECK(!config.isValid(s));
+  s.exitCm = s.enterCm;  // No hysteresis is allowed
+  CHECK(config.isValid(s));
+
+  s = DEFAULTS;
+  s.exitCm = 401;
+  CHECK(!config.isValid(s));
+}
+
+static void rejectsBadPins() {
+  MemoryStorage storage;
+  Config config(storage, DEFAULTS, MIN_PERIOD_MS);
+
+  Settings s = DEFAULTS;
+  s.trigPin[0] = 34;  // Input-only
+  CHECK(!config.isValid(s));
+  s.echoPin[0] = 34;  // ... but fine as an echo
+  s.trigPin[0] = DEFAULTS.echoPin[0];
+  CHECK(config.isValid(s));
+
+  s = DEFAULTS;
+  s.echoPin[0] = 6;  // Flash
+  CHECK(!config.isValid(s));
+
+  s = DEFAULTS;
+  s.echoPin[0] = 40;
+  CHECK(!config.isValid(s));
+
+  s = DEFAULTS;
+  s.echoPin[0] = 3;  // UART0 RX: the console
+  CHECK(!config.isValid(s));
+  s.echoPin[0] = DEFAULTS.echoPin[0];
+  s.trigPin[0] = 1;  // UART0 TX
+  CHECK(!config.isValid(s));
+
+  s = DEFAULTS;
+  s.echoPin[0] = s.trigPin[0];
+  CHECK(!config.isValid(s));
+
+  s = DEFAULTS;
+  s.trigPin[1] = s.echoPin[0];  // Shared with another sensor
+  CHECK(!config.isValid(s));
+}
+
+// A change is saved, made current and reported; the same value again is not
+static void setSavesAndNotifies() {
+  MemoryStorage storage;
+  Config config(storage, DEFAULTS, MIN_PERIOD_MS);
+  config.begin();
+  config.setListener(recordChange);
+  listenerCalls = 0;
+
+  Settings s = DEFAULTS;
+  s.enterCm = 45;
+  CHECK(config.set(s) == Config::Result::APPLIED);
+  CHECK(config.get() == s);
+  CHECK_EQ(storage.saves, 1);
+  CHECK_EQ(listenerCalls, 1);
+  CHECK(lastPrevious == DEFAULTS);
+  CHECK(lastCurrent == s);
+
+  CHECK(config.set(s) == Config::Result::UNCHANGED);
+  CHECK_EQ(storage.saves, 1);
+  CHECK_EQ(listenerCalls, 1);
+}
+
+// Neither an invalid value nor a failed write changes anything
+static void failuresChangeNothing() {
+  MemoryStorage storage;
+  Config config(storage, DEFAULTS, MIN_PERIOD_MS);
+  config.begin();
+  config.setListener(recordChange);
+  listenerCalls = 0;
+
+  Settings s = DEFAULTS;
+  s.minCm = 0;
+  CHECK(config.set(s) == Config::Result::INVALID);
+  CHECK_EQ(storage.saves, 0);
+
+  storage.failSave = true;
+  s = DEFAULTS;
+  s.enterCm = 45;
+  CHECK(config.set(s) == Config::Result::NOT_SAVED);
+  CHECK(config.get() == DEFAULTS);
+  CHECK_EQ(listenerCalls, 0);
+  CHECK_EQ(storage.length, 0);
+}
+
+static void applyParsesPairs() {
+  MemoryStorage storage;
+  Config config(storage, DEFAULTS, MIN_PERIOD_MS);
+  config.begin();
+
+  CHECK(applyText(config, "enter_cm=45,trig1=13") == Config::Result::APPLIED);
+  CHECK_EQ(config.get().enterCm, 45);
+  CHECK_EQ(config.get().trigPin[1], 13);
+  CHECK_EQ(config.get().exitCm, DEFAULTS.exitCm);  // Keys not given are kept
+
+  // Every separator, and a length that stops before the NUL
+  CHECK(applyText(config, "min_ms=500&max_ms=4000; min_cm=10\r\n\texit_cm=70") == Config::Result::APPLIED);
+  CHECK_EQ(config.get().sampleMinMs, 500);
+  CHECK_EQ(config.get().sampleMaxMs, 4000);
+  CHECK_EQ(config.get().minCm, 10);
+  CHECK_EQ(config.get().exitCm, 70);
+  CHECK(config.apply("enter_cm=46,garbage", 11) == Config::Result::APPLIED);
+  CHECK_EQ(config.get().enterCm, 46);
+
+  CHECK(applyText(config, "") == Config::Result::UNCHANGED);
+  CHECK(applyText(config, "enter_cm=46") == Config::Result::UNCHANGED);
+}
+
+// Nothing of a malformed update is applied, not even its valid pairs
+static void applyRejectsMalformed() {
+  MemoryStorage storage;
+  Config config(storage, DEFAULTS, MIN_PERIOD_MS);
+  config.begin();
+
+  const char* malformed[] = {
+    "enter_cm=45,bogus=1",
+    "enter_cm=45,exit_cm",
+    "enter_cm=",
+    "enter_cm=4x5",
+    "enter_cm=-5",
+    "enter_cm=65536",       // Wider than the field
+    "trig0=256",
+    "min_ms=4294967296",    // Wider than 32 bits
+    "trig=22",
+    "trig9=22",             // No such sensor
+    "trig0x=22",
+    "ENTER_CM=45",
+  };
+  for (const char* text : malformed) {
+    if (applyText(config, text) != Config::Result::BAD_FORMAT) {
+      printf("accepted \"%s\"\n", text);
+      CHECK(false);
+    }
+  }
+  CHECK(config.get() == DEFAULTS);
+  CHECK_EQ(storage.saves, 0);
+
+  // Well-formed but out of range
+  CHECK(applyText(config, "enter_cm=45,exit_cm=40") == Config::Result::INVALID);
+  CHECK(config.get() == DEFAULTS);
+}
+
+// What set() saved is what the next boot loads
+static void persistsAcrossBoots() {
+  MemoryStorage storage;
+  Settings changed;
+  {
+    Config config(storage, DEFAULTS, MIN_PERIOD_MS);
+    config.begin();
+    CHECK(applyText(config, "enter_cm=40,echo2=35") == Config::Result::APPLIED);
+    changed = config.get();
+  }
+
+  Config config(storage, DEFAULTS, MIN_PERIOD_MS);
+  CHECK(config.begin() == Config::Source::STORED);
+  CHECK(config.get() == changed);
+  CHECK(config.getDefaults() == DEFAULTS);
+}
+
+// A blob that does not fit or no longer validates falls back to the defaults
+static void unusableBlobsFallBack() {
+  MemoryStorage storage;
+  {
+    Config config(storage, DEFAULTS, MIN_PERIOD_MS);
+    config.begin();
+    applyText(config, "enter_cm=40");
+  }
+
+  MemoryStorage newerVersion = storage;
+  newerVersion.data[0] = Settings::VERSION + 1;
+  Config fromNewer(newerVersion, DEFAULTS, MIN_PERIOD_MS);
+  CHECK(fromNewer.begin() == Config::Source::DEFAULTS);
+  CHECK(fromNewer.get() == DEFAULTS);
+
+  MemoryStorage unversioned = storage;
+  unversioned.data[0] = 0;
+  unversioned.length = 5;
+  Config fromUnversioned(unversioned, DEFAULTS, MIN_PERIOD_MS);
+  CHECK(fromUnversioned.begin() == Config::Source::DEFAULTS);
+
+  // The spot count must account for the length exactly
+  MemoryStorage truncated = storage;
+  truncated.length--;
+  Config fromTruncated(truncated, DEFAULTS, MIN_PERIOD_MS);
+  CHECK(fromTruncated.begin() == Config::Source::DEFAULTS);
+  CHECK(fromTruncated.get() == DEFAULTS);
+
+  MemoryStorage miscounted = storage;
+  miscounted.data[15]++;
+  Config fromMiscounted(miscounted, DEFAULTS, MIN_PERIOD_MS);
+  CHECK(fromMiscounted.begin() == Config::Source::DEFAULTS);
+
+  // Valid when saved, but the firmware now needs a longer scan period
+  Config slower(storage, DEFAULTS, 1000);
+  CHECK(slower.begin() == Config::Source::DEFAULTS);
+  CHECK(slower.get() == DEFAULTS);
+}
+
+// Field by field, little-endian, each spot keyed by its table pins
+static void storedLayout() {
+  MemoryStorage storage;
+  Config config(storage, DEFAULTS, MIN_PERIOD_MS);
+  config.begin();
+  CHECK(applyText(config, "min_ms=300,max_ms=70000,min_cm=6,enter_cm=258,exit_cm=300,trig1=13") == Config::Result::APPLIED);
+
+  const uint8_t header[] = {Settings::VERSION,
+                            0x2C, 0x01, 0x00, 0x00,  // 300
+                            0x70, 0x11, 0x01, 0x00,  // 70000
+                            0x06, 0x00, 0x02, 0x01, 0x2C, 0x01,
+                            SENSOR_COUNT};
+  CHECK_EQ(storage.length, sizeof(header) + SENSOR_COUNT * 5);
+  CHECK(memcmp(storage.data, header, sizeof(header)) == 0);
+  for (size_t i = 0; i < SENSOR_COUNT; i++) {
+    const uint8_t* spot = storage.data + sizeof(header) + i * 5;
+    CHECK_EQ(spot[0], i);
+    CHECK_EQ(spot[1], SENSOR_TABLE[i].trigPin);
+    CHECK_EQ(spot[2], SENSOR_TABLE[i].echoPin);
+    CHECK_EQ(spot[3], i == 1 ? 13 : SENSOR_TABLE[i].trigPin);
+    CHECK_EQ(spot[4], SENSOR_TABLE[i].echoPin);
+  }
+}
+
+// A reflash that rewired a spot in SENSOR_TABLE: that spot's stored pins give way to the table
+static void tableChangeDropsStalePins() {
+  MemoryStorage storage;
+  {
+    Config config(storage, DEFAULTS, MIN_PERIOD_MS);
+    config.begin();
+    CHECK(applyText(config, "enter_cm=40,trig1=13,echo2=35") == Config::Result::APPLIED);
+  }
+
+  // As saved by a firmware whose table had other pins for spot 2
+  uint8_t* spot2 = storage.data + 16 + 2 * 5;
+  spot2[1] = 4;
+  spot2[2] = 5;
+  Config config(storage, DEFAULTS, MIN_PERIOD_MS);
+  CHECK(config.begin() == Config::Source::MIGRATED);
+  CHECK_EQ(config.get().enterCm, 40);
+  CHECK_EQ(config.get().trigPin[1], 13);
+  CHECK_EQ(config.get().echoPin[2], SENSOR_TABLE[2].echoPin);
+
+  // ... or saved with spots this table no longer has
+  MemoryStorage larger;
+  memcpy(larger.data, storage.data, storage.length);
+  const uint8_t extra[] = {SENSOR_COUNT, 25, 26, 25, 26};
+  memcpy(larger.data + storage.length, extra, sizeof(extra));
+  larger.data[15] = SENSOR_COUNT + 1;
+  larger.length = storage.length + sizeof(extra);
+  Config fromLarger(larger, DEFAULTS, MIN_PERIOD_MS);
+  CHECK(fromLarger.begin() == Config::Source::MIGRATED);
+  CHECK_EQ(fromLarger.get().trigPin[1], 13);
+}
+
+// Version 1 stored the raw struct: its thresholds and intervals are kept, its pins are not
+static void migratesRawStruct() {
+  MemoryStorage storage;
+  const uint8_t legacy[] = {1,
+                            0xF4, 0x01, 0x00, 0x00,  // 500
+                            0xA0, 0x0F, 0x00, 0x00,  // 4000
+                            0x05, 0x00, 0x2D, 0x00, 0x37, 0x00,
+                            4, 14, 33, 5, 12, 32};   // Pins of a three-spot table
+  memcpy(storage.data, legacy, sizeof(legacy));
+  storage.length = sizeof(legacy);
+
+  Config config(storage, DEFAULTS, MIN_PERIOD_MS);
+  CHECK(config.begin() == Config::Source::MIGRATED);
+  CHECK_EQ(config.get().sampleMinMs, 500);
+  CHECK_EQ(config.get().sampleMaxMs, 4000);
+  CHECK_EQ(config.get().enterCm, 45);
+  CHECK_EQ(config.get().exitCm, 55);
+  for (size_t i = 0; i < SENSOR_COUNT; i++) {
+    CHECK(config.get().samePins(DEFAULTS, i));
+  }
+
+  // The next change saves the current layout
+  CHECK(applyText(config, "enter_cm=46") == Config::Result::APPLIED);
+  CHECK_EQ(storage.data[0], Settings::VERSION);
+  Config reloaded(storage, DEFAULTS, MIN_PERIOD_MS);
+  CHECK(reloaded.begin() == Config::Source::STORED);
+  CHECK_EQ(reloaded.get().sampleMinMs, 500);
+}
+
+int main() {
+  defaultsFromTable();
+  rejectsOutOfRange();
+  rejectsBadPins();
+  setSavesAndNotifies();
+  failuresChangeNothing();
+  applyParsesPairs();
+  applyRejectsMalformed();
+  persistsAcrossBoots();
+  unusableBlobsFallBack();
+  storedLayout();
+  tableChangeDropsStalePins();
+  migratesRawStruct();
+  return Check::result();
+}
@@ -0,0 +1,187 @@
+#include <math.h>
+#include <vector>
+#include "ScanScheduler.h"
+#include "EchoCapture.h"
+#include "Config.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+static const uint32_t SLOT_US = SCAN_SLOT_MS * 1000UL;
+static const uint32_t PERIOD_US = SENSOR_INTERVAL_MIN_MS * 1000UL;
+
+// Groups fire in order, one slot apart, and the next scan waits for the period
+static void slotsAndPeriod() {
+  ScanScheduler scheduler(3, 40000, 250000);
+  CHECK_EQ(scheduler.poll(1000), 0);
+  CHECK_EQ(scheduler.poll(40999), ScanScheduler::NO_GROUP);
+  CHECK_EQ(scheduler.poll(41000), 1);
+  CHECK_EQ(scheduler.poll(81000), 2);
+  CHECK_EQ(scheduler.poll(121000), ScanScheduler::NO_GROUP);  // Last slot over, period not
+  CHECK_EQ(scheduler.poll(250999), ScanScheduler::NO_GROUP);
+  CHECK_EQ(scheduler.getScanCount(), 0);
+  CHECK_EQ(scheduler.poll(251000), 0);
+  CHECK_EQ(scheduler.getScanCount(), 1);
+  CHECK_EQ(scheduler.getLastScanUs(), 250000);
+  CHECK(fabsf(scheduler.getScanRateHz() - 4.0f) < 0.001f);
+
+  // A period shorter than the slots: the scan takes as long as its slots
+  scheduler.setPeriodUs(10000);
+  CHECK_EQ(scheduler.poll(291000), 1);
+  CHECK_EQ(scheduler.poll(331000), 2);
+  CHECK_EQ(scheduler.poll(370999), ScanScheduler::NO_GROUP);
+  CHECK_EQ(scheduler.poll(371000), 0);
+  CHECK_EQ(scheduler.getLastScanUs(), 120000);
+}
+
+// A late poll delays the slot, never skips a group; the clock may wrap
+static void latePollsAndWrap() {
+  ScanScheduler scheduler(2, 40000, 0);
+  uint32_t start = UINT32_MAX - 50000;
+  CHECK_EQ(scheduler.poll(start), 0);
+  CHECK_EQ(scheduler.poll(start + 100000), 1);  // Past the wrap, and late
+  CHECK_EQ(scheduler.poll(start + 139999), ScanScheduler::NO_GROUP);
+  CHECK_EQ(scheduler.poll(start + 140000), 0);
+  CHECK_EQ(scheduler.getLastScanUs(), 140000);
+
+  ScanScheduler none(0, 40000, 0);  // No groups is treated as one
+  CHECK_EQ(none.getGroupCount(), 1);
+  CHECK_EQ(none.poll(0), 0);
+  CHECK_EQ(none.poll(40000), 0);
+}
+
+/**
+ * Acoustic model of a row of ceiling-mounted sensors.
+ *
+ * Sensor i hangs above spot i, SPOT_PITCH_CM apart, and looks down at a
+ * surface DISTANCE_CM below it: the floor, or the roof of a car. Its own
+ * echo comes back after 2d/c. The ping of sensor j also reaches sensor i
+ * over the surface below j, a path of d_j + sqrt(d_j^2 + dx^2), and is
+ * heard if i is within HEARING_RATIO * d_j sideways of that surface. A
+ * sensor measures the first arrival after it fired, so a cross-echo that
+ * beats its own echo gives a short reading.
+ */
+namespace Acoustics {
+
+const double SOUND_CM_PER_US = 0.0343;
+const double SPOT_PITCH_CM = 250;
+const double HEARING_RATIO = 2.5;  // Up to ~68 degrees off the beam, counting reflections off car bodies
+const double TOLERANCE_CM = 2;
+
+struct Ping {
+  size_t sensor;
+  uint32_t atUs;
+};
+
+struct Result {
+  uint32_t measurements;
+  uint32_t crosstalk;       // Readings off by more than TOLERANCE_CM
+  uint32_t longestGapUs;    // Longest time a spot went without a ping
+  uint32_t lastScanUs;
+};
+
+double distanceCm(size_t sensor) {
+  // Mixed lot: floor at 250 cm, cars at 100..150 cm
+  return sensor % 3 == 1 ? 250 : 100 + (sensor * 17) % 50;
+}
+
+/// @return Arrival time at `listener` of the echo of `ping`, or -1 if it is not heard
+double arrivalUs(const Ping& ping, size_t listener) {
+  double d = distanceCm(ping.sensor);
+  double dx = fabs(static_cast<double>(listener) - static_cast<double>(ping.sensor)) * SPOT_PITCH_CM;
+  if (dx > HEARING_RATIO * d) {
+    return -1;
+  }
+  return ping.atUs + (d + sqrt(d * d + dx * dx)) / SOUND_CM_PER_US;
+}
+
+/// @brief Drive `spots` sensors for `runUs` with the scheduler, 100 us per poll, and read every ping
+Result run(size_t spots, uint8_t groups, uint32_t slotUs, uint32_t periodUs, uint32_t runUs) {
+  ScanScheduler scheduler(groups, slotUs, periodUs);
+  std::vector<Ping> pings;
+  for (uint32_t nowUs = 0; nowUs < runUs; nowUs += 100) {
+    int group = scheduler.poll(nowUs);
+    if (group == ScanScheduler::NO_GROUP) {
+      continue;
+    }
+    for (size_t i = 0; i < spots; i++) {
+      if (i % groups == static_cast<size_t>(group)) {
+        pings.push_back({i, nowUs});
+      }
+    }
+  }
+
+  Result result = {};
+  result.lastScanUs = scheduler.getLastScanUs();
+  std::vector<uint32_t> lastPingUs(spots, 0);
+  for (const Ping& own : pings) {
+    uint32_t gapUs = own.atUs - lastPingUs[own.sensor];
+    result.longestGapUs = gapUs > result.longestGapUs ? gapUs : result.longestGapUs;
+    lastPingUs[own.sensor] = own.atUs;
+
+    double firstUs = -1;
+    for (const Ping& other : pings) {
+      double at = arrivalUs(other, own.sensor);
+      if (at > own.atUs && at <= own.atUs + ECHO_TIMEOUT_US && (firstUs < 0 || at < firstUs)) {
+        firstUs = at;
+      }
+    }
+    result.measurements++;
+    double measuredCm = firstUs < 0 ? -1 : (firstUs - own.atUs) * SOUND_CM_PER_US / 2;
+    if (fabs(measuredCm - distanceCm(own.sensor)) > TOLERANCE_CM) {
+      result.crosstalk++;
+    }
+  }
+  return result;
+}
+}
+
+// 16 spots in two interleaved groups: every spot read 4 times a second, no cross-echo
+static void sixteenSpotsUnderASecond() {
+  Acoustics::Result result = Acoustics::run(16, 2, SLOT_US, PERIOD_US, 10000000);
+  CHECK_EQ(result.measurements, 16 * 40);
+  CHECK_EQ(result.crosstalk, 0);
+  CHECK_EQ(result.lastScanUs, PERIOD_US);
+  CHECK(result.longestGapUs <= PERIOD_US);
+
+  // As fast as the slots allow: one scan per two slots
+  Acoustics::Result fastest = Acoustics::run(16, 2, SLOT_US, 0, 1000000);
+  CHECK_EQ(fastest.lastScanUs, 2 * SLOT_US);
+  CHECK_EQ(fastest.crosstalk, 0);
+
+  // 32 spots in four groups still refresh within a second
+  Acoustics::Result large = Acoustics::run(32, 4, SLOT_US, PERIOD_US, 5000000);
+  CHECK_EQ(large.crosstalk, 0);
+  CHECK(large.longestGapUs < 1000000);
+  printf("16 spots: scan every %lu ms, %lu readings, %lu crosstalk\n",
+         static_cast<unsigned long>(result.lastScanUs / 1000), static_cast<unsigned long>(result.measurements),
+         static_cast<unsigned long>(result.crosstalk));
+}
+
+// The model does produce cross-echo when the schedule allows it
+static void crosstalkWithoutSeparation() {
+  // Everyone at once: neighbours above the floor hear each other
+  Acoustics::Result together = Acoustics::run(16, 1, SLOT_US, PERIOD_US, 2000000);
+  CHECK(together.crosstalk > 0);
+
+  // Groups, but slots shorter than the echo time
+  Acoustics::Result shortSlots = Acoustics::run(16, 2, 5000, PERIOD_US, 2000000);
+  CHECK(shortSlots.crosstalk > 0);
+  printf("without separation: %lu of %lu readings disturbed; short slots: %lu of %lu\n",
+         static_cast<unsigned long>(together.crosstalk), static_cast<unsigned long>(together.measurements),
+         static_cast<unsigned long>(shortSlots.crosstalk), static_cast<unsigned long>(shortSlots.measurements));
+}
+
+// The configured slot covers the echo timeout, as Config.h promises
+static void slotCoversEchoTimeout() {
+  CHECK(SLOT_US >= ECHO_TIMEOUT_US);
+}
+
+int main() {
+  slotsAndPeriod();
+  latePollsAndWrap();
+  sixteenSpotsUnderASecond();
+  crosstalkWithoutSeparation();
+  slotCoversEchoTimeout();
+  return Check::result();
+}
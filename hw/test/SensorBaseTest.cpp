@@ -0,0 +1,167 @@
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "SensorInterface.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+// Every heap allocation in the process goes through here
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+  allocations++;
+  void* p = malloc(size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+// A sensor type as the firmware declares one
+class FakeSensor final : public SensorBase<FakeSensor> {
+public:
+  static constexpr const char* TYPE = "fake";
+
+  FakeSensor(const char* technology, int index) : SensorBase(technology, index) {}
+
+  void bind(const char* deviceName, int deviceId) {
+    setName(deviceName, deviceId);
+  }
+};
+
+// Static polymorphism: no vtable, nothing but the members
+static_assert(!std::is_polymorphic<FakeSensor>::value, "SensorBase must not add virtual calls");
+
+static void resolvesDerivedType() {
+  FakeSensor sensor("ultrasonic", 3);
+  CHECK_STR(sensor.getType(), "fake");
+  CHECK_STR(sensor.getTechnology(), "ultrasonic");
+  CHECK_EQ(sensor.getIndex(), 3);
+  CHECK_STR(sensor.getName(), "");
+}
+
+static void namesAfterDevice() {
+  FakeSensor sensor("ultrasonic", 0);
+  sensor.bind("esp32_dev", 1);
+  CHECK_STR(sensor.getName(), "ultrasonic_0_esp32_dev_1");
+
+  char name[SENSOR_NAME_LEN];
+  FakeSensor::formatName(name, sizeof(name), "ultrasonic", 0, "esp32_dev", 1);
+  CHECK_STR(name, sensor.getName());
+}
+
+// An overlong device name is cut at the buffer, never past it
+static void truncatesLongNames() {
+  char deviceName[2 * SENSOR_NAME_LEN];
+  memset(deviceName, 'x', sizeof(deviceName) - 1);
+  deviceName[sizeof(deviceName) - 1] = '\0';
+
+  FakeSensor sensor("ultrasonic", 7);
+  sensor.bind(deviceName, 42);
+  CHECK_EQ(strlen(sensor.getName()), SENSOR_NAME_LEN - 1);
+  CHECK(strncmp(sensor.getName(), "ultrasonic_7_xxx", 16) == 0);
+}
+
+// The interface SensorBase replaced: virtual accessors returning string copies
+// (std::string standing in for Arduino's String)
+class LegacySensor {
+public:
+  virtual ~LegacySensor() = default;
+  virtual std::string getName() const = 0;
+  virtual std::string getType() const = 0;
+  virtual std::string getTechnology() const = 0;
+  virtual int getIndex() const = 0;
+};
+
+class LegacyFake : public LegacySensor {
+public:
+  LegacyFake(const char* technology, int index, const char* deviceName, int deviceId)
+    : type("fake"), technology(technology), index(index) {
+    char buffer[SENSOR_NAME_LEN];
+    snprintf(buffer, sizeof(buffer), "%s_%d_%s_%d", technology, index, deviceName, deviceId);
+    name = buffer;
+  }
+
+  std::string getName() const override { return name; }
+  std::string getType() const override { return type; }
+  std::string getTechnology() const override { return technology; }
+  int getIndex() const override { return index; }
+
+private:
+  std::string name;
+  std::string type;
+  std::string technology;
+  int index;
+};
+
+static const int BENCH_SENSORS = 16;
+static const int BENCH_PASSES = 20000;
+
+// What one loop pass reads from each sensor to label its log line and payload
+static size_t labelLegacy(const LegacySensor& sensor) {
+  return sensor.getName().size() + sensor.getType().size() + sensor.getTechnology().size() + sensor.getIndex();
+}
+
+static size_t labelCrtp(const FakeSensor& sensor) {
+  return strlen(sensor.getName()) + strlen(sensor.getType()) + strlen(sensor.getTechnology()) + sensor.getIndex();
+}
+
+// The CRTP accessors allocate nothing per pass; the virtual/String ones allocate per call
+static void benchmarkAgainstVirtual() {
+  std::vector<std::unique_ptr<LegacySensor>> legacy;
+  std::vector<FakeSensor> crtp;
+  for (int i = 0; i < BENCH_SENSORS; i++) {
+    legacy.emplace_back(new LegacyFake("ultrasonic", i, "esp32_dev", 1));
+    crtp.emplace_back("ultrasonic", i);
+    crtp.back().bind("esp32_dev", 1);
+  }
+
+  size_t sink = 0;
+  size_t before = allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (int pass = 0; pass < BENCH_PASSES; pass++) {
+    for (const std::unique_ptr<LegacySensor>& sensor : legacy) {
+      sink += labelLegacy(*sensor);
+    }
+  }
+  double legacyNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  size_t legacyAllocations = allocations - before;
+
+  before = allocations;
+  start = std::chrono::steady_clock::now();
+  for (int pass = 0; pass < BENCH_PASSES; pass++) {
+    for (const FakeSensor& sensor : crtp) {
+      sink += labelCrtp(sensor);
+    }
+  }
+  double crtpNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  size_t crtpAllocations = allocations - before;
+
+  CHECK(sink > 0);
+  CHECK_EQ(crtpAllocations, 0);
+  CHECK(legacyAllocations >= static_cast<size_t>(BENCH_SENSORS) * BENCH_PASSES);  // At least the long name
+  const double calls = static_cast<double>(BENCH_SENSORS) * BENCH_PASSES;
+  printf("per sensor label: virtual/String %.1f ns and %.2f allocations, CRTP %.1f ns and %.2f allocations\n",
+         legacyNs / calls, legacyAllocations / calls, crtpNs / calls, crtpAllocations / calls);
+}
+
+int main() {
+  resolvesDerivedType();
+  namesAfterDevice();
+  truncatesLongNames();
+  benchmarkAgainstVirtual();
+  return Check::result();
+}
@@ -0,0 +1,187 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "SpscQueue.h"
+#include "PinnedTask.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+// Large enough that a torn copy would show in the check word
+struct Item {
+  uint32_t sequence;
+  uint32_t check;
+  uint8_t padding[24];
+};
+
+static uint32_t checkWord(uint32_t sequence) {
+  return static_cast<uint32_t>(sequence * 2654435761UL);
+}
+
+static Item makeItem(uint32_t sequence) {
+  Item item = {};
+  item.sequence = sequence;
+  item.check = checkWord(sequence);
+  return item;
+}
+
+static bool intact(const Item& item) {
+  return item.check == checkWord(item.sequence);
+}
+
+static void fullAndEmptyEdges() {
+  SpscQueue<Item, 4> queue;
+  Item item;
+  CHECK(queue.isEmpty());
+  CHECK(!queue.pop(item));
+
+  for (uint32_t i = 0; i < 4; i++) {
+    CHECK(queue.push(makeItem(i)));
+  }
+  CHECK_EQ(queue.size(), 4);
+  CHECK(!queue.push(makeItem(99)));  // Full: refused, nothing overwritten
+
+  CHECK(queue.pop(item));
+  CHECK_EQ(item.sequence, 0);
+  CHECK(queue.push(makeItem(4)));  // One slot freed, one accepted
+  CHECK(!queue.push(makeItem(99)));
+
+  for (uint32_t i = 1; i <= 4; i++) {
+    CHECK(queue.pop(item));
+    CHECK_EQ(item.sequence, i);
+  }
+  CHECK(queue.isEmpty());
+  CHECK(!queue.pop(item));
+}
+
+// The indices run far past the capacity; every lap keeps FIFO order
+static void wrapsAround() {
+  SpscQueue<Item, 8> queue;
+  uint32_t pushed = 0;
+  uint32_t popped = 0;
+  for (int lap = 0; lap < 1000; lap++) {
+    // Uneven batches so the full and empty edges fall on every slot
+    for (int i = 0; i < 1 + lap % 6; i++) {
+      CHECK(queue.push(makeItem(pushed++)));
+    }
+    Item item;
+    while (queue.size() > static_cast<size_t>(lap % 3)) {
+      CHECK(queue.pop(item));
+      if (item.sequence != popped) {
+        CHECK_EQ(item.sequence, popped);
+        return;
+      }
+      popped++;
+    }
+  }
+  CHECK(pushed > 1000 * 3);
+}
+
+// A producer thread against a consumer thread: nothing lost, duplicated, torn or reordered
+static void threadedStress() {
+  static SpscQueue<Item, 32> queue;
+  const uint32_t COUNT = 2000000;
+  std::atomic<uint32_t> refused{0};
+
+  std::thread producer([&]() {
+    for (uint32_t i = 0; i < COUNT; i++) {
+      while (!queue.push(makeItem(i))) {
+        refused.fetch_add(1, std::memory_order_relaxed);
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint32_t expected = 0;
+  uint32_t bad = 0;
+  while (expected < COUNT) {
+    Item item;
+    if (!queue.pop(item)) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (item.sequence != expected || !intact(item)) {
+      bad++;
+    }
+    expected = item.sequence + 1;
+  }
+  producer.join();
+
+  CHECK_EQ(bad, 0);
+  CHECK(queue.isEmpty());
+  printf("threaded: %lu items, producer found the queue full %lu times\n",
+         static_cast<unsigned long>(COUNT), static_cast<unsigned long>(refused.load()));
+}
+
+// The firmware's split: a fast sensing task feeding a networking task that stalls
+namespace Split {
+
+const uint32_t STALL_MS = 150;
+
+SpscQueue<Item, 32> transitions;
+std::atomic<uint32_t> produced{0};
+std::atomic<uint32_t> consumed{0};
+std::atomic<uint32_t> outOfOrder{0};
+std::atomic<uint32_t> maxGapUs{0};
+std::chrono::steady_clock::time_point lastSense;
+bool sensedBefore = false;
+uint32_t nextExpected = 0;
+
+// Offer one transition per pass, and retry it next pass if the queue is full
+void senseStep() {
+  auto now = std::chrono::steady_clock::now();
+  if (sensedBefore) {
+    uint32_t gapUs = std::chrono::duration_cast<std::chrono::microseconds>(now - lastSense).count();
+    if (gapUs > maxGapUs.load()) {
+      maxGapUs.store(gapUs);
+    }
+  }
+  lastSense = now;
+  sensedBefore = true;
+
+  if (transitions.push(makeItem(produced.load()))) {
+    produced.fetch_add(1);
+  }
+}
+
+// Drain everything queued, then stall as a slow publish would
+void networkStep() {
+  Item item;
+  while (transitions.pop(item)) {
+    if (item.sequence != nextExpected || !intact(item)) {
+      outOfOrder.fetch_add(1);
+    }
+    nextExpected = item.sequence + 1;
+    consumed.fetch_add(1);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(STALL_MS));
+}
+}
+
+static void pinnedTasksKeepSensing() {
+  PinnedTask sense("sense", Split::senseStep, 1);
+  PinnedTask network("network", Split::networkStep, 2);
+  CHECK(sense.start(1, 4096, 2));
+  CHECK(network.start(0, 8192, 1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(4 * Split::STALL_MS));
+  sense.stop();
+  network.stop();
+
+  // Sampling went on while networking stalled; the queue absorbed the bursts
+  CHECK(sense.getSteps() > 10 * network.getSteps());
+  CHECK(Split::maxGapUs.load() < Split::STALL_MS * 1000 / 2);
+  CHECK_EQ(Split::outOfOrder.load(), 0);
+  CHECK(Split::consumed.load() > 0);
+  CHECK(Split::produced.load() - Split::consumed.load() <= 32);
+  printf("split: %lu sensing passes, %lu networking passes, longest sensing gap %lu us\n",
+         static_cast<unsigned long>(sense.getSteps()), static_cast<unsigned long>(network.getSteps()),
+         static_cast<unsigned long>(Split::maxGapUs.load()));
+}
+
+int main() {
+  fullAndEmptyEdges();
+  wrapsAround();
+  threadedStress();
+  pinnedTasksKeepSensing();
+  return Check::result();
+}
@@ -0,0 +1,75 @@
+#include "TopicFilter.h"
+#include "Check.h"
+
+using namespace FindSpot;
+
+static bool matches(const TopicFilter& filter, const char* topic, const char* expectedTail) {
+  const char* tail = nullptr;
+  if (!filter.match(topic, &tail)) {
+    return false;
+  }
+  return strcmp(tail, expectedTail) == 0;
+}
+
+static bool rejects(const TopicFilter& filter, const char* topic) {
+  const char* tail = nullptr;
+  return !filter.match(topic, &tail);
+}
+
+// The dispatcher's filter: the tail after cmd/ is the command name
+static void commandFilter() {
+  TopicFilter filter;
+  CHECK(filter.compile("device/7/cmd/#"));
+  CHECK_STR(filter.c_str(), "device/7/cmd/#");
+  CHECK(matches(filter, "device/7/cmd/snapshot", "snapshot"));
+  CHECK(matches(filter, "device/7/cmd/config/pins", "config/pins"));
+  CHECK(matches(filter, "device/7/cmd/", ""));
+
+  CHECK(rejects(filter, "device/7/cmd"));      // No command level at all
+  CHECK(rejects(filter, "device/70/cmd/x"));   // Prefix of another ID
+  CHECK(rejects(filter, "device/7/cmdx/x"));
+  CHECK(rejects(filter, "device/8/cmd/snapshot"));
+  CHECK(rejects(filter, "device/7/sensors/0"));
+  CHECK(rejects(filter, ""));
+}
+
+static void singleLevelWildcard() {
+  TopicFilter filter;
+  CHECK(filter.compile("device/+/status"));
+  CHECK(matches(filter, "device/12/status", ""));
+  CHECK(matches(filter, "device//status", ""));  // An empty level is still a level
+  CHECK(rejects(filter, "device/12/13/status"));
+  CHECK(rejects(filter, "device/12/status/extra"));
+  CHECK(rejects(filter, "device/12"));
+}
+
+static void exactFilter() {
+  TopicFilter filter;
+  CHECK(filter.compile("a/b"));
+  CHECK(matches(filter, "a/b", ""));
+  CHECK(rejects(filter, "a/b/c"));
+  CHECK(rejects(filter, "a"));
+  CHECK(rejects(filter, "a/bc"));
+}
+
+static void compileLimits() {
+  TopicFilter filter;
+  CHECK(filter.compile("1/2/3/4/5/6/7/8"));
+  CHECK(!filter.compile("1/2/3/4/5/6/7/8/9"));  // More than MAX_LEVELS
+  CHECK(rejects(filter, "1/2/3/4/5/6/7/8"));
+  CHECK(rejects(filter, "1/2/3/4/5/6/7/8/9"));
+
+  char longFilter[TOPIC_FILTER_LEN + 1];
+  memset(longFilter, 'x', TOPIC_FILTER_LEN);
+  longFilter[TOPIC_FILTER_LEN] = '\0';
+  CHECK(!filter.compile(longFilter));
+  CHECK(rejects(filter, longFilter));  // A failed compile matches nothing
+}
+
+int main() {
+  commandFilter();
+  singleLevelWildcard();
+  exactFilter();
+  compileLimits();
+  return Check::result();
+}
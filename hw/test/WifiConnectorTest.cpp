@@ -0,0 +1,243 @@
+#include "WifiConnector.h"
+#include "Check.h"
+#include "MemoryStorage.h"
+#include "FakeRadio.h"
+
+using namespace FindSpot;
+
+static const uint32_t FAST_TIMEOUT_MS = 3000;
+static const uint32_t FULL_TIMEOUT_MS = 30000;
+static const uint32_t SCAN_MS = FakeRadio::SCAN_MS;
+static const uint32_t DIRECTED_MS = FakeRadio::DIRECTED_MS;
+
+typedef WifiConnector<FakeRadio, MemoryStorage> Connector;
+
+static int linkUps = 0;
+static int linkDowns = 0;
+
+static void recordLink(bool up) {
+  (up ? linkUps : linkDowns)++;
+}
+
+static Connector makeConnector(FakeRadio& radio, MemoryStorage& storage, bool reuseLease = false) {
+  Connector connector(radio, storage, FAST_TIMEOUT_MS, FULL_TIMEOUT_MS, reuseLease, Backoff(1000, 30000, 1));
+  connector.setListener(recordLink);
+  return connector;
+}
+
+// Polls every 10 ms until the link comes up or `limitMs` passes
+static bool runUntilUp(Connector& connector, FakeRadio& radio, uint32_t limitMs) {
+  uint32_t endMs = radio.nowMs + limitMs;
+  while (radio.nowMs < endMs) {
+    radio.nowMs += 10;
+    if (connector.poll(radio.nowMs)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint8_t cachedChannel(const MemoryStorage& storage) {
+  WifiLink link;
+  memcpy(&link, storage.data + 1, sizeof(link));
+  return link.channel;
+}
+
+// Nothing cached: scan, and cache what was found
+static void coldBootScans() {
+  FakeRadio radio;
+  MemoryStorage storage;
+  Connector connector = makeConnector(radio, storage);
+  linkUps = 0;
+
+  connector.begin(radio.nowMs);
+  CHECK(connector.getMode() == Connector::Mode::FULL);
+  CHECK(runUntilUp(connector, radio, 5000));
+  CHECK(connector.isConnected());
+  CHECK_EQ(radio.fullBegins, 1);
+  CHECK_EQ(radio.directedBegins, 0);
+  CHECK_EQ(connector.getStats().fullConnects, 1);
+  CHECK_EQ(connector.getStats().lastAssociationMs, SCAN_MS);
+  CHECK_EQ(linkUps, 1);
+
+  CHECK_EQ(storage.saves, 1);
+  CHECK_EQ(storage.length, 1 + sizeof(WifiLink));
+  CHECK_EQ(storage.data[0], WifiLink::VERSION);
+  CHECK_EQ(cachedChannel(storage), 6);
+}
+
+// A cached link: straight to that access point, no scan and no write
+static void warmBootGoesDirect() {
+  FakeRadio radio;
+  MemoryStorage storage;
+  {
+    Connector first = makeConnector(radio, storage);
+    first.begin(radio.nowMs);
+    runUntilUp(first, radio, 5000);
+  }
+
+  FakeRadio rebooted;
+  Connector connector = makeConnector(rebooted, storage);
+  connector.begin(rebooted.nowMs);
+  CHECK(connector.getMode() == Connector::Mode::FAST);
+  CHECK(runUntilUp(connector, rebooted, 5000));
+  CHECK_EQ(rebooted.directedBegins, 1);
+  CHECK_EQ(rebooted.fullBegins, 0);
+  CHECK(!rebooted.lastUsedLease);
+  CHECK_EQ(connector.getStats().fastConnects, 1);
+  CHECK_EQ(connector.getStats().lastAssociationMs, DIRECTED_MS);
+  CHECK_EQ(storage.saves, 1);
+}
+
+// A drop reconnects directed too, and the listener hears both edges
+static void dropReconnectsDirect() {
+  FakeRadio radio;
+  MemoryStorage storage;
+  Connector connector = makeConnector(radio, storage);
+  linkUps = linkDowns = 0;
+  connector.begin(radio.nowMs);
+  runUntilUp(connector, radio, 5000);
+
+  radio.dropLink();
+  radio.nowMs += 10;
+  connector.poll(radio.nowMs);
+  CHECK_EQ(linkDowns, 1);
+  CHECK(connector.getMode() == Connector::Mode::FAST);
+  CHECK(runUntilUp(connector, radio, 5000));
+  CHECK_EQ(radio.directedBegins, 1);
+  CHECK_EQ(linkUps, 2);
+
+  // A blip that recovered between two polls still restarts the link
+  radio.disconnectEvents++;
+  radio.nowMs += 10;
+  connector.poll(radio.nowMs);
+  CHECK_EQ(linkDowns, 2);
+  CHECK(!radio.up);
+  CHECK(runUntilUp(connector, radio, 5000));
+}
+
+// The access point moved channel: the directed attempt times out, a scan finds it
+static void fastTimeoutFallsBackToScan() {
+  FakeRadio radio;
+  MemoryStorage storage;
+  {
+    Connector first = makeConnector(radio, storage);
+    first.begin(radio.nowMs);
+    runUntilUp(first, radio, 5000);
+  }
+
+  FakeRadio moved;
+  moved.channel = 11;
+  Connector connector = makeConnector(moved, storage);
+  connector.begin(moved.nowMs);
+  CHECK(!runUntilUp(connector, moved, FAST_TIMEOUT_MS - 10));
+  CHECK(connector.getMode() == Connector::Mode::FAST);
+  moved.nowMs += 10;
+  connector.poll(moved.nowMs);
+  CHECK(connector.getMode() == Connector::Mode::FULL);
+  CHECK_EQ(connector.getMetrics().getFailures(), 1);
+
+  CHECK(runUntilUp(connector, moved, 5000));
+  CHECK_EQ(connector.getStats().fullConnects, 1);
+  CHECK_EQ(connector.getStats().lastAssociationMs, FAST_TIMEOUT_MS + SCAN_MS);
+  CHECK_EQ(storage.saves, 2);
+  CHECK_EQ(cachedChannel(storage), 11);
+}
+
+// Failed scans back off, then retry
+static void failedScansBackOff() {
+  FakeRadio radio;
+  radio.inRange = false;
+  MemoryStorage storage;
+  Connector connector = makeConnector(radio, storage);
+  connector.begin(radio.nowMs);
+
+  CHECK(!runUntilUp(connector, radio, FULL_TIMEOUT_MS));
+  CHECK(connector.getMode() == Connector::Mode::WAITING);
+  uint32_t waitMs = connector.getWaitMs();
+  CHECK(waitMs >= 1000 && waitMs <= 3000);
+
+  radio.inRange = true;
+  CHECK(!runUntilUp(connector, radio, waitMs - 10));
+  CHECK_EQ(radio.fullBegins, 1);
+  CHECK(runUntilUp(connector, radio, 10 + SCAN_MS));
+  CHECK_EQ(radio.fullBegins, 2);
+  CHECK_EQ(storage.saves, 1);
+}
+
+// Only a new BSSID or channel rewrites the cache, unless the lease is reused
+static void rewritesOnlyOnChange() {
+  FakeRadio radio;
+  MemoryStorage storage;
+  Connector connector = makeConnector(radio, storage);
+  connector.begin(radio.nowMs);
+  runUntilUp(connector, radio, 5000);
+  CHECK_EQ(storage.saves, 1);
+
+  // Same access point, new DHCP address: the lease is not used, nothing to write
+  radio.ip++;
+  radio.dropLink();
+  CHECK(runUntilUp(connector, radio, 5000));
+  CHECK_EQ(storage.saves, 1);
+
+  // Another access point of the same network on the same channel
+  radio.bssid[5] = 0x04;
+  radio.dropLink();
+  CHECK(runUntilUp(connector, radio, 10000));
+  CHECK_EQ(storage.saves, 2);
+
+  radio.dropLink();
+  CHECK(runUntilUp(connector, radio, 5000));
+  CHECK_EQ(storage.saves, 2);
+
+  // With a reused lease the address is part of the link
+  FakeRadio leased;
+  MemoryStorage leaseStorage;
+  Connector leasing = makeConnector(leased, leaseStorage, true);
+  leasing.begin(leased.nowMs);
+  runUntilUp(leasing, leased, 5000);
+  leased.dropLink();
+  CHECK(runUntilUp(leasing, leased, 5000));
+  CHECK(leased.lastUsedLease);
+  CHECK_EQ(leaseStorage.saves, 1);
+  leased.ip++;
+  leased.dropLink();
+  CHECK(runUntilUp(leasing, leased, 5000));
+  CHECK_EQ(leaseStorage.saves, 2);
+}
+
+// A cache from another firmware version or with an impossible channel is ignored
+static void unusableCacheScans() {
+  FakeRadio radio;
+  MemoryStorage storage;
+  {
+    Connector first = makeConnector(radio, storage);
+    first.begin(radio.nowMs);
+    runUntilUp(first, radio, 5000);
+  }
+
+  MemoryStorage otherVersion = storage;
+  otherVersion.data[0] = WifiLink::VERSION + 1;
+  FakeRadio a;
+  Connector fromOther = makeConnector(a, otherVersion);
+  fromOther.begin(a.nowMs);
+  CHECK(fromOther.getMode() == Connector::Mode::FULL);
+
+  MemoryStorage badChannel = storage;
+  badChannel.data[1 + offsetof(WifiLink, channel)] = 0;
+  FakeRadio b;
+  Connector fromBad = makeConnector(b, badChannel);
+  fromBad.begin(b.nowMs);
+  CHECK(fromBad.getMode() == Connector::Mode::FULL);
+}
+
+int main() {
+  coldBootScans();
+  warmBootGoesDirect();
+  dropReconnectsDirect();
+  fastTimeoutFallsBackToScan();
+  failedScansBackOff();
+  rewritesOnlyOnChange();
+  unusableCacheScans();
+  return Check::result();
+}
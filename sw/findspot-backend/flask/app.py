@@ -10,7 +10,7 @@ import paho.mqtt.client as mqtt
 import json
 import os
 from datetime import datetime, timezone
-import threading
+import struct
 from dotenv import load_dotenv
 import hashlib
 
@@ -52,24 +52,23 @@ MQTT_PORT = int(os.getenv('MQTT_PORT', 1883))
 MQTT_USER = os.getenv('MQTT_USER', 'flask_backend')
 MQTT_PASSWORD = os.getenv('MQTT_PASSWORD', 'backend_password')
 
-# Device timeout configuration (in seconds)
-DEVICE_TIMEOUT = int(os.getenv('DEVICE_TIMEOUT', 60))  # Default: 60 seconds
-
 # ESP32 MQTT Credentials Configuration
 # ESP32 generates and sends its own credentials during registration
 
+# Sensor payload formats this backend can decode (see hw/src/PayloadCodec.h)
+SUPPORTED_PAYLOAD_FORMATS = ('json', 'binary')
+SENSOR_PAYLOAD_VERSION = 1
+SENSOR_UPDATE_FORMAT = '<BBBHI'  # version, index, flags, distance_cm, timestamp
+SENSOR_NO_DISTANCE = 0xFFFF
+OCCUPANCY_PAYLOAD_VERSION = 1
+
 def is_device_online(device):
-    """Check if device is considered online based on last_seen timestamp"""
-    if not device.last_seen:
-        return False
-    
-    # Ensure last_seen is timezone-aware
-    last_seen = device.last_seen
-    if last_seen.tzinfo is None:
-        last_seen = last_seen.replace(tzinfo=timezone.utc)
-    
-    time_since_last_seen = (datetime.now(timezone.utc) - last_seen).total_seconds()
-    return time_since_last_seen <= DEVICE_TIMEOUT
+    """
+    Check if device is online. Presence comes from the retained device/{id}/status
+    topic: the device publishes "online" on connect and the broker publishes its
+    Last Will "offline" when the connection dies, so no timeout polling is needed.
+    """
+    return device.status == 'online'
 
 def create_mqtt_user(username, password):
     """Add MQTT user to mosquitto passwd file - Local Development Version"""
@@ -126,17 +125,64 @@ def on_connect(client, userdata, flags, rc):
     """MQTT connection callback"""
     if rc == 0:
         print(f"Connected to MQTT Broker at {MQTT_BROKER}:{MQTT_PORT}")
-        client.subscribe("device/+/sensors/+", qos=0)
-        client.subscribe("device/+/status", qos=0)
+        client.subscribe("device/+/sensors/+", qos=1)
+        client.subscribe("device/+/occupancy", qos=0)
+        client.subscribe("device/+/status", qos=1)
+        client.subscribe("device/+/telemetry", qos=0)
     else:
         print(f"Failed to connect to MQTT Broker, return code {rc}")
 
 
+def decode_sensor_payload(raw):
+    """Decode a sensor payload, either a JSON object or the compact binary record"""
+    if raw[:1] == b'{':
+        return json.loads(raw.decode())
+    
+    if len(raw) < struct.calcsize(SENSOR_UPDATE_FORMAT) or raw[0] != SENSOR_PAYLOAD_VERSION:
+        raise ValueError(f"Unknown sensor payload ({len(raw)} bytes)")
+    
+    _, index, flags, distance, timestamp = struct.unpack_from(SENSOR_UPDATE_FORMAT, raw)
+    return {
+        'index': index,
+        'is_occupied': bool(flags & 0x01),
+        'current_distance': -1 if distance == SENSOR_NO_DISTANCE else distance,
+        'timestamp': timestamp
+    }
+
+
+def decode_occupancy_payload(raw):
+    """
+    Decode a device-level aggregate: occupancy bitmap of all spots plus the
+    distance of every spot that changed. Returns sensor updates keyed by index.
+    """
+    if len(raw) < 7 or raw[0] != OCCUPANCY_PAYLOAD_VERSION:
+        raise ValueError(f"Unknown occupancy payload ({len(raw)} bytes)")
+    
+    spots = raw[1]
+    timestamp = struct.unpack_from('<I', raw, 2)[0]
+    bitmap_len = (spots + 7) // 8
+    bitmap = int.from_bytes(raw[6:6 + bitmap_len], 'little')
+    
+    count_offset = 6 + bitmap_len
+    if len(raw) < count_offset + 1 or len(raw) < count_offset + 1 + raw[count_offset] * 3:
+        raise ValueError("Truncated occupancy payload")
+    
+    updates = {}
+    for i in range(raw[count_offset]):
+        index, distance = struct.unpack_from('<BH', raw, count_offset + 1 + i * 3)
+        updates[index] = {
+            'index': index,
+            'is_occupied': bool(bitmap >> index & 1),
+            'current_distance': -1 if distance == SENSOR_NO_DISTANCE else distance,
+            'timestamp': timestamp
+        }
+    return updates
+
+
 def on_message(client, userdata, msg):
     """MQTT message callback - processes sensor data and auto-registers sensors"""
     try:
         topic = msg.topic
-        payload = json.loads(msg.payload.decode())
         
         # Handle individual sensor data: device/{device_id}/sensors/{sensor_index}
         if topic.startswith("device/") and "/sensors/" in topic:
@@ -144,24 +190,43 @@ def on_message(client, userdata, msg):
             if len(parts) == 4:
                 device_id = int(parts[1])
                 sensor_index = int(parts[3])
-                process_single_sensor_data(device_id, sensor_index, payload)
+                process_single_sensor_data(device_id, sensor_index, decode_sensor_payload(msg.payload), msg.retain)
+        # Handle aggregated occupancy: device/{device_id}/occupancy
+        elif topic.startswith("device/") and topic.endswith("/occupancy"):
+            parts = topic.split('/')
+            if len(parts) == 3:
+                device_id = int(parts[1])
+                for sensor_index, data in decode_occupancy_payload(msg.payload).items():
+                    process_single_sensor_data(device_id, sensor_index, data, msg.retain)
         # Handle device status updates: device/{device_id}/status
         elif topic.startswith("device/") and topic.endswith("/status"):
             parts = topic.split('/')
             if len(parts) == 3:
                 device_id = int(parts[1])
-                process_device_status(device_id, payload)
+                process_device_status(device_id, json.loads(msg.payload.decode()))
+        # Handle connection-quality telemetry: device/{device_id}/telemetry
+        elif topic.startswith("device/") and topic.endswith("/telemetry"):
+            parts = topic.split('/')
+            if len(parts) == 3:
+                device_id = int(parts[1])
+                socketio.emit('device_telemetry', {
+                    'device_id': device_id,
+                    **json.loads(msg.payload.decode())
+                })
             
-    except json.JSONDecodeError as e:
-        print(f"Failed to parse JSON from MQTT: {e}")
+    except ValueError as e:
+        print(f"Failed to decode MQTT payload: {e}")
     except Exception as e:
         print(f"Error processing MQTT message: {e}")
         import traceback
         traceback.print_exc()
 
 
-def process_single_sensor_data(device_id, sensor_index, data):
-    """Process individual sensor data update from ESP32"""
+def process_single_sensor_data(device_id, sensor_index, data, retained=False):
+    """
+    Process individual sensor data update from ESP32. Retained messages replay the
+    last known state on (re)subscribe and say nothing about the device being online.
+    """
     ctx = app.app_context()
     ctx.push()
     try:
@@ -171,8 +236,9 @@ def process_single_sensor_data(device_id, sensor_index, data):
             return
         
         # Update device status and last_seen
-        device.last_seen = datetime.now(timezone.utc)
-        device.status = 'online'
+        if not retained:
+            device.last_seen = datetime.now(timezone.utc)
+            device.status = 'online'
         
         sensor_name = data.get('name', f'sensor_{sensor_index}')
         distance = data.get('current_distance')
@@ -234,8 +300,8 @@ def process_single_sensor_data(device_id, sensor_index, data):
         # Notify frontend about device update
         socketio.emit('device_update', {
             'device_id': device_id,
-            'status': 'online',
-            'last_seen': device.last_seen.isoformat()
+            'status': device.status,
+            'last_seen': device.last_seen.isoformat() if device.last_seen else None
         })
         
         # Send full parking update to ensure frontend has latest data
@@ -376,7 +442,8 @@ def register_iot_device():
         "name": "ESP32 Parking Sensor",
         "location": "Parking Lot A - Spot 1",
         "latitude": 46.7712,
-        "longitude": 23.6236
+        "longitude": 23.6236,
+        "payload_format": "binary"   (optional, defaults to "json")
     }
     
     Returns:
@@ -387,6 +454,7 @@ def register_iot_device():
         "mqtt_broker": "192.168.1.103",
         "mqtt_port": 1883,
         "sensor_topic": "device/123/sensors",
+        "payload_format": "binary",
         "status": "registered"
     }
     """
@@ -406,6 +474,11 @@ def register_iot_device():
         latitude = data.get('latitude', 0.0)
         longitude = data.get('longitude', 0.0)
         
+        # Confirm the requested payload format only if we can decode it
+        payload_format = data.get('payload_format', 'json')
+        if payload_format not in SUPPORTED_PAYLOAD_FORMATS:
+            payload_format = 'json'
+        
         # Check if device already exists
         existing_device = Device.query.filter_by(mac_address=mac_address_orig).first()
         if existing_device:
@@ -423,6 +496,7 @@ def register_iot_device():
                 'mqtt_broker': MQTT_BROKER,
                 'mqtt_port': MQTT_PORT,
                 'sensor_topic': f'device/{existing_device.id}/sensors',
+                'payload_format': payload_format,
                 'status': existing_device.status,
                 'message': 'Device already registered'
             }), 200
@@ -464,6 +538,7 @@ def register_iot_device():
             'mqtt_broker': MQTT_BROKER,
             'mqtt_port': MQTT_PORT,
             'sensor_topic': f'device/{new_device.id}/sensors',
+            'payload_format': payload_format,
             'status': 'registered',
             'message': 'ESP32 device registered successfully'
         }), 201
@@ -693,32 +768,6 @@ def get_all_parking_data():
     return result
 
 
-def check_device_timeouts():
-    """Background task to periodically check for offline devices and notify frontend"""
-    import time
-    while True:
-        try:
-            time.sleep(DEVICE_TIMEOUT // 2)  # Check twice per timeout period
-            
-            with app.app_context():
-                devices = Device.query.filter_by(status='online').all()
-                devices_went_offline = []
-                
-                for device in devices:
-                    if not is_device_online(device):
-                        device.status = 'offline'
-                        devices_went_offline.append(device.id)
-                
-                if devices_went_offline:
-                    db.session.commit()
-                    # Broadcast updated parking data to all clients
-                    parking_data = get_all_parking_data()
-                    socketio.emit('parking_update', parking_data)
-                    
-        except Exception as e:
-            print(f"Error in device timeout checker: {e}")
-
-
 # WebSocket Events
 
 @socketio.on('connect')
@@ -806,11 +855,6 @@ if __name__ == '__main__':
     # Initialize MQTT client
     init_mqtt()
     
-    # Start background device timeout checker
-    timeout_thread = threading.Thread(target=check_device_timeouts, daemon=True)
-    timeout_thread.start()
-    print(f"Device timeout checker started (timeout: {DEVICE_TIMEOUT}s)")
-    
     # Get server configuration from environment
     host = os.getenv('HOST', '0.0.0.0')
     port = int(os.getenv('PORT', 5000))